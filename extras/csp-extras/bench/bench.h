@@ -0,0 +1,65 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _CSP_BENCH_H_
+#define _CSP_BENCH_H_
+
+/* Helpers shared by the host benchmarks in bench/, see the Makefile */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <csp/csp.h>
+
+/* Monotonic time in nanoseconds */
+static inline uint64_t bench_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+}
+
+/* CPU cycles where there is a cycle counter, nanoseconds otherwise */
+static inline uint64_t bench_cycles(void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return bench_ns();
+#endif
+
+}
+
+/* Keep error and warning logs from dominating the measurement */
+static inline void bench_quiet(void) {
+
+	csp_debug_set_level(CSP_ERROR, 0);
+	csp_debug_set_level(CSP_WARN, 0);
+	csp_debug_set_level(CSP_INFO, 0);
+
+}
+
+#endif /* _CSP_BENCH_H_ */
@@ -0,0 +1,182 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * csp_buffer_get/csp_buffer_free operations per second, compared with the
+ * queue-backed buffer pool the size classes replaced. The reference keeps the
+ * free buffers in a csp_queue, as the original csp_buffer.c did.
+ *
+ * usage: bench_buffer [operations per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_queue.h>
+#include <csp/arch/csp_malloc.h>
+
+#include "bench.h"
+
+#define BUFFERS		100
+#define BUFFER_SIZE	256
+
+/* Buffers each thread holds at once, like a packet passing through a few queues */
+#define HELD		4
+
+/* Queue-backed reference */
+typedef struct {
+	unsigned int refcount;
+	void * skbf_addr;
+	char skbf_data[];
+} ref_skbf_t;
+
+static csp_queue_handle_t ref_buffers;
+
+static int ref_init(int count, int size) {
+
+	int i;
+	unsigned int skbfsize = sizeof(ref_skbf_t) + size + CSP_BUFFER_PACKET_OVERHEAD;
+	ref_skbf_t * buf;
+	char * pool;
+
+	skbfsize = sizeof(int *) * ((skbfsize + sizeof(int *) - 1) / sizeof(int *));
+	pool = csp_malloc(count * skbfsize);
+	ref_buffers = csp_queue_create(count, sizeof(void *));
+	if ((pool == NULL) || (ref_buffers == NULL))
+		return CSP_ERR_NOMEM;
+
+	for (i = 0; i < count; i++) {
+		buf = (void *) &pool[i * skbfsize];
+		buf->refcount = 0;
+		buf->skbf_addr = buf;
+		csp_queue_enqueue(ref_buffers, &buf, 0);
+	}
+
+	return CSP_ERR_NONE;
+
+}
+
+static void * ref_get(size_t size) {
+
+	ref_skbf_t * buf = NULL;
+
+	csp_queue_dequeue(ref_buffers, &buf, 0);
+	if ((buf == NULL) || (buf != buf->skbf_addr))
+		return NULL;
+
+	buf->refcount++;
+	return buf->skbf_data;
+
+}
+
+static void ref_free(void * packet) {
+
+	ref_skbf_t * buf = packet - sizeof(ref_skbf_t);
+
+	if ((buf->skbf_addr != buf) || (buf->refcount == 0))
+		return;
+
+	buf->refcount = 0;
+	csp_queue_enqueue(ref_buffers, &buf, 0);
+
+}
+
+typedef struct {
+	void * (*get)(size_t size);
+	void (*free)(void * packet);
+	unsigned long ops;
+	unsigned long failed;
+} bench_job_t;
+
+static void * bench_thread(void * arg) {
+
+	bench_job_t * job = arg;
+	void * held[HELD];
+	unsigned long i;
+	int j;
+
+	for (i = 0; i < job->ops; i += HELD) {
+		for (j = 0; j < HELD; j++) {
+			held[j] = job->get(16 + (i + j) % 200);
+			if (held[j] == NULL)
+				job->failed++;
+		}
+		for (j = 0; j < HELD; j++)
+			if (held[j] != NULL)
+				job->free(held[j]);
+	}
+
+	return NULL;
+
+}
+
+static double bench_run(void * (*get)(size_t), void (*free)(void *), int threads, unsigned long ops) {
+
+	pthread_t tid[8];
+	bench_job_t job[8];
+	unsigned long failed = 0;
+	uint64_t start;
+	int i;
+
+	start = bench_ns();
+	for (i = 0; i < threads; i++) {
+		job[i] = (bench_job_t) { .get = get, .free = free, .ops = ops };
+		pthread_create(&tid[i], NULL, bench_thread, &job[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tid[i], NULL);
+		failed += job[i].failed;
+	}
+
+	if (failed)
+		printf("  (%lu allocations failed)", failed);
+
+	/* One get and one free per operation */
+	return (double) threads * ops / ((bench_ns() - start) / 1e9);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int threads[] = {1, 2, 4, 8};
+	unsigned long ops = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000000;
+	double pool, queue;
+	unsigned int i;
+
+	bench_quiet();
+	csp_buffer_init(BUFFERS, BUFFER_SIZE);
+	if (ref_init(BUFFERS, BUFFER_SIZE) != CSP_ERR_NONE)
+		return 1;
+
+	printf("%lu get/free pairs per thread\n", ops);
+	printf("threads    pool ops/s   queue ops/s   speedup\n");
+
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+		pool = bench_run(csp_buffer_get, csp_buffer_free, threads[i], ops);
+		queue = bench_run(ref_get, ref_free, threads[i], ops);
+		printf("%7d  %12.0f  %12.0f  %8.1f\n", threads[i], pool, queue, pool / queue);
+	}
+
+	return 0;
+
+}
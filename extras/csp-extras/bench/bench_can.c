@@ -0,0 +1,317 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * CAN receive rate of drivers/can/halcogen_can.c with csp_if_can, on the
+ * DCAN register simulator of the host tests (test/halcogen). A trace of CFP
+ * frames is replayed into the simulator and the packets are received on a
+ * socket. The simulated bus has no bit timing, so this is the ceiling set by
+ * the interrupt handler, the CAN task and the router; a 1 Mbit/s bus carries
+ * at most about 8700 extended frames/s.
+ *
+ * Without -r the trace is generated: packets of 200 bytes from each source
+ * to this node, in groups of three with their frames interleaved. The last
+ * packet of a group comes from a second node forwarding for the source of
+ * the first one, same CFP source with another CFP identifier. Each group also
+ * carries a packet for another node, which the acceptance filter drops.
+ *
+ * Traces are read and written in the candump -L format, frames for node 1
+ * are received:
+ *
+ *   (0000000000.000000) can0 02086400#8412940000C80000
+ *
+ * Frames are replayed as fast as the CAN RX queue of csp_if_can drains. The
+ * queue is found by wrapping csp_queue_create (see the Makefile).
+ *
+ * usage: bench_can [-r trace] [-w trace] [packets per source] [sources]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+#include <csp/interfaces/csp_if_can.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/arch/csp_queue.h>
+#include <csp/drivers/can.h>
+
+#include "halcogen/sim_halcogen.h"
+#include "bench.h"
+
+#define ADDRESS		1
+#define OTHER		3
+#define PORT		10
+#define PACKET_SIZE	200
+#define MAX_SOURCES	16
+
+/* Packets with their frames interleaved */
+#define GROUP		3
+
+/* Frames in the CAN RX queue of csp_if_can, which holds 100 */
+#define QUEUED		90
+
+/* Frames of one packet of PACKET_SIZE bytes */
+#define PACKET_FRAMES	((PACKET_SIZE + 6 + 7) / 8)
+
+static volatile unsigned long received;
+
+csp_queue_handle_t __real_csp_queue_create(int length, size_t item_size);
+
+static csp_queue_handle_t can_rx_queue;
+
+csp_queue_handle_t __wrap_csp_queue_create(int length, size_t item_size) {
+
+	csp_queue_handle_t queue = __real_csp_queue_create(length, item_size);
+
+	if (item_size == sizeof(can_frame_t))
+		can_rx_queue = queue;
+
+	return queue;
+
+}
+
+static CSP_DEFINE_TASK(sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+
+	csp_bind(sock, PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		received++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+typedef struct {
+	can_frame_t * frame;
+	unsigned long count;
+	unsigned long size;
+} trace_t;
+
+static can_frame_t * trace_add(trace_t * trace) {
+
+	if (trace->count == trace->size) {
+		trace->size = trace->size ? 2 * trace->size : 1024;
+		trace->frame = realloc(trace->frame, trace->size * sizeof(can_frame_t));
+		if (trace->frame == NULL) {
+			printf("out of memory\n");
+			exit(1);
+		}
+	}
+
+	return &trace->frame[trace->count++];
+
+}
+
+/* CFP frames of one packet, as csp_can_tx sends them. Packets with another
+ * number have another payload, so duplicate detection does not drop them. */
+static void cfp_build(can_frame_t * cfp, int src, int dst, int ident, unsigned long number) {
+
+	uint8_t payload[PACKET_SIZE];
+	csp_id_t id = {.pri = CSP_PRIO_NORM, .src = src, .dst = dst, .dport = PORT, .sport = 20};
+	uint32_t id_be = csp_hton32(id.ext);
+	uint16_t length_be = csp_hton16(PACKET_SIZE);
+	int sent = 0, bytes;
+
+	memset(payload, src, sizeof(payload));
+	memcpy(payload, &number, sizeof(number));
+
+	while (sent < PACKET_SIZE) {
+		can_id_t cid = CFP_MAKE_SRC(src) | CFP_MAKE_DST(dst) | CFP_MAKE_ID(ident);
+		if (sent == 0) {
+			bytes = 2;
+			memcpy(cfp->data, &id_be, sizeof(id_be));
+			memcpy(cfp->data + 4, &length_be, sizeof(length_be));
+			memcpy(cfp->data + 6, payload, bytes);
+			cid |= CFP_MAKE_TYPE(0) | CFP_MAKE_REMAIN((PACKET_SIZE + 6 - 1) / 8);
+			cfp->dlc = 8;
+		} else {
+			bytes = (PACKET_SIZE - sent >= 8) ? 8 : PACKET_SIZE - sent;
+			memcpy(cfp->data, payload + sent, bytes);
+			cid |= CFP_MAKE_TYPE(1) | CFP_MAKE_REMAIN((PACKET_SIZE - sent - bytes + 7) / 8);
+			cfp->dlc = bytes;
+		}
+		cfp->id = cid;
+		cfp++;
+		sent += bytes;
+	}
+
+}
+
+static void trace_generate(trace_t * trace, unsigned long count, int sources) {
+
+	static can_frame_t cfp[GROUP + 1][PACKET_FRAMES];
+	unsigned long packet, seq, total = count * sources;
+	int i, n, frame, src = 0;
+
+	for (packet = 0; packet < total; packet += GROUP) {
+		for (n = 0; (n < GROUP) && (packet + n < total); n++) {
+			seq = (packet + n) / sources;
+			if (n == 0)
+				src = 2 + (packet + n) % sources;
+			if (n == GROUP - 1)
+				cfp_build(cfp[n], src, ADDRESS, (seq & 0x1FF) | 0x200, packet + n);
+			else
+				cfp_build(cfp[n], 2 + (packet + n) % sources, ADDRESS, seq & 0x1FF, packet + n);
+		}
+		cfp_build(cfp[n], src, OTHER, packet & 0x3FF, total + packet);
+		for (frame = 0; frame < PACKET_FRAMES; frame++)
+			for (i = 0; i <= n; i++)
+				*trace_add(trace) = cfp[i][frame];
+	}
+
+}
+
+static int trace_read(trace_t * trace, const char * path) {
+
+	FILE * f = fopen(path, "r");
+	char line[128], hex[17];
+	unsigned int id, byte;
+	can_frame_t * frame;
+	int i;
+
+	if (f == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		/* Extended data frames only */
+		if ((sscanf(line, "(%*[^)]) %*s %8x#%16[0-9A-Fa-f]", &id, hex) != 2) || (strchr(line, '#')[-9] != ' '))
+			continue;
+		frame = trace_add(trace);
+		frame->id = id & 0x1FFFFFFF;
+		frame->dlc = strlen(hex) / 2;
+		for (i = 0; i < frame->dlc; i++) {
+			sscanf(&hex[2 * i], "%2x", &byte);
+			frame->data[i] = byte;
+		}
+	}
+
+	fclose(f);
+	return 0;
+
+}
+
+/* Timestamps assume a 1 Mbit/s bus, about 130 us per frame */
+static int trace_write(const trace_t * trace, const char * path) {
+
+	FILE * f = fopen(path, "w");
+	unsigned long i, us;
+	int j;
+
+	if (f == NULL)
+		return -1;
+
+	for (i = 0; i < trace->count; i++) {
+		us = i * 130;
+		fprintf(f, "(%010lu.%06lu) can0 %08X#", us / 1000000, us % 1000000, (unsigned int) trace->frame[i].id);
+		for (j = 0; j < trace->frame[i].dlc; j++)
+			fprintf(f, "%02X", trace->frame[i].data[j]);
+		fprintf(f, "\n");
+	}
+
+	return fclose(f);
+
+}
+
+int main(int argc, char ** argv) {
+
+	const char * read_path = NULL, * write_path = NULL;
+	unsigned long count, i, filtered, expected = 0, done;
+	trace_t trace = {0};
+	csp_thread_handle_t handle;
+	uint64_t start, elapsed;
+	int sources, opt;
+
+	while ((opt = getopt(argc, argv, "r:w:")) != -1) {
+		if (opt == 'r')
+			read_path = optarg;
+		else if (opt == 'w')
+			write_path = optarg;
+		else
+			return 1;
+	}
+	count = (optind < argc) ? strtoul(argv[optind], NULL, 0) : 2000;
+	sources = (optind + 1 < argc) ? atoi(argv[optind + 1]) : 4;
+	if (sources < 1 || sources > MAX_SOURCES)
+		sources = 4;
+
+	if (read_path != NULL) {
+		if (trace_read(&trace, read_path) != 0) {
+			printf("cannot read %s\n", read_path);
+			return 1;
+		}
+	} else {
+		trace_generate(&trace, count, sources);
+	}
+	if ((write_path != NULL) && (trace_write(&trace, write_path) != 0)) {
+		printf("cannot write %s\n", write_path);
+		return 1;
+	}
+
+	bench_quiet();
+	csp_buffer_init(100, 256);
+	csp_init(ADDRESS);
+	csp_route_start_task(0, 0);
+	if (csp_can_init(CSP_CAN_MASKED, NULL) != CSP_ERR_NONE) {
+		printf("csp_can_init failed\n");
+		return 1;
+	}
+	csp_thread_create(sink, "SINK", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	start = bench_ns();
+	for (i = 0; i < trace.count; i++) {
+		while (csp_queue_size(can_rx_queue) >= QUEUED)
+			sched_yield();
+		filtered = sim_can_stats.filtered;
+		sim_can_receive(trace.frame[i].id, trace.frame[i].data, trace.frame[i].dlc);
+		if ((sim_can_stats.filtered == filtered) && (CFP_REMAIN(trace.frame[i].id) == 0))
+			expected++;
+	}
+
+	/* Wait until no packet has arrived for 100 ms */
+	do {
+		done = received;
+		csp_sleep_ms(100);
+	} while ((received != done) || (csp_queue_size(can_rx_queue) != 0));
+	elapsed = bench_ns() - start - 100000000;
+
+	printf("%lu frames, %lu filtered, %lu packets for this node\n", trace.count,
+			(unsigned long) sim_can_stats.filtered, expected);
+	printf("received %lu packets, %lu lost, %lu frame errors, %lu frames dropped at the RX queue\n",
+			(unsigned long) received, expected - received, (unsigned long) csp_if_can.frame,
+			(unsigned long) csp_if_can.rx_error);
+	printf("%.0f frames/s, %.0f packets/s, %.1f IF transfers per frame\n", trace.count / (elapsed / 1e9),
+			received / (elapsed / 1e9), (double) sim_can_stats.if_transfers / trace.count);
+
+	return 0;
+
+}
@@ -0,0 +1,240 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * CAN transmit rate of drivers/can/halcogen_can.c with csp_if_can, on the
+ * DCAN register simulator of the host tests (test/halcogen). Packets are
+ * sent to node 2 while a bus task takes one frame at a time from the message
+ * objects, at the time an extended frame of its DLC takes on the bus
+ * (67 + 8 * DLC bits, without stuff bits). The frames are reassembled and
+ * checked as they leave, every packet must arrive whole and in order.
+ *
+ * Bus utilisation is the share of the run the bus was sending. The TX bank
+ * keeps it busy while the CPU prepares the next frames.
+ *
+ * Each frame carries only the bytes of its DLC. The padded column is the
+ * bus time per packet if every frame was sent with 8 bytes, as the driver
+ * did before, and packets that were padded do not reassemble.
+ *
+ * usage: bench_can_tx [packets] [packet size, 0 for all] [kbit/s, 0 for no bit timing]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+#include <csp/interfaces/csp_if_can.h>
+#include <csp/arch/csp_thread.h>
+
+#include "halcogen/sim_halcogen.h"
+#include "bench.h"
+
+#define ADDRESS		1
+#define PEER		2
+#define PORT		10
+#define MAX_SIZE	256
+
+/* Extended data frame without stuff bits, including the interframe space */
+#define FRAME_BITS(dlc)	(67 + 8 * (dlc))
+
+static unsigned int bitrate;
+static volatile int bus_stop;
+static volatile unsigned long frames;
+static uint64_t bus_ns, bits, padded_bits;
+
+/* Reassembly of the transmitted packets */
+static unsigned long packets_ok, packets_broken, number;
+static uint8_t rx_data[MAX_SIZE];
+static int rx_length = -1, rx_count, rx_ident;
+
+static uint8_t payload_byte(unsigned long n, int i) {
+
+	return (uint8_t) (n * 7 + i);
+
+}
+
+static void packet_check(void) {
+
+	int i;
+
+	for (i = 0; i < rx_length; i++)
+		if (rx_data[i] != payload_byte(number, i))
+			break;
+	if (i == rx_length)
+		packets_ok++;
+	else
+		packets_broken++;
+	number++;
+	rx_length = -1;
+
+}
+
+static void bus_rx(uint32 id, const uint8 * data, uint8 dlc) {
+
+	uint16_t length_be;
+
+	frames++;
+	bits += FRAME_BITS(dlc);
+	padded_bits += FRAME_BITS(8);
+
+	if (CFP_TYPE(id) == 0) {
+		if (rx_length >= 0) {
+			packets_broken++;
+			number++;
+		}
+		memcpy(&length_be, data + 4, sizeof(length_be));
+		rx_length = csp_ntoh16(length_be);
+		rx_ident = CFP_ID(id);
+		rx_count = dlc - 6;
+		memcpy(rx_data, data + 6, rx_count);
+	} else {
+		/* The rest of a broken packet is ignored */
+		if (rx_length < 0)
+			return;
+		if ((CFP_ID(id) != rx_ident) || (rx_count + dlc > rx_length)) {
+			packets_broken++;
+			number++;
+			rx_length = -1;
+			return;
+		}
+		memcpy(rx_data + rx_count, data, dlc);
+		rx_count += dlc;
+	}
+
+	if ((CFP_REMAIN(id) == 0) && (rx_count == rx_length))
+		packet_check();
+
+}
+
+/* Sends one frame per frame time */
+static CSP_DEFINE_TASK(bus) {
+
+	uint64_t next = 0, frame_ns, now;
+	int dlc;
+
+	while (!bus_stop) {
+		dlc = sim_can_bus_send();
+		if (dlc < 0) {
+			sched_yield();
+			continue;
+		}
+		if (bitrate == 0)
+			continue;
+		frame_ns = FRAME_BITS(dlc) * 1000000ULL / bitrate;
+		bus_ns += frame_ns;
+		now = bench_ns();
+		next = ((next > now) ? next : now) + frame_ns;
+		while (bench_ns() < next)
+			sched_yield();
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_size(unsigned long count, int size) {
+
+	unsigned long sent, done;
+	csp_packet_t * packet;
+	uint64_t start, elapsed;
+	int i;
+
+	frames = 0;
+	bits = 0;
+	padded_bits = 0;
+	bus_ns = 0;
+	packets_ok = 0;
+	packets_broken = 0;
+	number = 0;
+
+	start = bench_ns();
+	for (sent = 0; sent < count; sent++) {
+		packet = csp_buffer_get(size);
+		if (packet == NULL)
+			break;
+		for (i = 0; i < size; i++)
+			packet->data[i] = payload_byte(sent, i);
+		packet->length = size;
+		if (csp_sendto(CSP_PRIO_NORM, PEER, PORT, 20, CSP_O_NONE, packet, 0) != CSP_ERR_NONE) {
+			csp_buffer_free(packet);
+			break;
+		}
+	}
+
+	/* Until the bank has drained */
+	do {
+		done = frames;
+		csp_sleep_ms(10);
+	} while (frames != done);
+	elapsed = bench_ns() - start - 10000000;
+
+	printf("%4d  %10.1f  %8.0f  %15.0f  %8.0f  %5.1f  %8lu  %6lu\n", size, (double) frames / sent,
+			(double) bits / sent, (double) padded_bits / sent, packets_ok / (elapsed / 1e9),
+			bitrate ? 100.0 * bus_ns / elapsed : 0.0, packets_ok, packets_broken + (sent - number));
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {4, 20, 50, 100, 200};
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000;
+	int size = (argc > 2) ? atoi(argv[2]) : 0;
+	csp_thread_handle_t handle;
+	unsigned int s;
+
+	bitrate = (argc > 3) ? strtoul(argv[3], NULL, 0) : 1000;
+	if ((size < 0) || (size > MAX_SIZE))
+		size = 0;
+
+	bench_quiet();
+	csp_buffer_init(20, MAX_SIZE);
+	csp_init(ADDRESS);
+	if (csp_can_init(CSP_CAN_MASKED, NULL) != CSP_ERR_NONE) {
+		printf("csp_can_init failed\n");
+		return 1;
+	}
+	csp_rtable_set(PEER, CSP_ID_HOST_SIZE, &csp_if_can, CSP_NODE_MAC);
+
+	sim_can_tx = bus_rx;
+	sim_can_bus_hold = 1;
+	csp_thread_create(bus, "BUS", 0, NULL, 0, &handle);
+
+	if (bitrate)
+		printf("%lu packets per size, %u kbit/s\n", count, bitrate);
+	else
+		printf("%lu packets per size, no bit timing\n", count);
+	printf("size  frames/pkt  bits/pkt  bits/pkt padded     pkt/s  bus %%     whole  broken\n");
+
+	if (size > 0) {
+		bench_size(count, size);
+	} else {
+		for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+			bench_size(count, sizes[s]);
+	}
+
+	bus_stop = 1;
+	printf("%lu tx errors\n", (unsigned long) csp_if_can.tx_error);
+
+	return 0;
+
+}
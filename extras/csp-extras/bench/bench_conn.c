@@ -0,0 +1,188 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Connection lookup time of csp_conn_find, and router time per packet for
+ * packets to open connections, as the number of open client connections
+ * grows to CSP_CONN_MAX. The indexed lookup (mask CSP_ID_CONN_MASK) is
+ * compared with the scan of the pool that it replaced, which csp_conn_find
+ * still does for any other mask. The routed packets are queued a batch at a
+ * time and csp_route_work, run without a router task, delivers the batch to
+ * the connection RX queues. Also reports csp_connect and csp_close pairs per
+ * second with the pool full but one connection.
+ *
+ * CSP_CONN_MAX is fixed at build time, the Makefile builds csp_conn.c and
+ * this file once per pool size, as bench_conn_<CSP_CONN_MAX>.
+ *
+ * usage: bench_conn_<connections> [lookups]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/interfaces/csp_if_lo.h>
+
+#include "csp_conn.h"
+#include "bench.h"
+
+/* The scan path compares the same bits, and the priority which is always 0 here */
+#define SCAN_MASK	(CSP_ID_CONN_MASK | CSP_ID_PRIO_MASK)
+
+/* Packets queued per csp_route_work call, at most one router batch */
+#if (CSP_ROUTE_BATCH < 8)
+#define BURST		CSP_ROUTE_BATCH
+#else
+#define BURST		8
+#endif
+
+/* Client connections differ in the remote address and port, 16 x 64 ids */
+static csp_id_t bench_id(int n) {
+
+	csp_id_t id;
+
+	id.ext = 0;
+	id.src = 2 + n % 16;
+	id.dst = 1;
+	id.dport = 40;
+	id.sport = n / 16;
+
+	return id;
+
+}
+
+/* Average lookup time in ns for the open connections, or for a miss */
+static double bench_lookup(int open, unsigned long count, uint32_t mask, int miss) {
+
+	unsigned long i;
+	uint64_t start;
+	uint32_t id;
+
+	start = bench_ns();
+	for (i = 0; i < count; i++) {
+		id = bench_id(miss ? open + i % 4 : i % open).ext;
+		if ((csp_conn_find(id, mask) == NULL) != miss) {
+			printf("lookup of %08lx failed\n", (unsigned long) id);
+			exit(1);
+		}
+	}
+
+	return (double) (bench_ns() - start) / count;
+
+}
+
+/* Average router time in ns per packet, for packets spread over the open connections */
+static double bench_route(csp_conn_t ** conn, int open, unsigned long count) {
+
+	static uint32_t serial;
+	csp_packet_t * packet;
+	unsigned long i;
+	uint64_t start, total = 0;
+	int n[BURST], j;
+
+	for (i = 0; i < count; i += BURST) {
+
+		for (j = 0; j < BURST; j++) {
+			n[j] = (i + j) % open;
+			packet = csp_buffer_get(sizeof(serial));
+			if (packet == NULL) {
+				printf("out of buffers\n");
+				exit(1);
+			}
+			/* Distinct payloads, so duplicate detection does not drop them */
+			packet->id = bench_id(n[j]);
+			memcpy(packet->data, &serial, sizeof(serial));
+			packet->length = sizeof(serial);
+			serial++;
+			csp_qfifo_write(packet, &csp_if_lo, NULL);
+		}
+
+		start = bench_ns();
+		csp_route_work(0);
+		total += bench_ns() - start;
+
+		for (j = 0; j < BURST; j++) {
+			packet = csp_read(conn[n[j]], 0);
+			if (packet == NULL) {
+				printf("packet to connection %d not delivered\n", n[j]);
+				exit(1);
+			}
+			csp_buffer_free(packet);
+		}
+
+	}
+
+	return (double) total / (count - count % BURST);
+
+}
+
+int main(int argc, char ** argv) {
+
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+	csp_conn_t * conn[CSP_CONN_MAX];
+	unsigned long i, cycles;
+	double hit, scan, miss, scan_miss, route;
+	uint64_t start;
+	int open, next;
+
+	bench_quiet();
+	csp_buffer_init(20, 256);
+	csp_init(1);
+
+	printf("CSP_CONN_MAX %d, %lu lookups, %lu routed packets\n", CSP_CONN_MAX, count, count / 10);
+	printf("open  hit ns  scan ns  miss ns  scan miss ns  route ns\n");
+
+	/* Rows at powers of two and at the full pool */
+	for (open = 1, next = 1; open <= CSP_CONN_MAX; open++) {
+		conn[open - 1] = csp_conn_new(bench_id(open - 1), bench_id(open - 1));
+		if (conn[open - 1] == NULL) {
+			printf("%4d  csp_conn_new failed\n", open);
+			return 1;
+		}
+		if ((open != next) && (open != CSP_CONN_MAX))
+			continue;
+		next *= 2;
+		hit = bench_lookup(open, count, CSP_ID_CONN_MASK, 0);
+		scan = bench_lookup(open, count, SCAN_MASK, 0);
+		miss = bench_lookup(open, count, CSP_ID_CONN_MASK, 1);
+		scan_miss = bench_lookup(open, count, SCAN_MASK, 1);
+		route = bench_route(conn, open, count / 10);
+		printf("%4d  %6.1f  %7.1f  %7.1f  %12.1f  %8.1f\n", open, hit, scan, miss, scan_miss, route);
+	}
+
+	/* Ephemeral port search and index updates */
+	csp_close(conn[CSP_CONN_MAX - 1]);
+	cycles = count / 100;
+	start = bench_ns();
+	for (i = 0; i < cycles; i++) {
+		conn[0] = csp_connect(CSP_PRIO_NORM, 3, 10, 0, CSP_O_NONE);
+		if (conn[0] == NULL) {
+			printf("csp_connect failed\n");
+			return 1;
+		}
+		csp_close(conn[0]);
+	}
+	printf("csp_connect + csp_close: %.0f/s\n", cycles / ((bench_ns() - start) / 1e9));
+
+	return 0;
+
+}
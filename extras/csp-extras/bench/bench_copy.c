@@ -0,0 +1,242 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Buffer pool occupancy and bytes copied during a lossy RDP transfer with the
+ * promiscuous tap enabled. The transfer runs over an interface that drops a
+ * share of the packets and loops the rest back to the router.
+ *
+ * The library is linked with csp_buffer_clone, csp_buffer_ref and
+ * csp_buffer_cow wrapped (see the Makefile), to count the bytes they copy.
+ * The "copy" run emulates the buffers before copy-on-write: every clone
+ * copies the whole buffer and the promiscuous tap gets a clone instead of a
+ * reference.
+ *
+ * usage: bench_copy [packets] [loss percent]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define RDP_PORT	11
+#define PACKET_SIZE	200
+
+void * __real_csp_buffer_clone(void * buffer);
+void * __real_csp_buffer_ref(void * buffer);
+void * __real_csp_buffer_cow(void * buffer);
+
+static int copy_mode;
+static unsigned long long copied;
+static unsigned long clones;
+
+void * __wrap_csp_buffer_clone(void * buffer) {
+
+	csp_packet_t * clone = __real_csp_buffer_clone(buffer);
+
+	if (clone != NULL) {
+		clones++;
+		copied += copy_mode ? (unsigned long) csp_buffer_size() :
+				CSP_BUFFER_PACKET_OVERHEAD + clone->length;
+	}
+
+	return clone;
+
+}
+
+void * __wrap_csp_buffer_ref(void * buffer) {
+
+	if (copy_mode)
+		return __wrap_csp_buffer_clone(buffer);
+
+	return __real_csp_buffer_ref(buffer);
+
+}
+
+void * __wrap_csp_buffer_cow(void * buffer) {
+
+	csp_packet_t * own = __real_csp_buffer_cow(buffer);
+
+	if ((own != NULL) && (own != buffer)) {
+		clones++;
+		copied += CSP_BUFFER_PACKET_OVERHEAD + own->length;
+	}
+
+	return own;
+
+}
+
+/* Lossy loopback */
+static unsigned int loss;
+static unsigned long tx, dropped;
+static int buffers, in_use_max;
+static unsigned long long in_use_sum;
+
+static int lossy_tx(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	int in_use = buffers - csp_buffer_remaining();
+
+	tx++;
+	in_use_sum += in_use;
+	if (in_use > in_use_max)
+		in_use_max = in_use;
+
+	if ((unsigned int) (rand() % 100) < loss) {
+		dropped++;
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+
+	csp_qfifo_write(packet, interface, NULL);
+	return CSP_ERR_NONE;
+
+}
+
+static csp_iface_t csp_if_lossy = {
+	.name = "LOSSY",
+	.nexthop = lossy_tx,
+};
+
+static volatile unsigned long received;
+
+static CSP_DEFINE_TASK(rdp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_RDPREQ);
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	csp_bind(sock, RDP_PORT);
+	csp_listen(sock, 5);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn == NULL)
+			continue;
+		while ((packet = csp_read(conn, 1000)) != NULL) {
+			received++;
+			csp_buffer_free(packet);
+		}
+		csp_close(conn);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(promisc_sink) {
+
+	csp_packet_t * packet;
+
+	while (1) {
+		packet = csp_promisc_read(CSP_MAX_DELAY);
+		if (packet != NULL)
+			csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_transfer(const char * name, unsigned long count) {
+
+	unsigned long sent;
+	uint64_t start;
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	received = 0;
+	copied = 0;
+	clones = 0;
+	tx = 0;
+	dropped = 0;
+	in_use_max = 0;
+	in_use_sum = 0;
+	srand(1);
+	start = bench_ns();
+
+	conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), RDP_PORT, 1000, CSP_O_RDP);
+	if (conn == NULL) {
+		printf("%-6s  connect failed\n", name);
+		return;
+	}
+
+	for (sent = 0; sent < count; sent++) {
+		while ((packet = csp_buffer_get(PACKET_SIZE)) == NULL)
+			csp_sleep_ms(1);
+		memset(packet->data, 0, PACKET_SIZE);
+		memcpy(packet->data, &sent, sizeof(sent));
+		packet->length = PACKET_SIZE;
+		if (!csp_send(conn, packet, 1000)) {
+			csp_buffer_free(packet);
+			break;
+		}
+	}
+
+	while (received < sent && bench_ns() - start < 60000000000ULL)
+		csp_sleep_ms(1);
+
+	csp_close(conn);
+
+	printf("%-6s  %8lu  %6lu  %7lu  %10.1f  %8d  %8.1f  %9.1f\n", name, received, dropped, clones,
+			copied / 1024.0, in_use_max, tx ? (double) in_use_sum / tx : 0.0,
+			received / ((bench_ns() - start) / 1e9));
+
+	/* Let the connection close before the next run */
+	csp_sleep_ms(200);
+
+}
+
+int main(int argc, char ** argv) {
+
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 5000;
+	csp_thread_handle_t handle;
+
+	loss = (argc > 2) ? strtoul(argv[2], NULL, 0) : 5;
+
+	bench_quiet();
+	csp_buffer_init(100, 256);
+	buffers = csp_buffer_remaining();
+	csp_init(1);
+	csp_rtable_set(1, CSP_ID_HOST_SIZE, &csp_if_lossy, CSP_NODE_MAC);
+	csp_promisc_enable(20);
+	csp_route_start_task(0, 0);
+	csp_rdp_set_opt(20, 10000, 1000, 1, 100, 4);
+
+	csp_thread_create(rdp_sink, "RDP", 0, NULL, 0, &handle);
+	csp_thread_create(promisc_sink, "PROMISC", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	printf("%lu packets of %d bytes, %u%% loss, %d buffers\n", count, PACKET_SIZE, loss, buffers);
+	printf("mode    received  dropped  copies  copied KiB  max used  avg used      pkt/s\n");
+
+	copy_mode = 1;
+	bench_transfer("copy", count);
+	copy_mode = 0;
+	bench_transfer("shared", count);
+
+	return 0;
+
+}
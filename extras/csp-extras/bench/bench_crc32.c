@@ -0,0 +1,107 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * csp_crc32_memory throughput for the kernel selected at build time, compared
+ * with the byte at a time table loop it replaced. Build with
+ * CFLAGS="-O2 -g -msse4.2" for the CRC32C instruction, the slicing kernels
+ * are checked against the reference by make check.
+ *
+ * usage: bench_crc32 [MB per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <csp/csp.h>
+#include <csp/csp_crc32.h>
+
+#include "bench.h"
+
+static uint32_t ref_tab[256];
+
+static void ref_gentab(void) {
+
+	uint32_t crc;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+		ref_tab[i] = crc;
+	}
+
+}
+
+static uint32_t ref_crc32(const uint8_t * data, uint32_t length) {
+
+	uint32_t crc = 0xFFFFFFFF;
+
+	while (length--)
+		crc = ref_tab[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFF;
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {16, 64, 256, 1024, 4096};
+	static uint8_t buf[4096];
+	unsigned long mb = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200;
+	unsigned long n, count;
+	volatile uint32_t sink = 0;
+	double kernel, bytewise;
+	unsigned int s, i;
+	uint64_t start;
+
+	ref_gentab();
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 31;
+
+	printf("%lu MB per size\n", mb);
+	printf("size  kernel MB/s  byte MB/s  speedup\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		count = mb * 1000000 / sizes[s];
+		if (csp_crc32_memory(buf, sizes[s]) != ref_crc32(buf, sizes[s])) {
+			printf("%4d  CRC mismatch\n", sizes[s]);
+			return 1;
+		}
+
+		start = bench_ns();
+		for (n = 0; n < count; n++)
+			sink += csp_crc32_memory(buf, sizes[s]);
+		kernel = (double) count * sizes[s] / ((bench_ns() - start) / 1e3);
+
+		start = bench_ns();
+		for (n = 0; n < count; n++)
+			sink += ref_crc32(buf, sizes[s]);
+		bytewise = (double) count * sizes[s] / ((bench_ns() - start) / 1e3);
+
+		printf("%4d  %11.1f  %9.1f  %7.2f\n", sizes[s], kernel, bytewise, kernel / bytewise);
+
+	}
+
+	return 0;
+
+}
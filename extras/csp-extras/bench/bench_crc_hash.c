@@ -0,0 +1,85 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Cost per byte of the duplicate detection hashes: crc_hash with the TMS570
+ * CRC module, the software PSA signature crc_hash falls back to, and
+ * csp_crc32_memory. The module runs in the register simulator of the host
+ * tests (test/halcogen), which does not model its timing, so for the module
+ * the CPU side is given as register accesses per byte; the software hashes
+ * are timed in CPU cycles per byte (TSC cycles on x86).
+ *
+ * usage: bench_crc_hash [calls per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <csp/csp.h>
+#include <csp/csp_crc32.h>
+#include <csp/drivers/crc.h>
+
+#include "halcogen/sim_halcogen.h"
+#include "bench.h"
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {16, 64, 256, 1024};
+	static uint8_t buf[1024];
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+	double soft[4], crc32[4], accesses;
+	volatile uint32_t sink = 0;
+	unsigned long n;
+	unsigned int s, i;
+	uint64_t start;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 31;
+
+	/* crc_hash before crc_init calculates the signature in software */
+	for (s = 0; s < 4; s++) {
+		start = bench_cycles();
+		for (n = 0; n < count; n++)
+			sink += crc_hash(buf, sizes[s]);
+		soft[s] = (double) (bench_cycles() - start) / count / sizes[s];
+
+		start = bench_cycles();
+		for (n = 0; n < count; n++)
+			sink += csp_crc32_memory(buf, sizes[s]);
+		crc32[s] = (double) (bench_cycles() - start) / count / sizes[s];
+	}
+
+	crc_init();
+
+	printf("%lu calls per size, CRC_DMA_MIN_WORDS 0\n", count);
+	printf("size  PSA soft c/B  crc32 c/B  module accesses/B  PSA writes/B\n");
+
+	for (s = 0; s < 4; s++) {
+		/* One call is enough to count the register accesses */
+		sim_stats = (sim_stats_t) {0};
+		sink += crc_hash(buf, sizes[s]);
+		accesses = sim_stats.psa_writes + sim_stats.reg_writes + sim_stats.reg_reads;
+		printf("%4d  %12.2f  %9.2f  %17.3f  %12.3f\n", sizes[s], soft[s], crc32[s],
+				accesses / sizes[s], (double) sim_stats.psa_writes / sizes[s]);
+	}
+
+	return 0;
+
+}
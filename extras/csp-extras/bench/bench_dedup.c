@@ -0,0 +1,116 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Duplicate detection cost per packet by packet size, and the share of
+ * repeated packets detected by the distance in new packets between the
+ * original and the repeat. Every packet of the timed runs
+ * is checked twice, so half of them must be found to be duplicates. The
+ * Makefile builds it once per table size, as bench_dedup_<CSP_DEDUP_COUNT>.
+ *
+ * usage: bench_dedup_<entries> [packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+
+#include "csp_dedup.h"
+#include "bench.h"
+
+/* Table size the csp_dedup.c linked in was built with */
+#ifndef CSP_DEDUP_COUNT
+#define CSP_DEDUP_COUNT		16
+#endif
+
+/* Stamp a packet with a number at the start and at the end */
+static void packet_stamp(csp_packet_t * packet, uint32_t number) {
+
+	memcpy(&packet->data[0], &number, sizeof(number));
+	memcpy(&packet->data[packet->length - sizeof(number)], &number, sizeof(number));
+
+}
+
+/* Detected share of packets repeated after distance new packets */
+static double bench_distance(csp_packet_t * packet, uint32_t base, unsigned int distance) {
+
+	const unsigned int count = 2000;
+	unsigned int i, found = 0;
+
+	for (i = 0; i < count + distance; i++) {
+		packet_stamp(packet, base + i);
+		csp_dedup_is_duplicate(0, packet);
+		if (i >= distance) {
+			packet_stamp(packet, base + i - distance);
+			found += csp_dedup_is_duplicate(0, packet);
+		}
+	}
+
+	return 100.0 * found / count;
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {16, 64, 200};
+	static const unsigned int distances[] = {1, 4, 12, 16, 64, 200, 256, 800, 1024, 2048};
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	csp_packet_t * packet;
+	unsigned long i, found;
+	unsigned int s, d;
+	uint32_t number = 0;
+	uint64_t start;
+	double ns;
+
+	bench_quiet();
+	csp_buffer_init(4, 256);
+	packet = csp_buffer_get(256);
+	memset(packet->data, 0xa5, 256);
+	packet->id.flags = 0;
+
+	printf("CSP_DEDUP_COUNT %d, %lu packets, each checked twice\n", CSP_DEDUP_COUNT, count);
+	printf("size  ns/check  duplicates\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		packet->length = sizes[s];
+		found = 0;
+		start = bench_ns();
+		for (i = 0; i < count; i++) {
+			packet_stamp(packet, number++);
+			found += csp_dedup_is_duplicate(0, packet);
+			found += csp_dedup_is_duplicate(0, packet);
+		}
+		ns = (bench_ns() - start) / (2.0 * count);
+		printf("%4d  %8.1f  %10lu\n", sizes[s], ns, found);
+	}
+
+	printf("\ndistance  detected %%\n");
+
+	packet->length = 64;
+	for (d = 0; d < sizeof(distances) / sizeof(distances[0]); d++) {
+		printf("%8u  %10.1f\n", distances[d], bench_distance(packet, number, distances[d]));
+		number += 100000;
+	}
+
+	return 0;
+
+}
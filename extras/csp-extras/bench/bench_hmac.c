@@ -0,0 +1,109 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * HMAC protected packets per second, csp_hmac_append and csp_hmac_verify with
+ * the precomputed key states, compared with csp_hmac_memory, which keys the
+ * hash for every packet. Both must give the same HMAC.
+ *
+ * usage: bench_hmac [packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+
+#include "crypto/csp_hmac.h"
+#include "crypto/csp_sha1.h"
+#include "bench.h"
+
+#define KEY		"bench"
+#define KEY_LENGTH	16
+
+/* Not in csp_hmac.h, keys the hash on every call as csp_hmac_append used to */
+int csp_hmac_memory(const uint8_t * key, uint32_t keylen, const uint8_t * data, uint32_t datalen, uint8_t * hmac);
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {32, 200};
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 300000;
+	uint8_t key[SHA1_DIGESTSIZE], hmac[SHA1_DIGESTSIZE];
+	csp_packet_t * packet;
+	double cached, keyed;
+	unsigned long i;
+	unsigned int s;
+	uint64_t start;
+	int size;
+
+	bench_quiet();
+	csp_buffer_init(4, 256);
+	csp_init(1);
+	csp_hmac_set_key(KEY, strlen(KEY));
+
+	/* csp_hmac_set_key derives the key with SHA1 */
+	csp_sha1_memory((uint8_t *) KEY, strlen(KEY), key);
+
+	packet = csp_buffer_get(256);
+
+	printf("%lu packets, append and verify per packet\n", count);
+	printf("size  cached pkt/s   keyed pkt/s  speedup\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		size = sizes[s];
+		for (i = 0; i < (unsigned long) size; i++)
+			packet->data[i] = i;
+
+		/* Same HMAC as the reference */
+		packet->length = size;
+		csp_hmac_append(packet, false);
+		csp_hmac_memory(key, KEY_LENGTH, packet->data, size, hmac);
+		if (memcmp(&packet->data[size], hmac, CSP_HMAC_LENGTH) != 0) {
+			printf("%4d  HMAC mismatch\n", size);
+			return 1;
+		}
+
+		start = bench_ns();
+		for (i = 0; i < count; i++) {
+			packet->length = size;
+			csp_hmac_append(packet, true);
+			if (csp_hmac_verify(packet, true) != CSP_ERR_NONE) {
+				printf("%4d  verify failed\n", size);
+				return 1;
+			}
+		}
+		cached = count / ((bench_ns() - start) / 1e9);
+
+		start = bench_ns();
+		for (i = 0; i < count; i++) {
+			csp_hmac_memory(key, KEY_LENGTH, (uint8_t *) &packet->id, size + sizeof(packet->id), hmac);
+			csp_hmac_memory(key, KEY_LENGTH, (uint8_t *) &packet->id, size + sizeof(packet->id), hmac);
+		}
+		keyed = count / ((bench_ns() - start) / 1e9);
+
+		printf("%4d  %12.0f  %12.0f  %7.2f\n", size, cached, keyed, cached / keyed);
+
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,272 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Throughput of 2, 8 and 32 nodes on one csp_hub. Every node is a process
+ * on the zmqhub interface sending 100 byte packets to the next node for a
+ * few seconds, connectionless with a 100 us pause every 8 or 32 packets,
+ * or over RDP. The hub is build/csp_hub next to the bench directory, or
+ * the program given as the second argument.
+ *
+ * usage: bench_hub [seconds] [hub]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <libgen.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/interfaces/csp_if_zmqhub.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/arch/csp_time.h>
+
+#include "bench.h"
+
+#define UDP_PORT	10
+#define RDP_PORT	11
+#define PACKET_SIZE	100
+
+/* Result of one node, written to a pipe shared by all nodes */
+typedef struct {
+	unsigned long tx;
+	unsigned long rx;
+	uint32_t ms;
+} node_result_t;
+
+static volatile unsigned long received;
+
+static CSP_DEFINE_TASK(udp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+
+	csp_bind(sock, UDP_PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		received++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(rdp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_RDPREQ);
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	csp_bind(sock, RDP_PORT);
+	csp_listen(sock, 10);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn == NULL)
+			continue;
+		while ((packet = csp_read(conn, 2000)) != NULL) {
+			received++;
+			csp_buffer_free(packet);
+		}
+		csp_close(conn);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+/* One node, pace is the packets between pauses, 0 for RDP */
+static void bench_node(uint8_t addr, int nodes, const char * path, unsigned int seconds, int pace, int result) {
+
+	uint8_t peer = addr % nodes + 1;
+	csp_thread_handle_t handle;
+	csp_conn_t * conn = NULL;
+	csp_packet_t * packet;
+	node_result_t res;
+	uint32_t start;
+	int tries;
+
+	bench_quiet();
+	csp_buffer_init(400, 256);
+	csp_init(addr);
+
+	/* The hub may not be listening yet */
+	for (tries = 0; csp_zmqhub_init(addr, (char *) path) != CSP_ERR_NONE; tries++) {
+		if (tries == 100)
+			_exit(1);
+		csp_sleep_ms(10);
+	}
+	csp_rtable_set(CSP_DEFAULT_ROUTE, 0, &csp_if_zmqhub, CSP_NODE_MAC);
+	csp_route_start_task(0, 0);
+
+	csp_thread_create(udp_sink, "UDP", 0, NULL, 0, &handle);
+	csp_thread_create(rdp_sink, "RDP", 0, NULL, 0, &handle);
+
+	/* Let every node subscribe before the first packet */
+	csp_sleep_ms(500);
+
+	if (pace == 0) {
+		csp_rdp_set_opt(32, 10000, 2000, 1, 100, 16);
+		conn = csp_connect(CSP_PRIO_NORM, peer, RDP_PORT, 1000, CSP_O_RDP);
+	}
+
+	res.tx = 0;
+	start = csp_get_ms();
+	while (csp_get_ms() - start < seconds * 1000) {
+		packet = csp_buffer_get(PACKET_SIZE);
+		if (packet == NULL) {
+			csp_sleep_ms(1);
+			continue;
+		}
+		/* Distinct payloads, so duplicate detection does not drop them */
+		memset(packet->data, addr, PACKET_SIZE);
+		memcpy(packet->data, &res.tx, sizeof(res.tx));
+		packet->length = PACKET_SIZE;
+		if (pace == 0) {
+			if ((conn == NULL) || !csp_send(conn, packet, 1000)) {
+				csp_buffer_free(packet);
+				continue;
+			}
+		} else if (csp_sendto(CSP_PRIO_NORM, peer, UDP_PORT, 12, CSP_O_NONE, packet, 0) != CSP_ERR_NONE) {
+			csp_buffer_free(packet);
+			continue;
+		}
+		res.tx++;
+		if ((pace > 0) && (res.tx % pace == 0))
+			usleep(100);
+	}
+	res.ms = csp_get_ms() - start;
+
+	/* Packets still in flight */
+	csp_sleep_ms(1500);
+	if (conn != NULL)
+		csp_close(conn);
+
+	res.rx = received;
+	if (write(result, &res, sizeof(res)) != sizeof(res))
+		_exit(1);
+	_exit(0);
+
+}
+
+static void bench_run(const char * hub, const char * path, int nodes, unsigned int seconds, int pace) {
+
+	unsigned long tx = 0, rx = 0, frames = 0, forwarded = 0, dropped = 0, truncated = 0;
+	int result[2], output[2], i;
+	char line[256], mode[24], * last;
+	node_result_t res;
+	uint32_t ms = 0;
+	pid_t hub_pid;
+	FILE * out;
+
+	if ((pipe(result) < 0) || (pipe(output) < 0))
+		return;
+
+	hub_pid = fork();
+	if (hub_pid == 0) {
+		dup2(output[1], STDOUT_FILENO);
+		close(output[0]);
+		close(result[0]);
+		close(result[1]);
+		execl(hub, hub, "-v", path, (char *) NULL);
+		_exit(1);
+	}
+	close(output[1]);
+
+	for (i = 1; i <= nodes; i++) {
+		if (fork() == 0) {
+			close(result[0]);
+			bench_node(i, nodes, path, seconds, pace, result[1]);
+		}
+	}
+	close(result[1]);
+
+	while (read(result[0], &res, sizeof(res)) == sizeof(res)) {
+		tx += res.tx;
+		rx += res.rx;
+		if (res.ms > ms)
+			ms = res.ms;
+	}
+	close(result[0]);
+	for (i = 0; i < nodes; i++)
+		wait(NULL);
+
+	/* The hub prints its counters when it stops */
+	kill(hub_pid, SIGINT);
+	waitpid(hub_pid, NULL, 0);
+	out = fdopen(output[0], "r");
+	last = NULL;
+	while (fgets(line, sizeof(line), out) != NULL)
+		last = line;
+	fclose(out);
+	if (last != NULL)
+		sscanf(last, "Frames %lu, forwarded %lu, dropped %lu, truncated %lu",
+				&frames, &forwarded, &dropped, &truncated);
+
+	if (pace > 0)
+		snprintf(mode, sizeof(mode), "udp 100us/%d", pace);
+	else
+		snprintf(mode, sizeof(mode), "rdp");
+	printf("%5d  %-12s  %8lu  %8lu  %8.0f  %6.1f  %8lu  %9lu\n", nodes, mode, tx, rx,
+			ms ? rx / (ms / 1000.0) : 0.0, tx ? 100.0 * (tx - rx) / tx : 0.0, dropped, truncated);
+	fflush(stdout);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int nodes[] = {2, 8, 32};
+	static const int paces[] = {8, 32, 0};
+	unsigned int seconds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 3;
+	char hub[PATH_MAX], self[PATH_MAX], path[64];
+	unsigned int n, p;
+
+	if (argc > 2) {
+		snprintf(hub, sizeof(hub), "%s", argv[2]);
+	} else {
+		snprintf(self, sizeof(self), "%s", argv[0]);
+		snprintf(hub, sizeof(hub), "%s/../csp_hub", dirname(self));
+	}
+	if (access(hub, X_OK) != 0) {
+		printf("no hub at %s, run make first\n", hub);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "/tmp/bench_hub.%d", (int) getpid());
+
+	printf("%d byte packets to the next node for %u s, %ld cpus\n", PACKET_SIZE, seconds,
+			sysconf(_SC_NPROCESSORS_ONLN));
+	printf("nodes  mode                tx        rx  rx pkt/s  loss %%  hub drop  truncated\n");
+	fflush(stdout);
+
+	for (n = 0; n < sizeof(nodes) / sizeof(nodes[0]); n++)
+		for (p = 0; p < sizeof(paces) / sizeof(paces[0]); p++)
+			bench_run(hub, path, nodes[n], seconds, paces[p]);
+
+	return 0;
+
+}
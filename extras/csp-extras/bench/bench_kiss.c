@@ -0,0 +1,305 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * KISS throughput over a pseudo terminal, the way a serial link is used on a
+ * Linux host. The receiving node opens the pty with drivers/usart and checks
+ * every packet, the sending node writes the master side from several threads
+ * at once, as router workers do. Frames are written in chunks with
+ * csp_kiss_set_write, or a byte at a time with putc. Frames the receiver
+ * rejects (CRC or framing errors) are counted in crc/frame, frames of two
+ * threads interleaved on the line end up there. Packets the receiver's router
+ * input FIFO had no room for are counted in dropped.
+ *
+ * The senders keep at most INFLIGHT packets ahead of the receiver, which
+ * reports its progress through shared memory, so a run is lossless unless
+ * frames are corrupted and MB/s is the rate of a link that is kept busy
+ * without overrunning the receiver.
+ *
+ * usage: bench_kiss [packets per thread] [packet size] [threads]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/interfaces/csp_if_kiss.h>
+#include <csp/drivers/usart.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define TX_ADDRESS	1
+#define RX_ADDRESS	2
+#define PORT		10
+#define MAX_THREADS	8
+
+/* Packets sent but not yet received, below the router input FIFO of the receiver */
+#define INFLIGHT	8
+
+#if (INFLIGHT >= CSP_FIFO_INPUT)
+#error "INFLIGHT must be less than CSP_FIFO_INPUT"
+#endif
+
+/* Shared between the sending and the receiving process */
+typedef struct {
+	volatile unsigned long received;
+	unsigned long bad;
+	unsigned long errors;
+	unsigned long dropped;
+	double mbps;
+} bench_shared_t;
+
+static bench_shared_t * shared;
+static pthread_mutex_t window_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long sent, lost;
+
+static csp_iface_t csp_if_kiss;
+static csp_kiss_handle_t kiss_handle;
+static int master;
+static unsigned long count;
+static int size;
+
+static void master_putc(char c) {
+
+	while (write(master, &c, 1) != 1);
+
+}
+
+static void master_write(char * buf, int len) {
+
+	int n;
+
+	while (len > 0) {
+		n = write(master, buf, len);
+		if (n > 0) {
+			buf += n;
+			len -= n;
+		}
+	}
+
+}
+
+static void * master_read(void * arg) {
+
+	uint8_t buf[4096];
+	int n;
+
+	while ((n = read(master, buf, sizeof(buf))) > 0)
+		csp_kiss_rx(&csp_if_kiss, buf, n, NULL);
+
+	return NULL;
+
+}
+
+static void usart_rx(uint8_t * buf, int len, void * pxTaskWoken) {
+
+	csp_kiss_rx(&csp_if_kiss, buf, len, pxTaskWoken);
+
+}
+
+static void fill(uint8_t * data, uint32_t number) {
+
+	int i;
+
+	memcpy(data, &number, sizeof(number));
+	for (i = sizeof(number); i < size; i++)
+		data[i] = number * 7 + i;
+
+}
+
+/* Receiving node, reports the packets that arrived intact */
+static void receiver(const char * device) {
+
+	struct usart_conf conf = {.device = device, .baudrate = 4000000};
+	uint8_t data[256];
+	unsigned long received = 0;
+	uint64_t start = 0, elapsed;
+	csp_socket_t * sock;
+	csp_packet_t * packet;
+	uint32_t number;
+
+	bench_quiet();
+	csp_buffer_init(1000, 256);
+	csp_init(RX_ADDRESS);
+	csp_route_start_task(0, 0);
+	csp_kiss_init(&csp_if_kiss, &kiss_handle, usart_putc, NULL, "KISS");
+	csp_kiss_set_write(&kiss_handle, usart_putstr);
+	usart_init(&conf);
+	usart_set_callback(usart_rx);
+	csp_rtable_set(TX_ADDRESS, CSP_ID_HOST_SIZE, &csp_if_kiss, CSP_NODE_MAC);
+
+	sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_bind(sock, PORT);
+
+	/* Until nothing has arrived for a second */
+	while ((packet = csp_recvfrom(sock, received ? 1000 : 10000)) != NULL) {
+		if (received == 0)
+			start = bench_ns();
+		received++;
+		memcpy(&number, packet->data, sizeof(number));
+		fill(data, number);
+		if ((packet->length != size) || memcmp(packet->data, data, size))
+			shared->bad++;
+		csp_buffer_free(packet);
+		shared->received = received;
+	}
+	elapsed = bench_ns() - start - 1000000000ULL;
+
+	shared->errors = csp_if_kiss.rx_error + csp_if_kiss.frame;
+	shared->dropped = csp_if_kiss.drop;
+	shared->mbps = received * (double) size / (elapsed / 1e3);
+
+}
+
+/* Wait for room in the window, packets not received after 500 ms were lost */
+static void window_reserve(void) {
+
+	uint64_t wait = bench_ns();
+
+	pthread_mutex_lock(&window_lock);
+	while (sent - shared->received - lost >= INFLIGHT) {
+		if (bench_ns() - wait > 500000000) {
+			lost = sent - shared->received;
+			break;
+		}
+		pthread_mutex_unlock(&window_lock);
+		sched_yield();
+		pthread_mutex_lock(&window_lock);
+	}
+	sent++;
+	pthread_mutex_unlock(&window_lock);
+
+}
+
+static void * sender(void * arg) {
+
+	uint32_t thread = (uintptr_t) arg;
+	csp_packet_t * packet;
+	unsigned long i;
+
+	for (i = 0; i < count; i++) {
+		while ((packet = csp_buffer_get(size)) == NULL)
+			csp_sleep_ms(1);
+		fill(packet->data, thread * count + i);
+		packet->length = size;
+		window_reserve();
+		if (csp_sendto(CSP_PRIO_NORM, RX_ADDRESS, PORT, 20, CSP_O_NONE, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+	}
+
+	return NULL;
+
+}
+
+/* Sending node, the receiving node runs in a child process */
+static void bench_run(int threads, int chunked) {
+
+	pthread_t tid[MAX_THREADS];
+	struct termios tio;
+	pid_t pid;
+	int i;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+		printf("no pseudo terminal\n");
+		return;
+	}
+	tcgetattr(master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(master, TCSANOW, &tio);
+	memset(shared, 0, sizeof(*shared));
+
+	pid = fork();
+	if (pid == 0) {
+		receiver(ptsname(master));
+		fflush(stdout);
+		_exit(0);
+	}
+
+	bench_quiet();
+	csp_buffer_init(300, 256);
+	csp_init(TX_ADDRESS);
+	csp_route_start_task(0, 0);
+	csp_kiss_init(&csp_if_kiss, &kiss_handle, master_putc, NULL, "KISS");
+	if (chunked)
+		csp_kiss_set_write(&kiss_handle, master_write);
+	pthread_create(&tid[0], NULL, master_read, NULL);
+	csp_rtable_set(RX_ADDRESS, CSP_ID_HOST_SIZE, &csp_if_kiss, CSP_NODE_MAC);
+	csp_sleep_ms(300);
+
+	for (i = 0; i < threads; i++)
+		pthread_create(&tid[i], NULL, sender, (void *) (uintptr_t) i);
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+
+	waitpid(pid, NULL, 0);
+
+	printf("%-5s  %7d  %6lu  %8lu  %4lu  %9lu  %7lu  %6.2f\n", chunked ? "write" : "putc", threads, sent,
+			shared->received, shared->bad, shared->errors, shared->dropped, shared->mbps);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int threads[] = {1, 4};
+	unsigned int i;
+	int chunked;
+	pid_t pid;
+
+	count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 5000;
+	size = (argc > 2) ? atoi(argv[2]) : 200;
+	if ((size < 4) || (size > 200))
+		size = 200;
+
+	printf("%lu packets of %d bytes per thread\n", count, size);
+	printf("mode   threads    sent  received   bad  crc/frame  dropped    MB/s\n");
+	fflush(stdout);
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		return 1;
+
+	for (chunked = 1; chunked >= 0; chunked--) {
+		for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+			if ((argc > 3) && (threads[i] != atoi(argv[3])))
+				continue;
+			pid = fork();
+			if (pid == 0) {
+				bench_run(threads[i], chunked);
+				fflush(stdout);
+				_exit(0);
+			}
+			waitpid(pid, NULL, 0);
+		}
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,204 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Loopback throughput of the whole stack: packets go through csp_sendto or
+ * RDP, the loopback interface and the router to a socket of the same node.
+ *
+ * usage: bench_loopback [packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define UDP_PORT	10
+#define RDP_PORT	11
+
+/* Packets in flight on the connection-less path, the router input FIFO is short */
+#define UDP_INFLIGHT	8
+
+static volatile unsigned long received;
+
+static CSP_DEFINE_TASK(udp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+
+	csp_bind(sock, UDP_PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		received++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(rdp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_RDPREQ);
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	csp_bind(sock, RDP_PORT);
+	csp_listen(sock, 5);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn == NULL)
+			continue;
+		while ((packet = csp_read(conn, 1000)) != NULL) {
+			received++;
+			csp_buffer_free(packet);
+		}
+		csp_close(conn);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static csp_packet_t * bench_packet(unsigned long seq, int size) {
+
+	csp_packet_t * packet;
+
+	while ((packet = csp_buffer_get(size)) == NULL)
+		csp_sleep_ms(1);
+
+	/* Distinct payloads, so duplicate detection does not drop them */
+	memset(packet->data, 0, size);
+	memcpy(packet->data, &seq, sizeof(seq) < (size_t) size ? sizeof(seq) : (size_t) size);
+	packet->length = size;
+
+	return packet;
+
+}
+
+static double bench_udp(unsigned long count, int size) {
+
+	unsigned long sent, lost = 0;
+	uint64_t start, wait;
+	csp_packet_t * packet;
+
+	received = 0;
+	start = bench_ns();
+
+	for (sent = 0; sent < count; sent++) {
+		/* Packets that have not arrived after 10 ms were dropped */
+		wait = bench_ns();
+		while (sent - received - lost >= UDP_INFLIGHT) {
+			if (bench_ns() - wait > 10000000) {
+				lost = sent - received;
+				break;
+			}
+			sched_yield();
+		}
+		packet = bench_packet(sent, size);
+		if (csp_sendto(CSP_PRIO_NORM, csp_get_address(), UDP_PORT, 20, CSP_O_NONE, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+	}
+
+	while (received + lost < count && bench_ns() - start < 10000000000ULL)
+		sched_yield();
+
+	return (double) received / ((bench_ns() - start) / 1e9);
+
+}
+
+static double bench_rdp(unsigned long count, int size) {
+
+	unsigned long sent;
+	uint64_t start;
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	received = 0;
+	start = bench_ns();
+
+	conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), RDP_PORT, 1000, CSP_O_RDP);
+	if (conn == NULL)
+		return 0;
+
+	for (sent = 0; sent < count; sent++) {
+		packet = bench_packet(sent, size);
+		if (!csp_send(conn, packet, 1000)) {
+			csp_buffer_free(packet);
+			break;
+		}
+	}
+
+	while (received < sent && bench_ns() - start < 30000000000ULL)
+		csp_sleep_ms(1);
+
+	csp_close(conn);
+
+	return (double) received / ((bench_ns() - start) / 1e9);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {16, 64, 200};
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+	csp_thread_handle_t handle;
+	double pps;
+	unsigned int i;
+	int buffers;
+
+	bench_quiet();
+	csp_buffer_init(100, 256);
+	buffers = csp_buffer_remaining();
+	csp_init(1);
+	csp_route_start_task(0, 0);
+	/* The loopback interface drops what does not fit in the router input FIFO, so
+	 * ACK well before the sender fills it */
+	csp_rdp_set_opt(20, 10000, 1000, 1, 100, 4);
+
+	csp_thread_create(udp_sink, "UDP", 0, NULL, 0, &handle);
+	csp_thread_create(rdp_sink, "RDP", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	printf("%lu packets per run\n", count);
+	printf("size  udp pkt/s   udp MB/s  rdp pkt/s   rdp MB/s\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		pps = bench_udp(count, sizes[i]);
+		printf("%4d  %9.0f  %9.1f", sizes[i], pps, pps * sizes[i] / 1e6);
+		pps = bench_rdp(count / 4, sizes[i]);
+		printf("  %9.0f  %9.1f\n", pps, pps * sizes[i] / 1e6);
+	}
+
+	csp_sleep_ms(100);
+	printf("buffers free %d of %d\n", csp_buffer_remaining(), buffers);
+
+	return 0;
+
+}
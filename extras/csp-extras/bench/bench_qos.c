@@ -0,0 +1,180 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Router latency of CSP_PRIO_CRITICAL packets with and without a flood of
+ * CSP_PRIO_LOW packets, through the loopback interface of one node. A
+ * critical packet is sent every millisecond and carries its send time, the
+ * sink records when it reads it. With CSP_USE_QOS the router takes critical
+ * packets before bulk packets that are already queued.
+ *
+ * usage: bench_qos [critical packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define BULK_PORT	10
+#define CRITICAL_PORT	11
+#define BULK_SIZE	200
+
+static volatile int flood;
+static volatile unsigned long bulk_sent, bulk_received, critical_received;
+static uint32_t * latency;
+static unsigned long count;
+
+static CSP_DEFINE_TASK(bulk_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+
+	csp_bind(sock, BULK_PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		bulk_received++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(critical_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+	uint64_t sent;
+
+	csp_bind(sock, CRITICAL_PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		memcpy(&sent, packet->data, sizeof(sent));
+		if (critical_received < count)
+			latency[critical_received++] = (bench_ns() - sent) / 1000;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+/* Sends as fast as there are buffers, the router input drops what it cannot take */
+static CSP_DEFINE_TASK(bulk_source) {
+
+	csp_packet_t * packet;
+
+	while (1) {
+		if (!flood || ((packet = csp_buffer_get(BULK_SIZE)) == NULL)) {
+			sched_yield();
+			continue;
+		}
+		/* Distinct payloads, so duplicate detection does not drop them */
+		memset(packet->data, 0, BULK_SIZE);
+		memcpy(packet->data, (void *) &bulk_sent, sizeof(bulk_sent));
+		packet->length = BULK_SIZE;
+		if (csp_sendto(CSP_PRIO_LOW, csp_get_address(), BULK_PORT, 20, CSP_O_NONE, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+		bulk_sent++;
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static int compare(const void * a, const void * b) {
+
+	return (*(const uint32_t *) a > *(const uint32_t *) b) - (*(const uint32_t *) a < *(const uint32_t *) b);
+
+}
+
+static void bench_run(const char * name) {
+
+	csp_packet_t * packet;
+	unsigned long i, bulk;
+	uint64_t now, start;
+
+	critical_received = 0;
+	bulk = bulk_received;
+	start = bench_ns();
+
+	for (i = 0; i < count; i++) {
+		csp_sleep_ms(1);
+		packet = csp_buffer_get(sizeof(now));
+		if (packet == NULL)
+			continue;
+		now = bench_ns();
+		memcpy(packet->data, &now, sizeof(now));
+		packet->length = sizeof(now);
+		if (csp_sendto(CSP_PRIO_CRITICAL, csp_get_address(), CRITICAL_PORT, 21, CSP_O_NONE, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+	}
+	csp_sleep_ms(100);
+
+	qsort(latency, critical_received, sizeof(latency[0]), compare);
+	printf("%-6s  %9lu  %10.0f  %6u  %6u  %6u  %6u\n", name, count - critical_received,
+			(bulk_received - bulk) / ((bench_ns() - start) / 1e9),
+			critical_received ? latency[critical_received / 2] : 0,
+			critical_received ? latency[critical_received * 9 / 10] : 0,
+			critical_received ? latency[critical_received * 99 / 100] : 0,
+			critical_received ? latency[critical_received - 1] : 0);
+
+}
+
+int main(int argc, char ** argv) {
+
+	csp_thread_handle_t handle;
+
+	count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000;
+	latency = calloc(count, sizeof(latency[0]));
+	if (latency == NULL)
+		return 1;
+
+	bench_quiet();
+	csp_buffer_init(100, 256);
+	csp_init(1);
+	csp_route_start_task(0, 0);
+	csp_thread_create(bulk_sink, "BULK", 0, NULL, 0, &handle);
+	csp_thread_create(critical_sink, "CRITICAL", 0, NULL, 0, &handle);
+	csp_thread_create(bulk_source, "FLOOD", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	printf("%lu critical packets, 1 per ms, CSP_FIFO_INPUT %d\n", count, CSP_FIFO_INPUT);
+	printf("load    crit lost  bulk pkt/s  p50 us  p90 us  p99 us  max us\n");
+
+	bench_run("idle");
+	flood = 1;
+	bench_run("flood");
+
+	return 0;
+
+}
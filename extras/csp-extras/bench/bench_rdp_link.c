@@ -0,0 +1,306 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * RDP transfer time over an emulated radio link. The node sends to itself
+ * through an interface that takes LINK_FRAME_MS per frame, half duplex,
+ * then holds each frame for the propagation delay and drops a share of them
+ * at random, in both directions. A frame that finds LINK_QUEUE frames
+ * waiting to be sent is dropped, as by the queue of a radio. Each run is a
+ * process of its own, because CSP cannot be initialised again.
+ *
+ * The first runs are one flow at several delays and losses. The
+ * retransmission timeout adapts to the round trip, so the smoothed round-trip
+ * time and the RTO of the first flow at the end of the transfer are shown.
+ * The other runs are several flows sharing the link, which the congestion
+ * window keeps from overrunning the link queue.
+ *
+ * usage: bench_rdp_link [segments] [window]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/arch/csp_time.h>
+
+#include "csp_conn.h"
+#include "bench.h"
+
+#define RDP_PORT	10
+#define PACKET_SIZE	100
+/* A flow takes two connections of CSP_CONN_MAX */
+#define MAX_FLOWS	4
+
+/* Serialisation time of one frame */
+#define LINK_FRAME_MS	1
+
+/* Frames waiting to be sent before the link drops */
+#define LINK_QUEUE	40
+
+/* Frames on the link at once */
+#define LINK_FRAMES	1024
+
+static unsigned int link_delay, link_loss;
+static pthread_mutex_t link_lock = PTHREAD_MUTEX_INITIALIZER;
+static csp_packet_t * link_frame[LINK_FRAMES];
+static uint32_t link_due[LINK_FRAMES];
+static unsigned int link_head, link_count;
+static uint32_t link_free;
+static unsigned long link_tx, link_dropped, link_overrun;
+
+static int link_send(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	uint32_t now = csp_get_ms();
+
+	pthread_mutex_lock(&link_lock);
+	link_tx++;
+	if ((int32_t) (link_free - now) < 0)
+		link_free = now;
+	if (((link_free - now) / LINK_FRAME_MS >= LINK_QUEUE) || (link_count == LINK_FRAMES)) {
+		link_overrun++;
+		pthread_mutex_unlock(&link_lock);
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+	if ((unsigned int) (rand() % 100) < link_loss) {
+		link_dropped++;
+		pthread_mutex_unlock(&link_lock);
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+
+	/* Frames leave one after the other, then spend the delay in flight */
+	link_free += LINK_FRAME_MS;
+	link_frame[(link_head + link_count) % LINK_FRAMES] = packet;
+	link_due[(link_head + link_count) % LINK_FRAMES] = link_free + link_delay;
+	link_count++;
+	pthread_mutex_unlock(&link_lock);
+
+	return CSP_ERR_NONE;
+
+}
+
+static csp_iface_t csp_if_link = {
+	.name = "LINK",
+	.nexthop = link_send,
+};
+
+static CSP_DEFINE_TASK(link_deliver) {
+
+	csp_packet_t * packet;
+	uint32_t now;
+
+	while (1) {
+		now = csp_get_ms();
+		pthread_mutex_lock(&link_lock);
+		while ((link_count > 0) && ((int32_t) (now - link_due[link_head]) >= 0)) {
+			packet = link_frame[link_head];
+			link_head = (link_head + 1) % LINK_FRAMES;
+			link_count--;
+			pthread_mutex_unlock(&link_lock);
+			csp_qfifo_write(packet, &csp_if_link, NULL);
+			pthread_mutex_lock(&link_lock);
+		}
+		pthread_mutex_unlock(&link_lock);
+		csp_sleep_ms(1);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+/* Packets carry their flow and number */
+typedef struct {
+	unsigned long number;
+	uint8_t flow;
+} bench_data_t;
+
+static volatile unsigned long received[MAX_FLOWS], out_of_order;
+static unsigned long count;
+static uint32_t start, done[MAX_FLOWS], retransmits[MAX_FLOWS], srtt[MAX_FLOWS], rto[MAX_FLOWS];
+
+static CSP_DEFINE_TASK(rdp_reader) {
+
+	csp_conn_t * conn = param;
+	csp_packet_t * packet;
+	bench_data_t data;
+
+	while ((packet = csp_read(conn, 20000)) != NULL) {
+		memcpy(&data, packet->data, sizeof(data));
+		if ((data.flow >= MAX_FLOWS) || (data.number != received[data.flow]))
+			out_of_order++;
+		else
+			received[data.flow]++;
+		csp_buffer_free(packet);
+	}
+	csp_close(conn);
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(rdp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_RDPREQ);
+	csp_thread_handle_t handle;
+	csp_conn_t * conn;
+
+	csp_bind(sock, RDP_PORT);
+	csp_listen(sock, MAX_FLOWS);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn != NULL)
+			csp_thread_create(rdp_reader, "READER", 0, conn, 0, &handle);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(rdp_source) {
+
+	unsigned int flow = (uintptr_t) param;
+	csp_packet_t * packet;
+	csp_conn_t * conn;
+	bench_data_t data;
+	unsigned int tries;
+
+	/* The handshake is lossy too */
+	for (tries = 0; tries < 5; tries++)
+		if ((conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), RDP_PORT, 1000, CSP_O_RDP)) != NULL)
+			break;
+	if (conn == NULL) {
+		done[flow] = csp_get_ms() - start;
+		return CSP_TASK_RETURN;
+	}
+
+	data.flow = flow;
+	for (data.number = 0; data.number < count; data.number++) {
+		while ((packet = csp_buffer_get(PACKET_SIZE)) == NULL)
+			csp_sleep_ms(1);
+		memset(packet->data, 0, PACKET_SIZE);
+		memcpy(packet->data, &data, sizeof(data));
+		packet->length = PACKET_SIZE;
+		if (!csp_send(conn, packet, 1000)) {
+			csp_buffer_free(packet);
+			break;
+		}
+	}
+
+	while ((received[flow] < data.number) && (csp_get_ms() - start < 120000))
+		csp_sleep_ms(1);
+	done[flow] = csp_get_ms() - start;
+
+	/* The RTO the connection ended with */
+	srtt[flow] = conn->rdp.srtt;
+	rto[flow] = conn->rdp.rto;
+	retransmits[flow] = conn->rdp.retransmits;
+	csp_close(conn);
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_run(unsigned int delay, unsigned int loss, unsigned int flows, unsigned int window) {
+
+	csp_thread_handle_t handle;
+	unsigned long total = 0, resent = 0;
+	uint32_t slowest = 0;
+	unsigned int flow;
+
+	link_delay = delay;
+	link_loss = loss;
+	srand(1);
+
+	bench_quiet();
+	csp_buffer_init(600, 256);
+	csp_init(1);
+	csp_rtable_set(1, CSP_ID_HOST_SIZE, &csp_if_link, CSP_NODE_MAC);
+	csp_route_start_task(0, 0);
+	csp_thread_create(link_deliver, "LINK", 0, NULL, 0, &handle);
+	csp_thread_create(rdp_sink, "RDP", 0, NULL, 0, &handle);
+	csp_rdp_set_opt(window, 20000, 200, 1, 50, (window > 1) ? window / 2 : 1);
+
+	start = csp_get_ms();
+	for (flow = 0; flow < flows; flow++)
+		csp_thread_create(rdp_source, "SOURCE", 0, (void *) (uintptr_t) flow, 0, &handle);
+
+	for (flow = 0; flow < flows; flow++) {
+		while (done[flow] == 0)
+			csp_sleep_ms(10);
+		total += received[flow];
+		resent += retransmits[flow];
+		if (done[flow] > slowest)
+			slowest = done[flow];
+	}
+
+	/* RTO of the first flow */
+	printf("%5u  %4u  %5u  %9.1f  %7u  %8lu  %9u  %11lu  %7lu  %7lu  %7lu\n", delay, loss, flows,
+			srtt[0] / 8.0, rto[0], total, slowest, resent, link_tx, link_dropped, link_overrun);
+
+}
+
+static void bench_fork(unsigned int delay, unsigned int loss, unsigned int flows, unsigned int window) {
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		bench_run(delay, loss, flows, window);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const unsigned int delays[] = {2, 30};
+	static const unsigned int losses[] = {0, 5, 10};
+	static const unsigned int flows[] = {2, 3, 4};
+	unsigned int window, i, j;
+
+	count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000;
+	window = (argc > 2) ? strtoul(argv[2], NULL, 0) : 10;
+
+	printf("%lu segments of %d bytes per flow, window %u, %d ms per frame, %d frames queued\n", count,
+			PACKET_SIZE, window, LINK_FRAME_MS, LINK_QUEUE);
+	printf("delay  loss  flows  srtt (ms)  rto (ms)  in order  time (ms)  retransmits   frames  dropped  overrun\n");
+	fflush(stdout);
+
+	for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+		for (j = 0; j < sizeof(losses) / sizeof(losses[0]); j++)
+			bench_fork(delays[i], losses[j], 1, window);
+
+	for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+		for (j = 0; j < sizeof(flows) / sizeof(flows[0]); j++)
+			bench_fork(delays[i], 0, flows[j], window);
+
+	return 0;
+
+}
@@ -0,0 +1,191 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Router cost of the RDP retransmission timers. An RDP connection goes
+ * through an interface that loops packets back to the router. Then the
+ * interface drops every packet and the sender fills its window. Once the retransmission timeout has backed
+ * off, csp_rdp_check_timeouts, which the router runs for every connection on
+ * each timeout sweep, is timed with the window of segments outstanding.
+ * Each window size runs in its own process, because CSP cannot be
+ * initialised again.
+ *
+ * usage: bench_rdp_timeouts [checks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/arch/csp_thread.h>
+
+#include "csp_conn.h"
+#include "transport/csp_transport.h"
+#include "bench.h"
+
+#define RDP_PORT	11
+#define PACKET_SIZE	100
+
+/* Packets sent while the link delivers, for a round-trip estimate */
+#define WARMUP		100
+
+static volatile int blackhole;
+static volatile unsigned long received;
+
+static int link_tx(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	if (blackhole) {
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+
+	csp_qfifo_write(packet, interface, NULL);
+	return CSP_ERR_NONE;
+
+}
+
+static csp_iface_t csp_if_link = {
+	.name = "LINK",
+	.nexthop = link_tx,
+};
+
+static CSP_DEFINE_TASK(rdp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_RDPREQ);
+	csp_conn_t * conn;
+	csp_packet_t * packet;
+
+	csp_bind(sock, RDP_PORT);
+	csp_listen(sock, 5);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn == NULL)
+			continue;
+		while ((packet = csp_read(conn, CSP_MAX_DELAY)) != NULL) {
+			received++;
+			csp_buffer_free(packet);
+		}
+		csp_close(conn);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static int bench_send(csp_conn_t * conn, unsigned long number, uint32_t timeout) {
+
+	csp_packet_t * packet = csp_buffer_get(PACKET_SIZE);
+
+	if (packet == NULL)
+		return 0;
+
+	memset(packet->data, 0, PACKET_SIZE);
+	memcpy(packet->data, &number, sizeof(number));
+	packet->length = PACKET_SIZE;
+	if (!csp_send(conn, packet, timeout)) {
+		csp_buffer_free(packet);
+		return 0;
+	}
+
+	return 1;
+
+}
+
+static void bench_run(unsigned int window, unsigned long count) {
+
+	csp_thread_handle_t handle;
+	csp_conn_t * conn;
+	unsigned long sent, i;
+	uint32_t retransmits;
+	uint64_t start;
+
+	bench_quiet();
+	csp_buffer_init(200, 256);
+	csp_init(1);
+	csp_rtable_set(1, CSP_ID_HOST_SIZE, &csp_if_link, CSP_NODE_MAC);
+	csp_route_start_task(0, 0);
+	csp_rdp_set_opt(window, 60000, 100, 0, 50, 1);
+	csp_thread_create(rdp_sink, "RDP", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), RDP_PORT, 1000, CSP_O_RDP);
+	if (conn == NULL) {
+		printf("%6u  connect failed\n", window);
+		return;
+	}
+
+	for (sent = 0; sent < WARMUP; sent++)
+		if (!bench_send(conn, sent, 1000))
+			break;
+	while (received < sent)
+		csp_sleep_ms(1);
+
+	/* Fill the window, nothing is ACKed any more. The router input FIFO drops
+	 * packets of the loopback, so the congestion window is opened by hand.
+	 * csp_send waits for the connection timeout when the window is full, so
+	 * send no more than that. */
+	blackhole = 1;
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	conn->rdp.cwnd = conn->rdp.window_size;
+	csp_conn_unlock(conn);
+	for (i = 0; i < window; i++)
+		bench_send(conn, sent++, 0);
+
+	/* Let the retransmission timeout back off, so no segment falls due while timing */
+	csp_sleep_ms(3000);
+
+	retransmits = conn->rdp.retransmits;
+	start = bench_ns();
+	for (i = 0; i < count; i++)
+		csp_rdp_check_timeouts(conn);
+	printf("%6u  %11u  %8u  %8.1f  %11u\n", window, conn->rdp.tx_count, conn->rdp.rto,
+			(double) (bench_ns() - start) / count, conn->rdp.retransmits - retransmits);
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const unsigned int windows[] = {1, 5, 10, 20};
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	unsigned int i;
+	pid_t pid;
+
+	printf("%lu checks of one connection, CSP_RDP_MAX_WINDOW %d\n", count, CSP_RDP_MAX_WINDOW);
+	printf("window  outstanding  rto (ms)  ns/check  retransmits\n");
+	fflush(stdout);
+
+	for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+		pid = fork();
+		if (pid == 0) {
+			bench_run(windows[i], count);
+			fflush(stdout);
+			_exit(0);
+		}
+		waitpid(pid, NULL, 0);
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,159 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Router packets per second with small connectionless packets through the
+ * loopback interface, and the batch statistics of csp_route_get_stats. The
+ * paced run sends bursts of packets and waits until each burst has arrived or
+ * was dropped, the flood run sends as fast as buffers allow and overruns the
+ * router input FIFO. Each run is a process of its own, because the router
+ * statistics cannot be reset. The batch size is fixed at build time, to
+ * compare sizes build into another directory:
+ *
+ *   CFLAGS="-O2 -g -DCSP_ROUTE_BATCH=1" make BUILD=build-batch1 bench
+ *
+ * usage: bench_route [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define PORT		20
+#define PACKET_SIZE	10
+
+/* Packets per paced burst, shorter than the router input FIFO */
+#define BURST		8
+
+static volatile unsigned long received;
+
+static CSP_DEFINE_TASK(sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_packet_t * packet;
+
+	csp_bind(sock, PORT);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		received++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_run(const char * name, unsigned int seconds, unsigned int burst) {
+
+	csp_thread_handle_t handle;
+	csp_route_stats_t stats;
+	csp_packet_t * packet;
+	unsigned long sent = 0, lost = 0;
+	uint64_t start, end, wait;
+	double elapsed;
+
+	bench_quiet();
+	csp_buffer_init(200, 64);
+	csp_init(1);
+	csp_route_start_task(0, 0);
+	csp_thread_create(sink, "SINK", 0, NULL, 0, &handle);
+	csp_sleep_ms(100);
+
+	start = bench_ns();
+	end = start + seconds * 1000000000ULL;
+	while (bench_ns() < end) {
+		/* Packets that have not arrived after 10 ms were dropped */
+		if (burst && (sent % burst == 0)) {
+			wait = bench_ns();
+			while (sent - received - lost > 0) {
+				if (bench_ns() - wait > 10000000) {
+					lost = sent - received;
+					break;
+				}
+				sched_yield();
+			}
+		}
+		packet = csp_buffer_get(PACKET_SIZE);
+		if (packet == NULL) {
+			sched_yield();
+			continue;
+		}
+		/* Distinct payloads, so duplicate detection does not drop them */
+		memset(packet->data, 0, PACKET_SIZE);
+		memcpy(packet->data, &sent, sizeof(sent));
+		packet->length = PACKET_SIZE;
+		if (csp_sendto(CSP_PRIO_NORM, csp_get_address(), PORT, 30, CSP_O_NONE, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+		else
+			sent++;
+	}
+	elapsed = (bench_ns() - start) / 1e9;
+	csp_sleep_ms(200);
+
+	csp_route_get_stats(&stats);
+
+	printf("%-6s  %9lu  %9lu  %8.0f  %8lu  %6.2f  %7lu  %8lu  %9.0f\n", name, sent, (unsigned long) received,
+			received / elapsed, (unsigned long) stats.batches,
+			stats.batches ? (double) stats.packets / stats.batches : 0.0,
+			(unsigned long) stats.max_batch, (unsigned long) stats.full_batches,
+			stats.timeout_checks / elapsed);
+
+}
+
+int main(int argc, char ** argv) {
+
+	unsigned int seconds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2;
+	pid_t pid;
+
+	printf("CSP_ROUTE_BATCH %d, %d byte packets for %u s per run, paced in bursts of %d\n",
+			CSP_ROUTE_BATCH, PACKET_SIZE, seconds, BURST);
+	printf("mode         sent   received     pkt/s   batches     avg  largest      full   checks/s\n");
+	fflush(stdout);
+
+	pid = fork();
+	if (pid == 0) {
+		bench_run("paced", seconds, BURST);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+	pid = fork();
+	if (pid == 0) {
+		bench_run("flood", seconds, 0);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+	return 0;
+
+}
@@ -0,0 +1,241 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * SFP transfers over an emulated radio link. The node sends to itself through
+ * an interface that takes LINK_FRAME_MS per frame, half duplex, then holds
+ * each frame for the propagation delay and drops a share of them at random,
+ * in both directions. Each loss is run with csp_sfp_send to csp_sfp_recv and
+ * with csp_sfp_send_window to csp_sfp_recv_stream, and the received data is
+ * compared with the data sent. Each run is a process of its own, because CSP
+ * cannot be initialised again.
+ *
+ * usage: bench_sfp [kB] [window] [delay ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/arch/csp_malloc.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/arch/csp_time.h>
+
+#include "bench.h"
+
+#define SFP_PORT	10
+#define MTU		200
+#define TIMEOUT		2000
+
+/* Serialisation time of one frame */
+#define LINK_FRAME_MS	1
+
+/* Frames on the link at once, csp_sfp_send queues the whole transfer */
+#define LINK_FRAMES	2048
+
+static unsigned int link_delay, link_loss;
+static pthread_mutex_t link_lock = PTHREAD_MUTEX_INITIALIZER;
+static csp_packet_t * link_frame[LINK_FRAMES];
+static uint32_t link_due[LINK_FRAMES];
+static unsigned int link_head, link_count;
+static uint32_t link_free;
+static unsigned long link_tx, link_dropped;
+
+static int link_send(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	uint32_t now = csp_get_ms();
+
+	pthread_mutex_lock(&link_lock);
+	link_tx++;
+	if (((unsigned int) (rand() % 100) < link_loss) || (link_count == LINK_FRAMES)) {
+		link_dropped++;
+		pthread_mutex_unlock(&link_lock);
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+
+	/* Frames leave one after the other, then spend the delay in flight */
+	if ((int32_t) (link_free - now) < 0)
+		link_free = now;
+	link_free += LINK_FRAME_MS;
+	link_frame[(link_head + link_count) % LINK_FRAMES] = packet;
+	link_due[(link_head + link_count) % LINK_FRAMES] = link_free + link_delay;
+	link_count++;
+	pthread_mutex_unlock(&link_lock);
+
+	return CSP_ERR_NONE;
+
+}
+
+static csp_iface_t csp_if_link = {
+	.name = "LINK",
+	.nexthop = link_send,
+};
+
+static CSP_DEFINE_TASK(link_deliver) {
+
+	csp_packet_t * packet;
+	uint32_t now;
+
+	while (1) {
+		now = csp_get_ms();
+		pthread_mutex_lock(&link_lock);
+		while ((link_count > 0) && ((int32_t) (now - link_due[link_head]) >= 0)) {
+			packet = link_frame[link_head];
+			link_head = (link_head + 1) % LINK_FRAMES;
+			link_count--;
+			pthread_mutex_unlock(&link_lock);
+			csp_qfifo_write(packet, &csp_if_link, NULL);
+			pthread_mutex_lock(&link_lock);
+		}
+		pthread_mutex_unlock(&link_lock);
+		csp_sleep_ms(1);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static int windowed;
+static unsigned int window;
+static uint32_t size;
+static uint8_t * sent, * received;
+static volatile int receiving = 1;
+static int recv_result;
+
+static int sfp_deliver(void * arg, uint32_t offset, const uint8_t * data, uint32_t length, uint32_t totalsize) {
+
+	if ((totalsize != size) || (offset + length > size))
+		return -1;
+
+	memcpy(received + offset, data, length);
+	return 0;
+
+}
+
+static CSP_DEFINE_TASK(sfp_sink) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_NONE);
+	csp_conn_t * conn;
+	void * data;
+	int length;
+
+	csp_bind(sock, SFP_PORT);
+	csp_listen(sock, 1);
+
+	conn = csp_accept(sock, CSP_MAX_DELAY);
+	if (windowed) {
+		recv_result = csp_sfp_recv_stream(conn, sfp_deliver, NULL, window, TIMEOUT);
+	} else {
+		recv_result = csp_sfp_recv(conn, &data, &length, TIMEOUT);
+		if (recv_result == 0) {
+			if ((uint32_t) length == size)
+				memcpy(received, data, size);
+			csp_free(data);
+		}
+	}
+
+	/* Let the last status packet go out before the connection is closed */
+	csp_sleep_ms(100);
+	csp_close(conn);
+	receiving = 0;
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_run(unsigned int loss) {
+
+	csp_thread_handle_t handle;
+	uint32_t start, elapsed;
+	csp_conn_t * conn;
+	uint32_t i;
+	int result;
+
+	link_loss = loss;
+	srand(1);
+	sent = malloc(size);
+	received = calloc(1, size);
+	for (i = 0; i < size; i++)
+		sent[i] = rand();
+
+	bench_quiet();
+	csp_buffer_init(LINK_FRAMES + 100, 256);
+	csp_init(1);
+	csp_rtable_set(1, CSP_ID_HOST_SIZE, &csp_if_link, CSP_NODE_MAC);
+	csp_route_start_task(0, 0);
+	csp_thread_create(link_deliver, "LINK", 0, NULL, 0, &handle);
+	csp_thread_create(sfp_sink, "SINK", 0, NULL, 0, &handle);
+	csp_sleep_ms(10);
+
+	start = csp_get_ms();
+	conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), SFP_PORT, 1000, CSP_O_NONE);
+	if (windowed)
+		result = csp_sfp_send_window(conn, sent, size, MTU, window, TIMEOUT, NULL);
+	else
+		result = csp_sfp_send(conn, sent, size, MTU, TIMEOUT);
+	while (receiving)
+		csp_sleep_ms(1);
+	elapsed = csp_get_ms() - start - 100;
+	csp_close(conn);
+
+	/* A failed transfer shows the time until the receiver gave up */
+	printf("%-7s  %4u%%  %4s  %4s  %8u  %7.1f  %6lu  %7lu  %5s\n", windowed ? "window" : "sfp", loss,
+			result ? "fail" : "ok", recv_result ? "fail" : "ok", elapsed,
+			recv_result ? 0.0 : size / 1.024 / elapsed, link_tx, link_dropped,
+			memcmp(sent, received, size) ? "no" : "yes");
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const unsigned int losses[] = {0, 1, 5, 10};
+	unsigned int i;
+	pid_t pid;
+
+	size = ((argc > 1) ? strtoul(argv[1], NULL, 0) : 200) * 1024;
+	window = (argc > 2) ? strtoul(argv[2], NULL, 0) : 32;
+	link_delay = (argc > 3) ? strtoul(argv[3], NULL, 0) : 2;
+
+	printf("%u kB in %d byte fragments, window %u, %d ms/frame, %u ms delay\n", size / 1024, MTU, window,
+			LINK_FRAME_MS, link_delay);
+	printf("mode      loss  send  recv        ms     kB/s  frames  dropped  match\n");
+	fflush(stdout);
+
+	for (windowed = 0; windowed < 2; windowed++) {
+		for (i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+			pid = fork();
+			if (pid == 0) {
+				bench_run(losses[i]);
+				fflush(stdout);
+				_exit(0);
+			}
+			waitpid(pid, NULL, 0);
+		}
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,165 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Router throughput with 1 to 8 workers. Eight flows of HMAC protected
+ * packets go through the loopback interface to one socket per flow, so the
+ * router verifies every packet. Each worker count runs in its own process,
+ * because router tasks cannot be stopped.
+ *
+ * usage: bench_workers [packets per flow]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+
+#include "bench.h"
+
+#define FLOWS		8
+#define PORT		10
+#define PACKET_SIZE	200
+
+/* Packets in flight per flow, the router input FIFO of a worker is short */
+#define INFLIGHT	2
+
+static volatile unsigned long received[FLOWS];
+static unsigned long count;
+
+static CSP_DEFINE_TASK(sink) {
+
+	unsigned int flow = (uintptr_t) param;
+	csp_socket_t * sock = csp_socket(CSP_SO_CONN_LESS | CSP_SO_HMACREQ);
+	csp_packet_t * packet;
+
+	csp_bind(sock, PORT + flow);
+
+	while (1) {
+		packet = csp_recvfrom(sock, CSP_MAX_DELAY);
+		if (packet == NULL)
+			continue;
+		received[flow]++;
+		csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static CSP_DEFINE_TASK(source) {
+
+	unsigned int flow = (uintptr_t) param;
+	unsigned long sent, lost = 0;
+	uint64_t wait;
+	csp_packet_t * packet;
+
+	for (sent = 0; sent < count; sent++) {
+		/* Packets that have not arrived after 10 ms were dropped */
+		wait = bench_ns();
+		while (sent - received[flow] - lost >= INFLIGHT) {
+			if (bench_ns() - wait > 10000000) {
+				lost = sent - received[flow];
+				break;
+			}
+			sched_yield();
+		}
+		while ((packet = csp_buffer_get(PACKET_SIZE)) == NULL)
+			sched_yield();
+		/* Distinct payloads, so duplicate detection does not drop them */
+		memset(packet->data, flow, PACKET_SIZE);
+		memcpy(packet->data, &sent, sizeof(sent));
+		packet->length = PACKET_SIZE;
+		if (csp_sendto(CSP_PRIO_NORM, csp_get_address(), PORT + flow, 20 + flow, CSP_O_HMAC, packet, 0) != CSP_ERR_NONE)
+			csp_buffer_free(packet);
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+static void bench_run(unsigned int workers) {
+
+	csp_thread_handle_t handle;
+	unsigned long total, done;
+	uint64_t start;
+	unsigned int flow;
+
+	bench_quiet();
+	csp_buffer_init(200, 256);
+	csp_init(1);
+	csp_hmac_set_key("bench", 5);
+	if (csp_route_start_workers(workers, 0, 0) != CSP_ERR_NONE) {
+		printf("%7u  failed to start, CSP_ROUTE_WORKERS is %d\n", workers, CSP_ROUTE_WORKERS);
+		return;
+	}
+
+	for (flow = 0; flow < FLOWS; flow++)
+		csp_thread_create(sink, "SINK", 0, (void *) (uintptr_t) flow, 0, &handle);
+	csp_sleep_ms(10);
+
+	start = bench_ns();
+	for (flow = 0; flow < FLOWS; flow++)
+		csp_thread_create(source, "SOURCE", 0, (void *) (uintptr_t) flow, 0, &handle);
+
+	/* Wait until no packet has arrived for 100 ms */
+	total = 0;
+	do {
+		done = total;
+		csp_sleep_ms(100);
+		for (total = 0, flow = 0; flow < FLOWS; flow++)
+			total += received[flow];
+	} while (total != done);
+
+	printf("%7u  %9lu  %10.0f\n", workers, total, total / ((bench_ns() - start - 100000000) / 1e9));
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const unsigned int workers[] = {1, 2, 4, 8};
+	unsigned int i;
+	pid_t pid;
+
+	count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+
+	printf("%d flows of %lu HMAC packets of %d bytes, %ld cpus\n", FLOWS, count, PACKET_SIZE,
+			sysconf(_SC_NPROCESSORS_ONLN));
+	printf("workers   received       pkt/s\n");
+	fflush(stdout);
+
+	for (i = 0; i < sizeof(workers) / sizeof(workers[0]); i++) {
+		pid = fork();
+		if (pid == 0) {
+			bench_run(workers[i]);
+			fflush(stdout);
+			_exit(0);
+		}
+		waitpid(pid, NULL, 0);
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,153 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * XTEA counter mode throughput of csp_xtea_encrypt, compared with the block at
+ * a time implementation it replaced. The output of both must be identical for
+ * every length from 0 to 260 bytes at four alignments.
+ *
+ * usage: bench_xtea [packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+
+#include "crypto/csp_sha1.h"
+#include "crypto/csp_xtea.h"
+#include "bench.h"
+
+#define KEY		"bench"
+
+/* Reference, one block at a time with the round keys derived in every round */
+static uint8_t ref_key[16];
+
+#define LOAD32L(x, y) do { (x) = ((uint32_t)((y)[3] & 0xff) << 24) | \
+				 ((uint32_t)((y)[2] & 0xff) << 16) | \
+				 ((uint32_t)((y)[1] & 0xff) << 8)  | \
+				 ((uint32_t)((y)[0] & 0xff) << 0); } while (0)
+
+#define STORE32L(x, y) do { (y)[3] = (uint8_t)(((x) >> 24) & 0xff); \
+			    (y)[2] = (uint8_t)(((x) >> 16) & 0xff); \
+			    (y)[1] = (uint8_t)(((x) >> 8) & 0xff); \
+			    (y)[0] = (uint8_t)(((x) >> 0) & 0xff); } while (0)
+
+static void ref_encrypt_block(uint8_t * block, const uint8_t * key) {
+
+	uint32_t i, v0, v1, delta = 0x9E3779B9, sum = 0, k[4];
+
+	LOAD32L(k[0], &key[0]);
+	LOAD32L(k[1], &key[4]);
+	LOAD32L(k[2], &key[8]);
+	LOAD32L(k[3], &key[12]);
+	LOAD32L(v0, &block[0]);
+	LOAD32L(v1, &block[4]);
+
+	for (i = 0; i < 32; i++) {
+		v0 += (((v1 << 4) ^ (v1 >> 5)) + v1) ^ (sum + k[sum & 3]);
+		sum += delta;
+		v1 += (((v0 << 4) ^ (v0 >> 5)) + v0) ^ (sum + k[(sum >> 11) & 3]);
+	}
+
+	STORE32L(v0, &block[0]);
+	STORE32L(v1, &block[4]);
+
+}
+
+static void ref_encrypt(uint8_t * plain, uint32_t len, uint32_t iv[2]) {
+
+	uint32_t i, j, stream[2], remain;
+	uint32_t blocks = (len + 7) / 8;
+
+	stream[0] = csp_htobe32(iv[0]);
+	stream[1] = csp_htobe32(iv[1]);
+
+	for (i = 0; i < blocks; i++) {
+		ref_encrypt_block((uint8_t *) stream, ref_key);
+		remain = len - i * 8;
+		for (j = 0; j < (remain < 8 ? remain : 8); j++)
+			plain[len - remain + j] ^= ((uint8_t *) stream)[j];
+		stream[0] = csp_htobe32(iv[0]);
+		stream[1] = csp_htobe32(iv[1]++);
+	}
+
+}
+
+int main(int argc, char ** argv) {
+
+	static const int sizes[] = {16, 32, 64, 128, 256};
+	static uint8_t buf[300], ref[300];
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+	uint32_t iv[2], ref_iv[2];
+	uint8_t hash[SHA1_DIGESTSIZE];
+	double lanes, block;
+	unsigned long n;
+	unsigned int s;
+	uint64_t start;
+	int len, off, i;
+
+	csp_xtea_set_key(KEY, strlen(KEY));
+	csp_sha1_memory((uint8_t *) KEY, strlen(KEY), hash);
+	memcpy(ref_key, hash, sizeof(ref_key));
+
+	for (len = 0; len <= 260; len++) {
+		for (off = 0; off < 4; off++) {
+			for (i = 0; i < len; i++)
+				buf[off + i] = ref[off + i] = i * 7 + off;
+			iv[0] = ref_iv[0] = 0x12345678 + len;
+			iv[1] = ref_iv[1] = 1;
+			csp_xtea_encrypt(buf + off, len, iv);
+			ref_encrypt(ref + off, len, ref_iv);
+			if ((memcmp(buf + off, ref + off, len) != 0) || (iv[1] != ref_iv[1])) {
+				printf("mismatch at length %d offset %d\n", len, off);
+				return 1;
+			}
+		}
+	}
+
+	printf("output identical for 0-260 bytes, %lu packets per size\n", count);
+	printf("size  lanes MB/s  block MB/s  speedup\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		start = bench_ns();
+		for (n = 0; n < count; n++) {
+			iv[0] = iv[1] = 1;
+			csp_xtea_encrypt(buf, sizes[s], iv);
+		}
+		lanes = (double) count * sizes[s] / ((bench_ns() - start) / 1e3);
+
+		start = bench_ns();
+		for (n = 0; n < count; n++) {
+			iv[0] = iv[1] = 1;
+			ref_encrypt(buf, sizes[s], iv);
+		}
+		block = (double) count * sizes[s] / ((bench_ns() - start) / 1e3);
+
+		printf("%4d  %10.1f  %10.1f  %7.2f\n", sizes[s], lanes, block, lanes / block);
+
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,239 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Hub for nodes using the zmqhub interface on a Linux host, in place of
+ * the ZMQ proxy. Nodes connect a sequenced packet socket, a one byte
+ * message subscribes to an address (255 for all), longer messages are
+ * frames which are forwarded once to every connection subscribed to the
+ * address in their first byte or to all. A subscriber that does not keep
+ * up loses frames, as with a ZMQ publisher.
+ *
+ * usage: csp_hub [-v] [path]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <csp/interfaces/csp_if_zmqhub.h>
+
+#define HUB_MAX_CLIENTS		256
+#define HUB_MAX_FRAME		2048
+#define HUB_ALL			255
+
+/* Messages read from one connection before the others get a turn */
+#define HUB_READ_BATCH		64
+
+/* Connections subscribed to each address */
+static int subs[256][HUB_MAX_CLIENTS];
+static int nsubs[256];
+
+static unsigned long frames, forwarded, dropped, truncated;
+static volatile sig_atomic_t stop;
+
+static void hub_subscribe(int fd, uint8_t addr) {
+
+	int i;
+
+	for (i = 0; i < nsubs[addr]; i++)
+		if (subs[addr][i] == fd)
+			return;
+	if (nsubs[addr] < HUB_MAX_CLIENTS)
+		subs[addr][nsubs[addr]++] = fd;
+
+}
+
+static void hub_unsubscribe(int fd) {
+
+	int addr, i;
+
+	for (addr = 0; addr < 256; addr++)
+		for (i = 0; i < nsubs[addr]; i++)
+			if (subs[addr][i] == fd)
+				subs[addr][i--] = subs[addr][--nsubs[addr]];
+
+}
+
+/* Connections subscribed to addr or to all, each once, returns the count */
+static int hub_targets(uint8_t addr, int * list) {
+
+	int count, i, j;
+
+	memcpy(list, subs[addr], nsubs[addr] * sizeof(*list));
+	count = nsubs[addr];
+	if (addr == HUB_ALL)
+		return count;
+
+	for (i = 0; i < nsubs[HUB_ALL]; i++) {
+		for (j = 0; j < nsubs[addr]; j++)
+			if (subs[HUB_ALL][i] == list[j])
+				break;
+		if (j == nsubs[addr])
+			list[count++] = subs[HUB_ALL][i];
+	}
+
+	return count;
+
+}
+
+static void hub_forward(const uint8_t * frame, ssize_t length) {
+
+	int list[2 * HUB_MAX_CLIENTS];
+	int count, i;
+
+	count = hub_targets(frame[0], list);
+	for (i = 0; i < count; i++) {
+		if (send(list[i], frame, length, MSG_DONTWAIT) == length) {
+			forwarded++;
+		} else {
+			dropped++;
+		}
+	}
+
+}
+
+/* Handle every message waiting on a connection, returns -1 when it is closed */
+static int hub_read(int fd) {
+
+	uint8_t frame[HUB_MAX_FRAME];
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t length;
+	int batch;
+
+	iov.iov_base = frame;
+	iov.iov_len = sizeof(frame);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	for (batch = 0; batch < HUB_READ_BATCH; batch++) {
+		msg.msg_flags = 0;
+		length = recvmsg(fd, &msg, MSG_DONTWAIT);
+		if (length < 0)
+			return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -1;
+		if (length == 0)
+			return -1;
+
+		/* The rest of a frame larger than the buffer is discarded, do not forward the part */
+		if (msg.msg_flags & MSG_TRUNC) {
+			truncated++;
+			continue;
+		}
+
+		if (length == 1) {
+			hub_subscribe(fd, frame[0]);
+			continue;
+		}
+
+		frames++;
+		hub_forward(frame, length);
+	}
+
+	return 0;
+
+}
+
+static void hub_signal(int sig) {
+	stop = 1;
+}
+
+int main(int argc, char ** argv) {
+
+	struct sockaddr_un addr;
+	struct epoll_event event, events[64];
+	const char * path = CSP_ZMQHUB_PATH;
+	int verbose = 0;
+	int listener, epoll, fd, n, i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = 1;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Path too long: %s\n", path);
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if ((listener < 0) || (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(listener, 64) < 0)) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	epoll = epoll_create1(0);
+	event.events = EPOLLIN;
+	event.data.fd = listener;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+	signal(SIGINT, hub_signal);
+	signal(SIGTERM, hub_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (verbose)
+		printf("Hub listening on %s\n", path);
+
+	while (!stop) {
+		n = epoll_wait(epoll, events, 64, -1);
+		for (i = 0; i < n; i++) {
+			fd = events[i].data.fd;
+			if (fd == listener) {
+				fd = accept(listener, NULL, NULL);
+				if (fd < 0)
+					continue;
+				event.events = EPOLLIN;
+				event.data.fd = fd;
+				epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+				continue;
+			}
+			if ((hub_read(fd) < 0) || (events[i].events & (EPOLLHUP | EPOLLERR))) {
+				epoll_ctl(epoll, EPOLL_CTL_DEL, fd, NULL);
+				hub_unsubscribe(fd);
+				close(fd);
+			}
+		}
+	}
+
+	unlink(path);
+
+	if (verbose)
+		printf("Frames %lu, forwarded %lu, dropped %lu, truncated %lu\n", frames, forwarded, dropped, truncated);
+
+	return 0;
+
+}
@@ -282,15 +282,56 @@ int csp_bind(csp_socket_t *socket, uint8_t port);
  */
 int csp_route_start_task(unsigned int task_stack_size, unsigned int priority);
 
+/**
+ * Start several router tasks.
+ * Incoming packets are distributed over the workers by a hash of the connection
+ * bits of the CSP id, so all packets of a connection are handled in order by
+ * the same worker. Starting one worker is the same as csp_route_start_task().
+ * @param workers Number of router tasks, at most CSP_ROUTE_WORKERS
+ * @param task_stack_size The number of portStackType to allocate. This only affects FreeRTOS systems.
+ * @param priority The OS task priority of the routers
+ * @return CSP_ERR_NONE on success, CSP_ERR_INVAL if workers is out of range,
+ * CSP_ERR_NOMEM if not all tasks could be created. Packets are then sharded
+ * over the tasks that were started.
+ */
+int csp_route_start_workers(unsigned int workers, unsigned int task_stack_size, unsigned int priority);
+
 /**
  * Call the router worker function manually (without the router task)
  * This must be run inside a loop or called periodically for the csp router to work.
  * Use this function instead of calling and starting the router task.
+ * This runs the first worker, packets are only sharded over more workers
+ * when they are started with csp_route_start_workers().
  * @param timeout max blocking time
  * @return -1 if no packet was processed, 0 otherwise
  */
 int csp_route_work(uint32_t timeout);
 
+/** Router statistics, see csp_route_get_stats() */
+typedef struct {
+	uint32_t batches;		/**< Router wakeups that processed at least one packet */
+	uint32_t packets;		/**< Packets processed */
+	uint32_t max_batch;		/**< Largest number of packets processed in one wakeup */
+	uint32_t full_batches;		/**< Wakeups that stopped at CSP_ROUTE_BATCH packets */
+	uint32_t timeout_checks;	/**< Connection timeout checks */
+} csp_route_stats_t;
+
+/**
+ * Get router statistics.
+ * csp_route_work() processes up to CSP_ROUTE_BATCH queued packets per call,
+ * packets / batches is the average batch size.
+ * @param stats Pointer to structure to fill in
+ */
+void csp_route_get_stats(csp_route_stats_t * stats);
+
+/**
+ * Set the hash used for duplicate detection, over the id and data of a packet.
+ * The default is csp_crc32_memory(), a hardware hash such as crc_hash()
+ * from csp/drivers/crc.h can be used instead.
+ * @param hash Hash function, or NULL to restore the default
+ */
+void csp_dedup_set_hash(uint32_t (*hash)(const uint8_t * data, uint32_t length));
+
 /**
  * Start the bridge task.
  * @param task_stack_size The number of portStackType to allocate. This only affects FreeRTOS systems.
@@ -324,6 +365,8 @@ void csp_promisc_disable(void);
  * Returns the first packet from the promiscuous mode packet queue.
  * The queue is FIFO, so the returned packet is the oldest one
  * in the queue.
+ * The packet may still be shared with the router, so call csp_buffer_cow()
+ * before modifying it.
  *
  * @param timeout Timeout in ms to wait for a new packet
  */
@@ -376,6 +419,94 @@ int csp_sfp_recv(csp_conn_t * conn, void ** dataout, int * datasize, uint32_t ti
  */
 int csp_sfp_recv_fp(csp_conn_t * conn, void ** dataout, int * datasize, uint32_t timeout, csp_packet_t * first_packet);
 
+/**
+ * Send data using streaming SFP, the counterpart of csp_sfp_recv_stream.
+ * Up to window fragments are sent beyond the data acknowledged by the receiver,
+ * and ranges the receiver reports missing are sent again.
+ * @param conn pointer to connection
+ * @param data pointer to data to send
+ * @param totalsize size of data to send
+ * @param mtu maximum transfer unit
+ * @param window number of fragments in flight
+ * @param timeout time in ms without progress before the transfer is given up
+ * @param memcpyfcn pointer to memcpy function, or NULL for memcpy
+ * @return 0 if OK, -1 if ERR
+ */
+int csp_sfp_send_window(csp_conn_t * conn, void * data, uint32_t totalsize, int mtu, unsigned int window,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t));
+
+/**
+ * Streaming SFP fragment callback.
+ * Called once for each range of data, in the order it arrives, which is not
+ * always in sequence. data points into the packet buffer and is only valid
+ * during the call.
+ * @param arg argument given to csp_sfp_recv_stream
+ * @param offset offset of the fragment in the transfer
+ * @param data pointer to fragment data
+ * @param size size of the fragment
+ * @param totalsize size of the transfer
+ * @return 0 to continue, anything else aborts the transfer
+ */
+typedef int (*csp_sfp_deliver_t)(void * arg, uint32_t offset, const uint8_t * data, uint32_t size, uint32_t totalsize);
+
+/**
+ * Receive data sent with csp_sfp_send_window without buffering the whole transfer.
+ * Fragments are handed to deliver as they arrive, and missing ranges are
+ * requested from the sender again.
+ * @param conn pointer to active conn, on which you expect to receive sfp packed data
+ * @param deliver fragment callback
+ * @param arg argument for deliver
+ * @param window window size used by the sender
+ * @param timeout time in ms without progress before the transfer is given up
+ * @return 0 if OK, -1 if ERR
+ */
+int csp_sfp_recv_stream(csp_conn_t * conn, csp_sfp_deliver_t deliver, void * arg, unsigned int window, uint32_t timeout);
+
+/**
+ * Send data using streaming SFP, skipping the data the receiver already holds.
+ * The receiver is asked for its state before anything is sent, so this is
+ * the counterpart of csp_sfp_recv_resume. The receiver only continues from a
+ * checkpoint of the same id and size, so id must identify the data, e.g. a
+ * file number or csp_crc32_memory() of the data. Other parameters are as
+ * csp_sfp_send_window.
+ * @param id transfer id
+ * @return 0 if OK, -1 if ERR
+ */
+int csp_sfp_send_resume(csp_conn_t * conn, uint32_t id, void * data, uint32_t totalsize, int mtu, unsigned int window,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t));
+
+/**
+ * Persistent store of a resumable SFP transfer checkpoint,
+ * e.g. a file or an emulated EEPROM block.
+ */
+typedef struct {
+	/** Read the checkpoint into data, return 0 if a checkpoint of size bytes was read */
+	int (*load)(void * arg, void * data, uint32_t size);
+	/** Write size bytes of checkpoint, return 0 if OK. Called with data NULL and size 0 to erase it */
+	int (*save)(void * arg, const void * data, uint32_t size);
+	/** Argument for load and save */
+	void * arg;
+} csp_sfp_store_t;
+
+/**
+ * Receive data like csp_sfp_recv_stream, continuing an interrupted transfer.
+ * The ranges received are saved to store as the transfer progresses and when
+ * it stalls, and the sender is told to skip them when it resumes with
+ * csp_sfp_send_resume. A checkpoint only covers data deliver has returned for,
+ * so deliver must have stored it. The checkpoint is erased when the transfer
+ * completes, and discarded unless the sender resumes a transfer of the same
+ * id and size. Transfers from csp_sfp_send_window are received but not saved.
+ * @param conn pointer to active conn, on which you expect to receive sfp packed data
+ * @param deliver fragment callback
+ * @param arg argument for deliver
+ * @param window window size used by the sender
+ * @param timeout time in ms without progress before the transfer is given up
+ * @param store checkpoint store
+ * @return 0 if OK, -1 if ERR or if the checkpoint of a completed transfer could not be erased
+ */
+int csp_sfp_recv_resume(csp_conn_t * conn, csp_sfp_deliver_t deliver, void * arg, unsigned int window, uint32_t timeout,
+		const csp_sfp_store_t * store);
+
 /**
  * If the given packet is a service-request (that is uses one of the csp service ports)
  * it will be handled according to the CSP service handler.
@@ -450,7 +581,7 @@ void csp_uptime(uint8_t node, uint32_t timeout);
  * Set RDP options
  * @param window_size Window size
  * @param conn_timeout_ms Connection timeout in ms
- * @param packet_timeout_ms Packet timeout in ms
+ * @param packet_timeout_ms Initial packet timeout in ms, adapted to the measured round-trip time per connection
  * @param delayed_acks Enable/disable delayed acknowledgements
  * @param ack_timeout Acknowledgement timeout when delayed ACKs is enabled
  * @param ack_delay_count Send acknowledgement for every ack_delay_count packets
@@ -10,8 +10,10 @@
 
 
 #define GIT_REV "unknown"
+/* The host build (Makefile) defines CSP_POSIX on the command line */
+#ifndef CSP_POSIX
 #define CSP_FREERTOS 1
-/* #undef CSP_POSIX */
+#endif
 /* #undef CSP_WINDOWS */
 /* #undef CSP_MACOSX */
 #define CSP_DEBUG 1
@@ -23,8 +25,11 @@
 /* #undef CSP_USE_QOS */
 /* #undef CSP_USE_DEDUP */
 /* #undef CSP_USE_INIT_SHUTDOWN */
+/* #undef CSP_USE_RTABLE_CIDR */
 #define csp_use_crc32
+#ifndef CSP_CONN_MAX
 #define CSP_CONN_MAX 10
+#endif
 #define CSP_CONN_QUEUE_LENGTH 100
 #define CSP_FIFO_INPUT 10
 #define CSP_MAX_BIND_PORT 31
@@ -35,8 +40,11 @@
 #define CSP_LOG_LEVEL_INFO 1
 #define CSP_LOG_LEVEL_WARN 1
 #define CSP_LOG_LEVEL_ERROR 1
+#if defined(CSP_POSIX) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CSP_LITTLE_ENDIAN 1
+#else
 #define CSP_BIG_ENDIAN 1
-/* #undef CSP_BIG_ENDIAN */
+#endif
 #define CSP_HAVE_STDBOOL_H 1
 #define LIBCSP_VERSION "1.4"
 
@@ -27,16 +27,38 @@ extern "C" {
 
 /**
  * Start the buffer handling system
- * You must specify the number for buffers and the size. All buffers are fixed
- * size so you must specify the size of your largest buffer.
+ * You must specify the number for buffers and the size of your largest buffer.
+ * All buffers have this size, use csp_buffer_init_classes() to set aside some
+ * of the memory as small buffers for pings, RDP ACKs and other short packets.
  *
- * @param count Number of buffers to allocate
+ * @param count Number of buffers of the full size to allocate
  * @param size Buffer size in bytes.
  *
  * @return CSP_ERR_NONE if malloc() succeeded, CSP_ERR message otherwise.
  */
 int csp_buffer_init(int count, int size);
 
+/** Buffer size class, see csp_buffer_init_classes() */
+typedef struct {
+	int count;	/**< Number of buffers in this class */
+	int size;	/**< Buffer size in bytes */
+} csp_buffer_class_t;
+
+/**
+ * Start the buffer handling system with several buffer sizes.
+ * csp_buffer_get() hands out a buffer from the smallest class that fits the
+ * requested size, so small packets do not occupy full MTU sized buffers.
+ * If that class is empty, the next larger class is used. On a 32-bit target,
+ * 20 buffers of 256 bytes take about as much memory as 16 of 256 bytes and 12
+ * of 64 bytes.
+ *
+ * @param classes Array of size classes, sorted by increasing size
+ * @param num_classes Number of elements in classes, at most CSP_BUFFER_CLASSES
+ *
+ * @return CSP_ERR_NONE if malloc() succeeded, CSP_ERR message otherwise.
+ */
+int csp_buffer_init_classes(const csp_buffer_class_t * classes, int num_classes);
+
 /**
  * Get a reference to a free buffer. This function can only be called
  * from task context.
@@ -68,20 +90,41 @@ void csp_buffer_free(void *packet);
 void csp_buffer_free_isr(void *packet);
 
 /**
- * Clone an existing packet and increase/decrease cloned packet size.
+ * Clone an existing packet into a new buffer.
+ * Only the packet header and packet->length bytes of data are copied.
  * @param buffer Existing buffer to clone.
  */
 void * csp_buffer_clone(void *buffer);
 
 /**
- * Return how many buffers that are currently free.
+ * Take an additional reference to a buffer without copying it.
+ * The buffer is returned to the pool when every reference has been
+ * passed to csp_buffer_free(). A shared buffer must be treated as read-only,
+ * use csp_buffer_cow() to get a writable buffer.
+ * @param buffer Buffer to share
+ * @return buffer, or NULL if buffer is not a valid CSP buffer
+ */
+void * csp_buffer_ref(void *buffer);
+
+/**
+ * Make a shared buffer writable (copy-on-write).
+ * If the caller holds the only reference, buffer is returned unchanged.
+ * Otherwise a private clone is returned and the caller's reference to
+ * buffer is dropped.
+ * @param buffer Buffer the caller wants to modify
+ * @return writable buffer, or NULL if out of buffers (buffer is still held by the caller)
+ */
+void * csp_buffer_cow(void *buffer);
+
+/**
+ * Return how many buffers that are currently free, across all size classes.
  * @return number of free buffers
  */
 int csp_buffer_remaining(void);
 
 /**
  * Return the size of the CSP buffers
- * @return size of CSP buffers
+ * @return size of the largest CSP buffer class
  */
 int csp_buffer_size(void);
 
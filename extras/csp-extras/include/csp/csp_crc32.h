@@ -27,11 +27,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 extern "C" {
 #endif
 
-/**
- * Generate precomputed CRC32 table
- */
-void csp_crc32_gentab(void);
-
 /**
  * Append CRC32 checksum to packet
  * @param packet Packet to append checksum
@@ -25,7 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define CSP_NODE_MAC				0xFF
 #define CSP_ROUTE_COUNT				(CSP_ID_HOST_MAX + 2)
-#define CSP_ROUTE_TABLE_SIZE		5 * CSP_ROUTE_COUNT
+/* Raw table, an interface pointer and a mac per route (5 bytes each on the TMS570) */
+#define CSP_ROUTE_TABLE_SIZE		(CSP_ROUTE_COUNT * (sizeof(csp_iface_t *) + sizeof(uint8_t)))
 
 /**
  * Find outgoing interface in routing table
@@ -51,6 +52,16 @@ uint8_t csp_rtable_find_mac(uint8_t id);
  */
 int csp_rtable_set(uint8_t node, uint8_t mask, csp_iface_t *ifc, uint8_t mac);
 
+/**
+ * Remove routing entry set with csp_rtable_set
+ * Nodes it routed fall back to the next longest matching route (with the
+ * static table, to the default route).
+ * @param node Host, or CSP_DEFAULT_ROUTE
+ * @param mask Number of bits in netmask, ignored by the static table
+ * @return CSP_ERR_NONE, or CSP_ERR_INVAL if there is no such route
+ */
+int csp_rtable_remove(uint8_t node, uint8_t mask);
+
 /**
  * Print routing table to stdout
  */
@@ -1,6 +1,11 @@
 #ifndef __CSP_STRING_H__
 #define __CSP_STRING_H__
 
+#include <csp/csp_autoconfig.h>
+
+/* The TI runtime library has no strnlen, the POSIX C library does */
+#if defined(CSP_FREERTOS)
+
 static inline size_t strnlen (const char *string, size_t length);
 
 static inline size_t strnlen (const char *string, size_t length)
@@ -8,4 +13,6 @@ static inline size_t strnlen (const char *string, size_t length)
     char *ret = memchr (string, 0, length);
     return ret ? ret - string : length;
 }
+
+#endif
 #endif
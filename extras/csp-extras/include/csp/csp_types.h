@@ -67,6 +67,16 @@ typedef enum {
 #define CSP_RX_QUEUES			1
 #endif
 
+/** Maximum number of packets the router processes per wakeup */
+#ifndef CSP_ROUTE_BATCH
+#define CSP_ROUTE_BATCH			8
+#endif
+
+/** Maximum number of router workers, see csp_route_start_workers() */
+#ifndef CSP_ROUTE_WORKERS
+#define CSP_ROUTE_WORKERS		1
+#endif
+
 /** Size of bit-fields in CSP header */
 #define CSP_ID_PRIO_SIZE		2
 #define CSP_ID_HOST_SIZE		5
@@ -0,0 +1,56 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _CSP_DRIVERS_CRC_H_
+#define _CSP_DRIVERS_CRC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <csp/csp.h>
+
+/**
+ * Initialise the CRC module driver.
+ * crcInit() and dmaEnable() must have been called by the application.
+ * @return 0 on success, -1 on error
+ */
+int crc_init(void);
+
+/**
+ * Hash a memory area with the CRC module.
+ * The module computes a 64-bit PSA signature, which is not the CRC32C carried
+ * with CSP_FCRC32, so the result is only usable as a hash, for example with
+ * csp_dedup_set_hash(). The same data always gives the same hash: calls wait
+ * while the module is in use, and the signature is calculated in software
+ * before crc_init() or when a DMA transfer does not complete.
+ * @param data pointer to memory
+ * @param length number of bytes
+ * @return 32-bit hash of the memory area
+ */
+uint32_t crc_hash(const uint8_t * data, uint32_t length);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _CSP_DRIVERS_CRC_H_ */
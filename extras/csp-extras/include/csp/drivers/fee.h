@@ -0,0 +1,68 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _CSP_DRIVERS_FEE_H_
+#define _CSP_DRIVERS_FEE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <csp/csp.h>
+
+/**
+ * SFP checkpoint store in a TI FEE (emulated EEPROM) block, used as
+ * csp_sfp_store_t store = { fee_store_load, fee_store_save, (void *) BLOCK };
+ * where BLOCK is the FEE block number. TI_Fee_Init() must have been called,
+ * and an application task must keep calling TI_Fee_MainFunction(): that task
+ * completes every FEE job, the store only polls the job status with
+ * csp_sleep_ms() and never calls TI_Fee_MainFunction() itself. A wait fails
+ * after FEE_STORE_TIMEOUT ms (1000 by default).
+ */
+
+/**
+ * Read a checkpoint from a FEE block, after waiting for FEE to finish the
+ * current job.
+ * @param arg FEE block number
+ * @param data buffer for the checkpoint
+ * @param size size of the checkpoint
+ * @return 0 on success, -1 on error
+ */
+int fee_store_load(void * arg, void * data, uint32_t size);
+
+/**
+ * Start writing a checkpoint to a FEE block, or invalidate the block when
+ * data is NULL. A checkpoint is skipped if FEE is still busy, the previous
+ * one is kept. Invalidating waits for FEE and for the job to complete, which
+ * must not be called from the task running TI_Fee_MainFunction().
+ * @param arg FEE block number
+ * @param data checkpoint, or NULL
+ * @param size size of the checkpoint, at most the block size
+ * @return 0 if the write was started or the block invalidated, -1 on error
+ */
+int fee_store_save(void * arg, const void * data, uint32_t size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* _CSP_DRIVERS_FEE_H_ */
@@ -29,6 +29,7 @@ extern "C" {
 
 #include <csp/csp.h>
 #include <csp/csp_interface.h>
+#include <csp/arch/csp_semaphore.h>
 
 /**
  * The KISS interface relies on the USART callback in order to parse incoming
@@ -72,6 +73,15 @@ typedef void (*csp_kiss_putc_f)(char buf);
  */
 typedef void (*csp_kiss_discard_f)(char c, void *pxTaskWoken);
 
+/**
+ * The write function is an optional faster alternative to putc, which
+ * is given the encoded frame in chunks instead of one byte at a time,
+ * e.g. usart_putstr of a DMA driver. Set it with csp_kiss_set_write.
+ * @param buf pointer to data, only valid during the call
+ * @param len length of data
+ */
+typedef void (*csp_kiss_write_f)(char * buf, int len);
+
 typedef enum {
 	KISS_MODE_NOT_STARTED,
 	KISS_MODE_STARTED,
@@ -87,6 +97,8 @@ typedef enum {
 typedef struct csp_kiss_handle_s {
 	csp_kiss_putc_f kiss_putc;
 	csp_kiss_discard_f kiss_discard;
+	csp_kiss_write_f kiss_write;
+	csp_bin_sem_handle_t tx_sem;
 	unsigned int rx_length;
 	kiss_mode_e rx_mode;
 	unsigned int rx_first;
@@ -96,6 +108,13 @@ typedef struct csp_kiss_handle_s {
 
 void csp_kiss_init(csp_iface_t * csp_iface, csp_kiss_handle_t * csp_kiss_handle, csp_kiss_putc_f kiss_putc_f, csp_kiss_discard_f kiss_discard_f, const char * name);
 
+/**
+ * Send frames through a write function instead of putc
+ * @param csp_kiss_handle handle given to csp_kiss_init
+ * @param kiss_write_f write function, or NULL to use putc again
+ */
+void csp_kiss_set_write(csp_kiss_handle_t * csp_kiss_handle, csp_kiss_write_f kiss_write_f);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -7,12 +7,25 @@
 extern "C" {
 #endif
 
+/**
+ * The hub interface connects nodes through a hub process (examples/csp_hub.c)
+ * on Unix domain sockets instead of a ZMQ proxy. Frames are as on zmqhub:
+ * one byte of destination address, followed by the CSP id in network byte
+ * order and the data. The hub forwards each frame to the nodes subscribed to
+ * its destination address.
+ */
+
+/** Hub socket used when no host is given */
+#ifndef CSP_ZMQHUB_PATH
+#define CSP_ZMQHUB_PATH "/tmp/csp-hub"
+#endif
+
 extern csp_iface_t csp_if_zmqhub;
 
 /**
  * Setup ZMQ interface
  * @param addr only receive messages matching this address (255 means all)
- * @param host Pointer to string containing zmqproxy host
+ * @param host path of the hub socket, NULL for CSP_ZMQHUB_PATH
  * @return CSP_ERR
  */
 int csp_zmqhub_init(char addr, char * host);
@@ -20,8 +33,8 @@ int csp_zmqhub_init(char addr, char * host);
 /**
  * Setup ZMQ interface
  * @param addr only receive messages matching this address (255 means all)
- * @param publisher_endpoint Pointer to string containing zmqproxy publisher endpoint
- * @param subscriber_endpoint Pointer to string containing zmqproxy subscriber endpoint
+ * @param publisher_url hub socket frames are sent to, a path or ipc:// url
+ * @param subscriber_url hub socket frames are received from, may be the same
  * @return CSP_ERR
  */
 int csp_zmqhub_init_w_endpoints(char _addr, char * publisher_url,
@@ -0,0 +1,52 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 Gomspace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk) 
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <pthread.h>
+#include <limits.h>
+
+/* CSP includes */
+#include <csp/csp.h>
+
+#include <csp/arch/csp_thread.h>
+
+int csp_thread_create(csp_thread_return_t (* routine)(void *), const char * const thread_name, unsigned short stack_depth, void * parameters, unsigned int priority, csp_thread_handle_t * handle) {
+
+	/* Stack depth and priority only apply to FreeRTOS, let the OS pick defaults */
+	pthread_attr_t attributes;
+	csp_thread_handle_t thread;
+
+	if (pthread_attr_init(&attributes) != 0)
+		return CSP_ERR_NOMEM;
+
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+	int ret = pthread_create(&thread, &attributes, routine, parameters);
+	pthread_attr_destroy(&attributes);
+
+	if (ret != 0)
+		return CSP_ERR_NOMEM;
+
+	if (handle != NULL)
+		*handle = thread;
+
+	return CSP_ERR_NONE;
+
+}
@@ -37,6 +37,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 /* HMAC key */
 static uint8_t csp_hmac_key[HMAC_KEY_LENGTH];
 
+/* SHA1 states after the inner (key ^ ipad) and outer (key ^ opad) blocks of csp_hmac_key,
+ * so a packet only costs the compressions of its own data and the outer digest */
+static csp_sha1_state csp_hmac_inner;
+static csp_sha1_state csp_hmac_outer;
+
 /* HMAC state structure */
 typedef struct {
 	csp_sha1_state	md;
@@ -136,6 +141,51 @@ int csp_hmac_memory(const uint8_t * key, uint32_t keylen, const uint8_t * data,
 	return CSP_ERR_NONE;
 }
 
+/* Hash the key blocks of csp_hmac_key into csp_hmac_inner and csp_hmac_outer */
+static void csp_hmac_precompute(void) {
+
+	uint32_t i;
+	uint8_t buf[SHA1_BLOCKSIZE];
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, csp_hmac_key, HMAC_KEY_LENGTH);
+
+	for (i = 0; i < SHA1_BLOCKSIZE; i++)
+		buf[i] ^= 0x36;
+	csp_sha1_init(&csp_hmac_inner);
+	csp_sha1_process(&csp_hmac_inner, buf, SHA1_BLOCKSIZE);
+
+	/* 0x36 ^ 0x6A == 0x5C */
+	for (i = 0; i < SHA1_BLOCKSIZE; i++)
+		buf[i] ^= 0x6A;
+	csp_sha1_init(&csp_hmac_outer);
+	csp_sha1_process(&csp_hmac_outer, buf, SHA1_BLOCKSIZE);
+
+}
+
+void csp_hmac_init_key(void) {
+
+	/* The key is all zeros, unless csp_hmac_set_key was called before csp_init */
+	csp_hmac_precompute();
+
+}
+
+/* HMAC of data with csp_hmac_key, same result as csp_hmac_memory */
+static void csp_hmac_keyed_memory(const uint8_t * data, uint32_t datalen, uint8_t * hmac) {
+
+	csp_sha1_state md;
+	uint8_t isha[SHA1_DIGESTSIZE];
+
+	md = csp_hmac_inner;
+	csp_sha1_process(&md, data, datalen);
+	csp_sha1_done(&md, isha);
+
+	md = csp_hmac_outer;
+	csp_sha1_process(&md, isha, SHA1_DIGESTSIZE);
+	csp_sha1_done(&md, hmac);
+
+}
+
 int csp_hmac_set_key(char * key, uint32_t keylen) {
 
 	/* Use SHA1 as KDF */
@@ -145,6 +195,9 @@ int csp_hmac_set_key(char * key, uint32_t keylen) {
 	/* Copy key */
 	memcpy(csp_hmac_key, hash, HMAC_KEY_LENGTH);
 
+	/* Key the inner and outer hash states once, instead of for every packet */
+	csp_hmac_precompute();
+
 	return CSP_ERR_NONE;
 
 }
@@ -159,9 +212,9 @@ int csp_hmac_append(csp_packet_t * packet, bool include_header) {
 
 	/* Calculate HMAC */
 	if (include_header) {
-		csp_hmac_memory(csp_hmac_key, HMAC_KEY_LENGTH, (uint8_t *) &packet->id, packet->length + sizeof(packet->id), hmac);
+		csp_hmac_keyed_memory((uint8_t *) &packet->id, packet->length + sizeof(packet->id), hmac);
 	} else {
-		csp_hmac_memory(csp_hmac_key, HMAC_KEY_LENGTH, packet->data, packet->length, hmac);
+		csp_hmac_keyed_memory(packet->data, packet->length, hmac);
 	}
 
 	/* Truncate hash and copy to packet */
@@ -182,9 +235,9 @@ int csp_hmac_verify(csp_packet_t * packet, bool include_header) {
 
 	/* Calculate HMAC */
 	if (include_header) {
-		csp_hmac_memory(csp_hmac_key, HMAC_KEY_LENGTH, (uint8_t *) &packet->id, packet->length + sizeof(packet->id) - CSP_HMAC_LENGTH, hmac);
+		csp_hmac_keyed_memory((uint8_t *) &packet->id, packet->length + sizeof(packet->id) - CSP_HMAC_LENGTH, hmac);
 	} else {
-		csp_hmac_memory(csp_hmac_key, HMAC_KEY_LENGTH, packet->data, packet->length - CSP_HMAC_LENGTH, hmac);
+		csp_hmac_keyed_memory(packet->data, packet->length - CSP_HMAC_LENGTH, hmac);
 	}
 
 	/* Compare calculated HMAC with packet header */
@@ -30,6 +30,13 @@ extern "C" {
 
 #define CSP_HMAC_LENGTH	4
 
+/**
+ * Key the precomputed hash states with the current key, all zeros unless
+ * csp_hmac_set_key has been called. Called by csp_init, before the router
+ * can authenticate packets.
+ */
+void csp_hmac_init_key(void);
+
 /**
  * Append HMAC to packet
  * @param packet Pointer to packet
@@ -49,27 +49,64 @@ static uint32_t csp_xtea_key[XTEA_KEY_LENGTH/sizeof(uint32_t)] __attribute__ ((a
 								 ((uint32_t)((y)[1] & 0xff) << 8)  | \
 								 ((uint32_t)((y)[0] & 0xff) << 0); } while (0)
 
-/* This function takes 64 bits of data in block and the 128 bits key in key */
-static inline void csp_xtea_encrypt_block(uint8_t *block, uint8_t const *key) {
+/* Counter blocks encrypted together, independent lanes keep the pipeline (or SIMD unit) busy */
+#ifndef XTEA_LANES
+#define XTEA_LANES		4
+#endif
 
-	uint32_t i, v0, v1, delta = 0x9E3779B9, sum = 0, k[4];
+/* Key schedule, the round key added in each half round: sum + k[sum & 3] and sum + k[(sum >> 11) & 3] */
+static uint32_t csp_xtea_rk0[XTEA_ROUNDS];
+static uint32_t csp_xtea_rk1[XTEA_ROUNDS];
+
+static void csp_xtea_schedule(void) {
+
+	uint32_t i, delta = 0x9E3779B9, sum = 0, k[4];
+	uint8_t * key = (uint8_t *) csp_xtea_key;
 
 	LOAD32L(k[0], &key[0]);
 	LOAD32L(k[1], &key[4]);
 	LOAD32L(k[2], &key[8]);
 	LOAD32L(k[3], &key[12]);
 
-	LOAD32L(v0, &block[0]);
-	LOAD32L(v1, &block[4]);
-
 	for (i = 0; i < XTEA_ROUNDS; i++) {
-		v0 += (((v1 << 4) ^ (v1 >> 5)) + v1) ^ (sum + k[sum & 3]);
+		csp_xtea_rk0[i] = sum + k[sum & 3];
 		sum += delta;
-		v1 += (((v0 << 4) ^ (v0 >> 5)) + v0) ^ (sum + k[(sum >> 11) & 3]);
+		csp_xtea_rk1[i] = sum + k[(sum >> 11) & 3];
 	}
 
-	STORE32L(v0, &block[0]);
-	STORE32L(v1, &block[4]);
+}
+
+void csp_xtea_init_key(void) {
+
+	/* The key is all zeros, unless csp_xtea_set_key was called before csp_init */
+	csp_xtea_schedule();
+
+}
+
+static inline uint32_t csp_xtea_swap32(uint32_t x) {
+
+	return (x << 24) | ((x << 8) & 0x00FF0000) | ((x >> 8) & 0x0000FF00) | (x >> 24);
+
+}
+
+/* Keystream words are stored little-endian, convert them to words in memory order for the XOR */
+#ifdef CSP_BIG_ENDIAN
+#define XTEA_LE(x)	csp_xtea_swap32(x)
+#else
+#define XTEA_LE(x)	(x)
+#endif
+
+/* Encrypt XTEA_LANES blocks with the same v0 and a different v1 each */
+static inline void csp_xtea_encrypt_lanes(uint32_t v0[XTEA_LANES], uint32_t v1[XTEA_LANES]) {
+
+	uint32_t i, l;
+
+	for (i = 0; i < XTEA_ROUNDS; i++) {
+		for (l = 0; l < XTEA_LANES; l++)
+			v0[l] += (((v1[l] << 4) ^ (v1[l] >> 5)) + v1[l]) ^ csp_xtea_rk0[i];
+		for (l = 0; l < XTEA_LANES; l++)
+			v1[l] += (((v0[l] << 4) ^ (v0[l] >> 5)) + v0[l]) ^ csp_xtea_rk1[i];
+	}
 
 }
 
@@ -81,6 +118,16 @@ static inline void csp_xtea_xor_byte(uint8_t * dst, uint8_t * src, uint32_t len)
 
 }
 
+/* XOR 32 bits of keystream into a possibly unaligned buffer */
+static inline void csp_xtea_xor_word(uint8_t * dst, uint32_t stream) {
+
+	uint32_t word;
+	memcpy(&word, dst, sizeof(word));
+	word ^= XTEA_LE(stream);
+	memcpy(dst, &word, sizeof(word));
+
+}
+
 int csp_xtea_set_key(char * key, uint32_t keylen) {
 
 	/* Use SHA1 as KDF */
@@ -90,37 +137,53 @@ int csp_xtea_set_key(char * key, uint32_t keylen) {
 	/* Copy key */
 	memcpy(csp_xtea_key, hash, XTEA_KEY_LENGTH);
 
+	/* Expand the round keys once, instead of for every block */
+	csp_xtea_schedule();
+
 	return CSP_ERR_NONE;
 
 }
 
+/**
+ * The counter block is the IV as two big-endian words, read back by the cipher
+ * as little-endian words, and the keystream is stored little-endian. Block 0 and
+ * block 1 both use counter iv[1], block n > 1 uses iv[1] + n - 1. This matches
+ * the original byte-wise implementation, so packets stay compatible.
+ */
 int csp_xtea_encrypt(uint8_t * plain, const uint32_t len, uint32_t iv[2]) {
 
-	unsigned int i;
-	uint32_t stream[2];
-
-	uint32_t blocks = (len + XTEA_BLOCKSIZE - 1)/ XTEA_BLOCKSIZE;
-	uint32_t remain;
+	uint32_t v0[XTEA_LANES], v1[XTEA_LANES];
+	uint32_t blocks = (len + XTEA_BLOCKSIZE - 1) / XTEA_BLOCKSIZE;
+	uint32_t block, l, remain;
+	uint8_t stream[XTEA_BLOCKSIZE];
 
-	/* Initialize stream */
-	stream[0] = csp_htobe32(iv[0]);
-	stream[1] = csp_htobe32(iv[1]);
+	for (block = 0; block < blocks; block += XTEA_LANES) {
 
-	for (i = 0; i < blocks; i++) {
 		/* Create stream */
-		csp_xtea_encrypt_block((uint8_t *)stream, (uint8_t *)csp_xtea_key);
-
-		/* Calculate remaining bytes */
-		remain = len - i * XTEA_BLOCKSIZE;
+		for (l = 0; l < XTEA_LANES; l++) {
+			v0[l] = csp_xtea_swap32(iv[0]);
+			v1[l] = csp_xtea_swap32(iv[1] + (block + l > 0 ? block + l - 1 : 0));
+		}
+		csp_xtea_encrypt_lanes(v0, v1);
 
 		/* XOR plain text with stream to generate cipher text */
-		csp_xtea_xor_byte(&plain[len - remain], (uint8_t *)stream, remain < XTEA_BLOCKSIZE ? remain : XTEA_BLOCKSIZE);
-
-		/* Increment counter */
-		stream[0] = csp_htobe32(iv[0]);
-		stream[1] = csp_htobe32(iv[1]++);
+		for (l = 0; (l < XTEA_LANES) && (block + l < blocks); l++) {
+			remain = len - (block + l) * XTEA_BLOCKSIZE;
+			if (remain >= XTEA_BLOCKSIZE) {
+				csp_xtea_xor_word(plain, v0[l]);
+				csp_xtea_xor_word(plain + 4, v1[l]);
+			} else {
+				STORE32L(v0[l], &stream[0]);
+				STORE32L(v1[l], &stream[4]);
+				csp_xtea_xor_byte(plain, stream, remain);
+			}
+			plain += XTEA_BLOCKSIZE;
+		}
 	}
 
+	/* The counter is advanced once per block */
+	iv[1] += blocks;
+
 	return CSP_ERR_NONE;
 
 }
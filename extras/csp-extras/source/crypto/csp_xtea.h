@@ -29,6 +29,12 @@ extern "C" {
 
 #define CSP_XTEA_IV_LENGTH	8
 
+/**
+ * Expand the round keys of the current key, all zeros unless csp_xtea_set_key
+ * has been called. Called by csp_init, before the router can decrypt packets.
+ */
+void csp_xtea_init_key(void);
+
 /**
  * XTEA encrypt byte array
  * @param plain Pointer to plain text
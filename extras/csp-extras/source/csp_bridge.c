@@ -38,7 +38,7 @@ static CSP_DEFINE_TASK(csp_bridge) {
 	while (1) {
 
 		/* Get next packet to route */
-		if (csp_qfifo_read(&input) != CSP_ERR_NONE)
+		if (csp_qfifo_read(0, &input, FIFO_TIMEOUT) != CSP_ERR_NONE)
 			continue;
 
 		packet = input.packet;
@@ -47,7 +47,8 @@ static CSP_DEFINE_TASK(csp_bridge) {
 				packet->id.src, packet->id.dst, packet->id.dport,
 				packet->id.sport, packet->id.pri, packet->id.flags, packet->length);
 
-		/* Here there be promiscuous mode */
+		/* Here there be promiscuous mode. Every packet is forwarded, and interfaces may
+		 * write to the buffer, so the promiscuous task gets its own copy */
 #ifdef CSP_USE_PROMISC
 		csp_promisc_add(packet);
 #endif
@@ -71,6 +72,8 @@ static CSP_DEFINE_TASK(csp_bridge) {
 
 	}
 
+	return CSP_TASK_RETURN;
+
 }
 
 int csp_bridge_start(unsigned int task_stack_size, unsigned int task_priority, csp_iface_t * _if_a, csp_iface_t * _if_b) {
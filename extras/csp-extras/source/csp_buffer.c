@@ -25,7 +25,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 /* CSP includes */
 #include <csp/csp.h>
 #include <csp/csp_error.h>
-#include <csp/arch/csp_queue.h>
 #include <csp/arch/csp_malloc.h>
 #include <csp/arch/csp_semaphore.h>
 
@@ -33,77 +32,247 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define CSP_BUFFER_ALIGN	(sizeof(int *))
 #endif
 
+/* Maximum number of buffer size classes */
+#ifndef CSP_BUFFER_CLASSES
+#define CSP_BUFFER_CLASSES	4
+#endif
+
+/* Room left behind the requested size when picking a size class, so the
+ * RDP header, HMAC, CRC32 and XTEA nonce can still be appended in place */
+#ifndef CSP_BUFFER_TAIL_ROOM
+#define CSP_BUFFER_TAIL_ROOM	20
+#endif
+
+/* Use compare-and-swap on the free lists when the compiler provides it,
+ * otherwise fall back to a short critical section */
+#if defined(__GNUC__) && !defined(__TI_COMPILER_VERSION__)
+#define CSP_BUFFER_LOCKFREE	1
+#endif
+
+/* The free list head packs an ABA tag above the element index */
+#define FREE_INDEX_MASK		0x0000FFFF
+#define FREE_TAG_INC		0x00010000
+#define FREE_MAX_COUNT		FREE_INDEX_MASK
+
 typedef struct csp_skbf_s {
 	unsigned int refcount;
+	uint16_t pool;		// Size class this element belongs to
+	uint16_t next;		// Free list link, index + 1 of next free element
 	void * skbf_addr;
 	char skbf_data[];
 } csp_skbf_t;
 
-static csp_queue_handle_t csp_buffers;
-static char * csp_buffer_pool;
-static unsigned int count, size;
+typedef struct {
+	char * mem;			// Element storage
+	unsigned int skbfsize;		// Aligned element size including csp_skbf_t
+	unsigned int size;		// Usable size including packet overhead
+	unsigned int count;		// Number of elements
+	volatile uint32_t head;		// Free list head: tag | (index + 1)
+	volatile int free;		// Number of free elements
+} csp_buffer_pool_t;
+
+static csp_buffer_pool_t csp_buffer_pools[CSP_BUFFER_CLASSES];
+static unsigned int pools, size;
 
 CSP_DEFINE_CRITICAL(csp_critical_lock);
 
-int csp_buffer_init(int buf_count, int buf_size) {
+static inline csp_skbf_t * csp_buffer_elem(csp_buffer_pool_t * pool, uint32_t index) {
+	return (void *) &pool->mem[index * pool->skbfsize];
+}
 
-	unsigned int i;
+static csp_skbf_t * csp_buffer_pop(csp_buffer_pool_t * pool, int isr) {
+
+	uint32_t head;
 	csp_skbf_t * buf;
 
-	count = buf_count;
-	size = buf_size + CSP_BUFFER_PACKET_OVERHEAD;
-	unsigned int skbfsize = (sizeof(csp_skbf_t) + size);
-	skbfsize = CSP_BUFFER_ALIGN * ((skbfsize + CSP_BUFFER_ALIGN - 1) / CSP_BUFFER_ALIGN);
-	unsigned int poolsize = count * skbfsize;
+#ifdef CSP_BUFFER_LOCKFREE
+	uint32_t next;
+	head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+	do {
+		if ((head & FREE_INDEX_MASK) == 0)
+			return NULL;
+		buf = csp_buffer_elem(pool, (head & FREE_INDEX_MASK) - 1);
+		next = ((head + FREE_TAG_INC) & ~FREE_INDEX_MASK) | __atomic_load_n(&buf->next, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&pool->head, &head, next, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	__atomic_fetch_sub(&pool->free, 1, __ATOMIC_RELAXED);
+#else
+	/* ISRs run with IRQs masked, so only task context needs the lock */
+	if (!isr)
+		CSP_ENTER_CRITICAL(csp_critical_lock);
+	head = pool->head;
+	if (head & FREE_INDEX_MASK) {
+		buf = csp_buffer_elem(pool, (head & FREE_INDEX_MASK) - 1);
+		pool->head = (head & ~FREE_INDEX_MASK) | buf->next;
+		pool->free--;
+	} else {
+		buf = NULL;
+	}
+	if (!isr)
+		CSP_EXIT_CRITICAL(csp_critical_lock);
+#endif
+
+	return buf;
+
+}
+
+static void csp_buffer_push(csp_buffer_pool_t * pool, csp_skbf_t * buf, int isr) {
+
+	uint32_t index = (((char *) buf - pool->mem) / pool->skbfsize) + 1;
+
+#ifdef CSP_BUFFER_LOCKFREE
+	uint32_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&buf->next, head & FREE_INDEX_MASK, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&pool->head, &head, ((head + FREE_TAG_INC) & ~FREE_INDEX_MASK) | index,
+			1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	__atomic_fetch_add(&pool->free, 1, __ATOMIC_RELAXED);
+#else
+	if (!isr)
+		CSP_ENTER_CRITICAL(csp_critical_lock);
+	buf->next = pool->head & FREE_INDEX_MASK;
+	pool->head = (pool->head & ~FREE_INDEX_MASK) | index;
+	pool->free++;
+	if (!isr)
+		CSP_EXIT_CRITICAL(csp_critical_lock);
+#endif
+
+}
+
+/* Drop one reference and return the number of references left */
+static unsigned int csp_buffer_unref(csp_skbf_t * buf, int isr) {
+
+	unsigned int left;
+
+#ifdef CSP_BUFFER_LOCKFREE
+	left = __atomic_sub_fetch(&buf->refcount, 1, __ATOMIC_ACQ_REL);
+#else
+	if (!isr)
+		CSP_ENTER_CRITICAL(csp_critical_lock);
+	left = --buf->refcount;
+	if (!isr)
+		CSP_EXIT_CRITICAL(csp_critical_lock);
+#endif
+
+	return left;
+
+}
+
+/* Look up the element header of a buffer handed out by csp_buffer_get */
+static csp_skbf_t * csp_buffer_skbf(void * buffer) {
+
+	csp_skbf_t * buf = buffer - sizeof(csp_skbf_t);
+
+	if (((uintptr_t) buf % CSP_BUFFER_ALIGN) > 0)
+		return NULL;
+
+	if (buf->skbf_addr != buf || buf->pool >= pools)
+		return NULL;
+
+	return buf;
+
+}
+
+/* Take a buffer from the smallest class that fits, falling back to larger classes */
+static csp_skbf_t * csp_buffer_alloc(size_t buf_size, int isr) {
+
+	unsigned int i;
+	size_t need = buf_size + CSP_BUFFER_PACKET_OVERHEAD;
+	csp_skbf_t * buf = NULL;
+
+	for (i = 0; i < pools && buf == NULL; i++) {
+		/* The largest class is allowed to be used without tail room */
+		if (i < pools - 1 && csp_buffer_pools[i].size < need + CSP_BUFFER_TAIL_ROOM)
+			continue;
+		buf = csp_buffer_pop(&csp_buffer_pools[i], isr);
+	}
+
+	return buf;
+
+}
+
+int csp_buffer_init_classes(const csp_buffer_class_t * classes, int num_classes) {
+
+	int i;
+	unsigned int j;
+	csp_buffer_pool_t * pool;
+	csp_skbf_t * buf;
 
-	csp_buffer_pool = csp_malloc(poolsize);
-	if (csp_buffer_pool == NULL)
-		goto fail_malloc;
+	if (num_classes < 1 || num_classes > CSP_BUFFER_CLASSES)
+		return CSP_ERR_INVAL;
 
-	csp_buffers = csp_queue_create(count, sizeof(void *));
-	if (!csp_buffers)
-		goto fail_queue;
+	for (i = 0; i < num_classes; i++) {
+		if (classes[i].count < 1 || classes[i].count > FREE_MAX_COUNT)
+			return CSP_ERR_INVAL;
+		if (i > 0 && classes[i].size <= classes[i - 1].size)
+			return CSP_ERR_INVAL;
+	}
 
 	if (CSP_INIT_CRITICAL(csp_critical_lock) != CSP_ERR_NONE)
-		goto fail_critical;
+		return CSP_ERR_NOMEM;
+
+	for (i = 0; i < num_classes; i++) {
+
+		pool = &csp_buffer_pools[i];
+		pool->count = classes[i].count;
+		pool->size = classes[i].size + CSP_BUFFER_PACKET_OVERHEAD;
+		pool->skbfsize = sizeof(csp_skbf_t) + pool->size;
+		pool->skbfsize = CSP_BUFFER_ALIGN * ((pool->skbfsize + CSP_BUFFER_ALIGN - 1) / CSP_BUFFER_ALIGN);
+
+		pool->mem = csp_malloc(pool->count * pool->skbfsize);
+		if (pool->mem == NULL)
+			goto fail_malloc;
 
-	memset(csp_buffer_pool, 0, poolsize);
+		memset(pool->mem, 0, pool->count * pool->skbfsize);
 
-	for (i = 0; i < count; i++) {
+		/* Chain all elements, lowest address first */
+		for (j = 0; j < pool->count; j++) {
 
-		/* We have already taken care of pointer alignment since
-		 * skbfsize is an integer multiple of sizeof(int *)
-		 * but the explicit cast to a void * is still necessary
-		 * to tell the compiler so.
-		 */
-		buf = (void *) &csp_buffer_pool[i * skbfsize];
-		buf->refcount = 0;
-		buf->skbf_addr = buf;
+			/* We have already taken care of pointer alignment since
+			 * skbfsize is an integer multiple of sizeof(int *)
+			 * but the explicit cast to a void * is still necessary
+			 * to tell the compiler so.
+			 */
+			buf = csp_buffer_elem(pool, j);
+			buf->refcount = 0;
+			buf->skbf_addr = buf;
+			buf->pool = i;
+			buf->next = (j + 1 < pool->count) ? j + 2 : 0;
 
-		csp_queue_enqueue(csp_buffers, &buf, 0);
+		}
+
+		pool->head = 1;
+		pool->free = pool->count;
 
 	}
 
+	pools = num_classes;
+	size = csp_buffer_pools[pools - 1].size;
+
 	return CSP_ERR_NONE;
 
-fail_critical:
-	csp_queue_remove(csp_buffers);
-fail_queue:
-	csp_free(csp_buffer_pool);
 fail_malloc:
+	while (--i >= 0)
+		csp_free(csp_buffer_pools[i].mem);
 	return CSP_ERR_NOMEM;
 
 }
 
+int csp_buffer_init(int buf_count, int buf_size) {
+
+	csp_buffer_class_t single = { .count = buf_count, .size = buf_size };
+
+	return csp_buffer_init_classes(&single, 1);
+
+}
+
 void *csp_buffer_get_isr(size_t buf_size) {
 
-	csp_skbf_t * buffer = NULL;
-	CSP_BASE_TYPE task_woken = 0;
+	csp_skbf_t * buffer;
 
 	if (buf_size + CSP_BUFFER_PACKET_OVERHEAD > size)
 		return NULL;
 
-	csp_queue_dequeue_isr(csp_buffers, &buffer, &task_woken);
+	buffer = csp_buffer_alloc(buf_size, 1);
 	if (buffer == NULL)
 		return NULL;
 
@@ -117,14 +286,14 @@ void *csp_buffer_get_isr(size_t buf_size) {
 
 void *csp_buffer_get(size_t buf_size) {
 
-	csp_skbf_t * buffer = NULL;
+	csp_skbf_t * buffer;
 
 	if (buf_size + CSP_BUFFER_PACKET_OVERHEAD > size) {
 		csp_log_error("Attempt to allocate too large block %u", buf_size);
 		return NULL;
 	}
 
-	csp_queue_dequeue(csp_buffers, &buffer, 0);
+	buffer = csp_buffer_alloc(buf_size, 0);
 	if (buffer == NULL) {
 		csp_log_error("Out of buffers");
 		return NULL;
@@ -142,7 +311,6 @@ void *csp_buffer_get(size_t buf_size) {
 }
 
 void csp_buffer_free_isr(void *packet) {
-	CSP_BASE_TYPE task_woken = 0;
 	if (!packet)
 		return;
 
@@ -154,15 +322,14 @@ void csp_buffer_free_isr(void *packet) {
 	if (buf->skbf_addr != buf)
 		return;
 
-	if (buf->refcount == 0) {
+	if (buf->pool >= pools)
 		return;
-	} else if (buf->refcount > 1) {
-		buf->refcount--;
+
+	if (buf->refcount == 0)
 		return;
-	} else {
-		buf->refcount = 0;
-		csp_queue_enqueue_isr(csp_buffers, &buf, &task_woken);
-	}
+
+	if (csp_buffer_unref(buf, 1) == 0)
+		csp_buffer_push(&csp_buffer_pools[buf->pool], buf, 1);
 
 }
 
@@ -184,19 +351,24 @@ void csp_buffer_free(void *packet) {
 		return;
 	}
 
+	if (buf->pool >= pools) {
+		csp_log_error("FREE: Invalid CSP buffer class %p", packet);
+		return;
+	}
+
 	if (buf->refcount == 0) {
 		csp_log_error("FREE: Buffer already free %p", buf);
 		return;
-	} else if (buf->refcount > 1) {
-		buf->refcount--;
-		csp_log_error("FREE: Buffer %p in use by %u users", buf, buf->refcount);
+	}
+
+	if (csp_buffer_unref(buf, 0) > 0) {
+		csp_log_buffer("FREE: Buffer %p still shared", buf);
 		return;
-	} else {
-		buf->refcount = 0;
-		csp_log_buffer("FREE: %p", buf);
-		csp_queue_enqueue(csp_buffers, &buf, 0);
 	}
 
+	csp_log_buffer("FREE: %p", buf);
+	csp_buffer_push(&csp_buffer_pools[buf->pool], buf, 0);
+
 }
 
 void *csp_buffer_clone(void *buffer) {
@@ -208,15 +380,71 @@ void *csp_buffer_clone(void *buffer) {
 
 	csp_packet_t *clone = csp_buffer_get(packet->length);
 
+	/* Only the header and the used part of the payload carry information */
 	if (clone)
-		memcpy(clone, packet, size);
+		memcpy(clone, packet, CSP_BUFFER_PACKET_OVERHEAD + packet->length);
 
 	return clone;
 
 }
 
+void *csp_buffer_ref(void *buffer) {
+
+	if (!buffer)
+		return NULL;
+
+	csp_skbf_t * buf = csp_buffer_skbf(buffer);
+	if (buf == NULL || buf->refcount == 0) {
+		csp_log_error("REF: Invalid CSP buffer pointer %p", buffer);
+		return NULL;
+	}
+
+#ifdef CSP_BUFFER_LOCKFREE
+	__atomic_add_fetch(&buf->refcount, 1, __ATOMIC_RELAXED);
+#else
+	CSP_ENTER_CRITICAL(csp_critical_lock);
+	buf->refcount++;
+	CSP_EXIT_CRITICAL(csp_critical_lock);
+#endif
+
+	return buffer;
+
+}
+
+void *csp_buffer_cow(void *buffer) {
+
+	if (!buffer)
+		return NULL;
+
+	csp_skbf_t * buf = csp_buffer_skbf(buffer);
+	if (buf == NULL)
+		return NULL;
+
+#ifdef CSP_BUFFER_LOCKFREE
+	unsigned int refs = __atomic_load_n(&buf->refcount, __ATOMIC_ACQUIRE);
+#else
+	unsigned int refs = buf->refcount;
+#endif
+
+	/* Sole owner, write in place */
+	if (refs <= 1)
+		return buffer;
+
+	void * copy = csp_buffer_clone(buffer);
+	if (copy == NULL)
+		return NULL;
+
+	csp_buffer_free(buffer);
+	return copy;
+
+}
+
 int csp_buffer_remaining(void) {
-	return csp_queue_size(csp_buffers);
+	unsigned int i;
+	int remaining = 0;
+	for (i = 0; i < pools; i++)
+		remaining += csp_buffer_pools[i].free;
+	return remaining;
 }
 
 int csp_buffer_size(void) {
@@ -34,11 +34,57 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <csp/arch/csp_time.h>
 
 #include "csp_conn.h"
+#include "csp_qfifo.h"
 #include "transport/csp_transport.h"
 
 /* Static connection pool */
 static csp_conn_t arr_conn[CSP_CONN_MAX];
 
+/* Size of the connection hash index, at least twice CSP_CONN_MAX */
+#ifndef CSP_CONN_HASH_BITS
+#if CSP_CONN_MAX <= 8
+#define CSP_CONN_HASH_BITS	4
+#elif CSP_CONN_MAX <= 16
+#define CSP_CONN_HASH_BITS	5
+#elif CSP_CONN_MAX <= 32
+#define CSP_CONN_HASH_BITS	6
+#elif CSP_CONN_MAX <= 64
+#define CSP_CONN_HASH_BITS	7
+#elif CSP_CONN_MAX <= 128
+#define CSP_CONN_HASH_BITS	8
+#elif CSP_CONN_MAX <= 256
+#define CSP_CONN_HASH_BITS	9
+#elif CSP_CONN_MAX <= 512
+#define CSP_CONN_HASH_BITS	10
+#else
+#define CSP_CONN_HASH_BITS	11
+#endif
+#endif
+
+#define CSP_CONN_HASH_SIZE	(1 << CSP_CONN_HASH_BITS)
+#define CSP_CONN_HASH_EMPTY	0xFFFF
+#define CSP_CONN_HASH_DELETED	0xFFFE
+
+#if CSP_CONN_MAX >= CSP_CONN_HASH_DELETED
+#error "CSP_CONN_MAX too large for connection hash index"
+#endif
+
+/* Open addressing index of client connections, keyed on idin & CSP_ID_CONN_MASK.
+ * Entries never move, so the router can look up without taking conn_lock while
+ * connections are opened and closed; all updates are done under conn_lock. */
+static uint16_t conn_hash[CSP_CONN_HASH_SIZE];
+
+/* Hash slot of each indexed connection, CSP_CONN_HASH_EMPTY if not indexed */
+static uint16_t conn_hash_slot[CSP_CONN_MAX];
+
+/* Dense list of indexed connections, walked by the timeout sweep */
+static uint16_t conn_open[CSP_CONN_MAX];
+static uint16_t conn_open_pos[CSP_CONN_MAX];
+static int conn_open_count;
+
+/* Number of client connections using each local (incoming destination) port */
+static uint16_t conn_dport_used[CSP_ID_PORT_MAX + 1];
+
 /* Connection pool lock */
 static csp_bin_sem_handle_t conn_lock;
 
@@ -48,13 +94,94 @@ static uint8_t sport;
 /* Source port lock */
 static csp_bin_sem_handle_t sport_lock;
 
-void csp_conn_check_timeouts(void) {
+static inline uint32_t csp_conn_hash_key(uint32_t id) {
+	/* Fibonacci hashing of the connection bits */
+	return ((id & CSP_ID_CONN_MASK) * 2654435761u) >> (32 - CSP_CONN_HASH_BITS);
+}
+
+/* Add a client connection to the index, must be called with conn_lock held */
+static void csp_conn_index_add(csp_conn_t * conn) {
+
+	uint16_t i = conn - arr_conn;
+	uint32_t slot = csp_conn_hash_key(conn->idin.ext);
+
+	while (conn_hash[slot] != CSP_CONN_HASH_EMPTY && conn_hash[slot] != CSP_CONN_HASH_DELETED)
+		slot = (slot + 1) & (CSP_CONN_HASH_SIZE - 1);
+
+	conn_hash[slot] = i;
+	conn_hash_slot[i] = slot;
+
+	conn_open_pos[i] = conn_open_count;
+	conn_open[conn_open_count++] = i;
+
+	conn_dport_used[conn->idin.dport]++;
+
+}
+
+/* Remove a connection from the index, must be called with conn_lock held */
+static void csp_conn_index_remove(csp_conn_t * conn) {
+
+	uint16_t i = conn - arr_conn;
+	uint32_t slot = conn_hash_slot[i];
+
+	if (slot == CSP_CONN_HASH_EMPTY)
+		return;
+
+	conn_hash_slot[i] = CSP_CONN_HASH_EMPTY;
+	conn_hash[slot] = CSP_CONN_HASH_DELETED;
+
+	/* A deleted marker at the end of a probe chain can become empty again */
+	while (conn_hash[slot] == CSP_CONN_HASH_DELETED &&
+			conn_hash[(slot + 1) & (CSP_CONN_HASH_SIZE - 1)] == CSP_CONN_HASH_EMPTY) {
+		conn_hash[slot] = CSP_CONN_HASH_EMPTY;
+		slot = (slot - 1) & (CSP_CONN_HASH_SIZE - 1);
+	}
+
+	/* Swap the last open connection into the hole */
+	uint16_t pos = conn_open_pos[i];
+	uint16_t last = conn_open[--conn_open_count];
+	conn_open[pos] = last;
+	conn_open_pos[last] = pos;
+
+	conn_dport_used[conn->idin.dport]--;
+
+}
+
+static csp_conn_t * csp_conn_index_find(uint32_t id) {
+
+	uint32_t slot = csp_conn_hash_key(id);
+	uint16_t i;
+	int probes;
+
+	for (probes = 0; probes < CSP_CONN_HASH_SIZE; probes++) {
+		i = conn_hash[slot];
+		if (i == CSP_CONN_HASH_EMPTY)
+			break;
+		if (i != CSP_CONN_HASH_DELETED) {
+			csp_conn_t * conn = &arr_conn[i];
+			if ((conn->state != CONN_CLOSED) && (conn->type == CONN_CLIENT) &&
+					((conn->idin.ext & CSP_ID_CONN_MASK) == (id & CSP_ID_CONN_MASK)))
+				return conn;
+		}
+		slot = (slot + 1) & (CSP_CONN_HASH_SIZE - 1);
+	}
+
+	return NULL;
+
+}
+
+void csp_conn_check_timeouts(unsigned int worker) {
 #ifdef CSP_USE_RDP
+	/* Walk backwards, so connections closed by the sweep are not skipped.
+	 * Each router worker only checks the connections it receives packets for */
 	int i;
-	for (i = 0; i < CSP_CONN_MAX; i++)
-		if (arr_conn[i].state == CONN_OPEN)
-			if (arr_conn[i].idin.flags & CSP_FRDP)
-				csp_rdp_check_timeouts(&arr_conn[i]);
+	for (i = conn_open_count - 1; i >= 0; i--) {
+		csp_conn_t * conn = &arr_conn[conn_open[i]];
+		if (conn->state == CONN_OPEN)
+			if (conn->idin.flags & CSP_FRDP)
+				if (csp_qfifo_worker(conn->idin.ext) == worker)
+					csp_rdp_check_timeouts(conn);
+	}
 #endif
 }
 
@@ -124,8 +251,12 @@ int csp_conn_init(void) {
 		return CSP_ERR_NOMEM;
 	}
 
+	memset(conn_hash, 0xFF, sizeof(conn_hash));
+	conn_open_count = 0;
+
 	int i, prio;
 	for (i = 0; i < CSP_CONN_MAX; i++) {
+		conn_hash_slot[i] = CSP_CONN_HASH_EMPTY;
 		for (prio = 0; prio < CSP_RX_QUEUES; prio++)
 			arr_conn[i].rx_queue[prio] = csp_queue_create(CSP_RX_QUEUE_LENGTH, sizeof(csp_packet_t *));
 
@@ -158,6 +289,14 @@ int csp_conn_init(void) {
 
 csp_conn_t * csp_conn_find(uint32_t id, uint32_t mask) {
 
+	/* Full connection match, used by the router for every packet */
+	if (mask == CSP_ID_CONN_MASK)
+		return csp_conn_index_find(id);
+
+	/* Ephemeral port search in csp_connect */
+	if (mask == CSP_ID_DPORT_MASK && conn_dport_used[(id & CSP_ID_DPORT_MASK) >> (CSP_ID_FLAGS_SIZE + CSP_ID_PORT_SIZE)] == 0)
+		return NULL;
+
 	/* Search for matching connection */
 	int i;
 	csp_conn_t * conn;
@@ -247,6 +386,15 @@ csp_conn_t * csp_conn_new(csp_id_t idin, csp_id_t idout) {
 
 		/* Ensure connection queue is empty */
 		csp_conn_flush_rx_queue(conn);
+
+		/* Make the connection visible to csp_conn_find */
+		if (csp_bin_sem_wait(&conn_lock, 100) != CSP_SEMAPHORE_OK) {
+			csp_log_error("Failed to lock conn array");
+			conn->state = CONN_CLOSED;
+			return NULL;
+		}
+		csp_conn_index_add(conn);
+		csp_bin_sem_post(&conn_lock);
 	}
 
 	return conn;
@@ -280,6 +428,7 @@ int csp_close(csp_conn_t * conn) {
 
 	/* Set to closed */
 	conn->state = CONN_CLOSED;
+	csp_conn_index_remove(conn);
 
 	/* Ensure connection queue is empty */
 	csp_conn_flush_rx_queue(conn);
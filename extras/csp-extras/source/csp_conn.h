@@ -52,6 +52,49 @@ typedef enum {
 	RDP_CLOSE_WAIT,
 } csp_rdp_state_t;
 
+/** @brief Size of the RDP out-of-order receive ring.
+ *  Power of two holding the two windows a peer may send ahead, so seq_nr & (size - 1)
+ *  stays unique across 16-bit sequence number wraparound */
+#ifndef CSP_RDP_RX_RING_SIZE
+#if CSP_RDP_MAX_WINDOW <= 8
+#define CSP_RDP_RX_RING_SIZE	16
+#elif CSP_RDP_MAX_WINDOW <= 16
+#define CSP_RDP_RX_RING_SIZE	32
+#elif CSP_RDP_MAX_WINDOW <= 32
+#define CSP_RDP_RX_RING_SIZE	64
+#elif CSP_RDP_MAX_WINDOW <= 64
+#define CSP_RDP_RX_RING_SIZE	128
+#else
+#define CSP_RDP_RX_RING_SIZE	256
+#endif
+#endif
+
+/** @brief Size of the RDP retransmission ring, indexed by seq_nr like the receive ring.
+ *  Power of two holding one window, the sender never has more segments in flight */
+#ifndef CSP_RDP_TX_RING_SIZE
+#if CSP_RDP_MAX_WINDOW <= 8
+#define CSP_RDP_TX_RING_SIZE	8
+#elif CSP_RDP_MAX_WINDOW <= 16
+#define CSP_RDP_TX_RING_SIZE	16
+#elif CSP_RDP_MAX_WINDOW <= 32
+#define CSP_RDP_TX_RING_SIZE	32
+#elif CSP_RDP_MAX_WINDOW <= 64
+#define CSP_RDP_TX_RING_SIZE	64
+#else
+#define CSP_RDP_TX_RING_SIZE	128
+#endif
+#endif
+
+/** @brief Lower bound of the adaptive RDP retransmission timeout in ms */
+#ifndef CSP_RDP_RTO_MIN
+#define CSP_RDP_RTO_MIN		20
+#endif
+
+/** @brief Congestion window of a new RDP connection, in segments */
+#ifndef CSP_RDP_CWND_INIT
+#define CSP_RDP_CWND_INIT	2
+#endif
+
 /** @brief RDP Connection header
  *  @note Do not try to pack this struct, the posix sem handle will stop working */
 typedef struct {
@@ -69,9 +112,25 @@ typedef struct {
 	uint32_t ack_timeout;
 	uint32_t ack_delay_count;
 	uint32_t ack_timestamp;
+	uint32_t srtt;			/**< Smoothed round-trip time in 1/8 ms, 0 until the first sample */
+	uint32_t rttvar;		/**< Round-trip time variation in 1/4 ms */
+	uint32_t rto;			/**< Retransmission timeout in ms, including backoff */
+	uint32_t retransmits;		/**< Number of retransmitted segments */
+	uint8_t probed;			/**< A tail loss probe was sent since snd_una last advanced */
+	uint32_t cwnd;			/**< Congestion window in segments, never larger than window_size */
+	uint32_t ssthresh;		/**< Slow start threshold in segments */
+	uint32_t cwnd_acked;		/**< Segments ACKed since the last increase in congestion avoidance */
+	uint16_t snd_recover;		/**< snd_nxt at the last window reduction, no reduction until it is ACKed */
 	csp_bin_sem_handle_t tx_wait;
-	csp_queue_handle_t tx_queue;
-	csp_queue_handle_t rx_queue;
+	csp_packet_t * tx_ring[CSP_RDP_TX_RING_SIZE];	/**< Unacknowledged segments, indexed by seq_nr */
+	uint16_t tx_next[CSP_RDP_TX_RING_SIZE];	/**< Retransmission list, oldest transmission first */
+	uint16_t tx_prev[CSP_RDP_TX_RING_SIZE];
+	uint8_t tx_retries[CSP_RDP_TX_RING_SIZE];	/**< Retransmissions of each segment, RTT is only sampled when zero */
+	uint16_t tx_head;		/**< Slot of the segment that times out first */
+	uint16_t tx_tail;		/**< Slot of the segment sent last */
+	uint16_t tx_count;		/**< Number of segments in tx_ring */
+	csp_packet_t * rx_ring[CSP_RDP_RX_RING_SIZE];	/**< Out-of-order segments, indexed by seq_nr */
+	uint16_t rx_count;		/**< Number of segments in rx_ring */
 } csp_rdp_t;
 
 /** @brief Connection struct */
@@ -100,7 +159,7 @@ int csp_conn_init(void);
 csp_conn_t * csp_conn_allocate(csp_conn_type_t type);
 csp_conn_t * csp_conn_find(uint32_t id, uint32_t mask);
 csp_conn_t * csp_conn_new(csp_id_t idin, csp_id_t idout);
-void csp_conn_check_timeouts(void);
+void csp_conn_check_timeouts(unsigned int worker);
 int csp_conn_get_rxq(int prio);
 
 #ifdef __cplusplus
@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include <csp/csp.h>
@@ -29,39 +30,85 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "csp_dedup.h"
 
-/* Check the last CSP_DEDUP_COUNT packets for duplicates */
+/* Remember up to CSP_DEDUP_COUNT packets, must be a multiple of CSP_DEDUP_WAYS */
+#ifndef CSP_DEDUP_COUNT
 #define CSP_DEDUP_COUNT		16
+#endif
 
 /* Only consider packet a duplicate if received under CSP_DEDUP_WINDOW_MS ago */
+#ifndef CSP_DEDUP_WINDOW_MS
 #define CSP_DEDUP_WINDOW_MS	1000
+#endif
 
-/* Store packet CRC's in a ringbuffer */
-static uint32_t csp_dedup_array[CSP_DEDUP_COUNT] = {};
-static uint32_t csp_dedup_timestamp[CSP_DEDUP_COUNT] = {};
-static int csp_dedup_in = 0;
+/* Entries per hash set, a new packet replaces the oldest entry of its set. Tables of
+ * up to 16 entries are a single set, so any of the last CSP_DEDUP_COUNT packets is found. */
+#ifndef CSP_DEDUP_WAYS
+#if (CSP_DEDUP_COUNT <= 16)
+#define CSP_DEDUP_WAYS		CSP_DEDUP_COUNT
+#else
+#define CSP_DEDUP_WAYS		8
+#endif
+#endif
 
-bool csp_dedup_is_duplicate(csp_packet_t *packet)
+#define CSP_DEDUP_SETS		(CSP_DEDUP_COUNT / CSP_DEDUP_WAYS)
+
+#if (CSP_DEDUP_WAYS > 32)
+#error "CSP_DEDUP_WAYS must be 32 or less"
+#endif
+
+#if (CSP_DEDUP_SETS == 0) || (CSP_DEDUP_SETS & (CSP_DEDUP_SETS - 1))
+#error "CSP_DEDUP_COUNT / CSP_DEDUP_WAYS must be a power of two"
+#endif
+
+/* Packet hashes and the time they were first seen, in sets selected by the hash */
+typedef struct {
+	uint32_t hash[CSP_DEDUP_WAYS];
+	uint32_t timestamp[CSP_DEDUP_WAYS];
+	uint32_t used;				/* Bit n is set when entry n holds a packet */
+	uint8_t next;				/* Entry to replace next, the oldest once the set is full */
+} csp_dedup_set_t;
+
+static csp_dedup_set_t csp_dedup[CSP_ROUTE_WORKERS][CSP_DEDUP_SETS];
+
+/* Hash of the packet id and data */
+static uint32_t (*csp_dedup_hash_memory)(const uint8_t * data, uint32_t length) = csp_crc32_memory;
+
+void csp_dedup_set_hash(uint32_t (*hash)(const uint8_t * data, uint32_t length))
 {
-	/* Calculate CRC32 for packet */
-	uint32_t crc = csp_crc32_memory((const uint8_t *) &packet->id, packet->length + sizeof(packet->id));
+	csp_dedup_hash_memory = (hash != NULL) ? hash : csp_crc32_memory;
+}
 
-	/* Check if we have received this packet before */
-	int i;
-	for (i = 0; i < CSP_DEDUP_COUNT; i++) {
+static uint32_t csp_dedup_hash(csp_packet_t *packet)
+{
+	/* Calculate CRC32 (or the hash set with csp_dedup_set_hash) for packet. The CRC32
+	 * trailer is not used in place of the payload: duplicates are checked before the
+	 * CRC is verified, and forwarded packets are not verified at all, so a corrupted
+	 * copy with an intact trailer would hide the valid retransmission after it. */
+	return csp_dedup_hash_memory((const uint8_t *) &packet->id, packet->length + sizeof(packet->id));
+}
 
-		/* Check for match */
-		if (crc == csp_dedup_array[i]) {
+bool csp_dedup_is_duplicate(unsigned int worker, csp_packet_t *packet)
+{
+	uint32_t hash = csp_dedup_hash(packet);
+	uint32_t now = csp_get_ms();
+	csp_dedup_set_t * set = &csp_dedup[worker][((hash * 2654435761u) >> 16) & (CSP_DEDUP_SETS - 1)];
+	int i;
 
-			/* Check the timestamp */
-			if (csp_get_ms() < csp_dedup_timestamp[i] + CSP_DEDUP_WINDOW_MS)
-				return true;
-		}
+	/* Check for match, the age is unsigned so this is safe across timer wraparound */
+	for (i = 0; i < CSP_DEDUP_WAYS; i++) {
+		if ((set->used & (1u << i)) && (set->hash[i] == hash) &&
+				((uint32_t)(now - set->timestamp[i]) < CSP_DEDUP_WINDOW_MS))
+			return true;
 	}
 
-	/* If not, insert packet into duplicate list */
-	csp_dedup_array[csp_dedup_in] = crc;
-	csp_dedup_timestamp[csp_dedup_in] = csp_get_ms();
-	csp_dedup_in = (csp_dedup_in + 1) % CSP_DEDUP_COUNT;
+	/* If not, insert packet into duplicate list in place of the oldest entry. Packets
+	 * seen in the same millisecond have the same timestamp, so the order of insertion
+	 * decides which entry is the oldest. */
+	i = set->next;
+	set->next = (i + 1) % CSP_DEDUP_WAYS;
+	set->hash[i] = hash;
+	set->timestamp[i] = now;
+	set->used |= (1u << i);
 
 	return false;
 }
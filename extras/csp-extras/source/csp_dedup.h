@@ -23,9 +23,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 /**
  * Check for a duplicate packet
+ * Duplicates have the same id and are handled by the same router worker,
+ * so each worker has its own list and no locking is needed.
+ * @param worker router worker handling the packet
  * @param packet pointer to packet
  * @return false if not a duplicate, true if duplicate
  */
-bool csp_dedup_is_duplicate(csp_packet_t *packet);
+bool csp_dedup_is_duplicate(unsigned int worker, csp_packet_t *packet);
 
 #endif /* CSP_DEDUP_H_ */
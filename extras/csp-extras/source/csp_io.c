@@ -107,6 +107,14 @@ int csp_init(unsigned char address) {
 	/* Initialize CSP */
 	csp_set_address(address);
 
+#ifdef CSP_USE_HMAC
+	csp_hmac_init_key();
+#endif
+
+#ifdef CSP_USE_XTEA
+	csp_xtea_init_key();
+#endif
+
 	ret = csp_conn_init();
 	if (ret != CSP_ERR_NONE)
 		return ret;
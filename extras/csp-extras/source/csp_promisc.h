@@ -27,4 +27,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 void csp_promisc_add(csp_packet_t * packet);
 
+/**
+ * Add packet to promiscuous mode packet queue without copying it.
+ * The buffer is shared with the queue, so the caller must use
+ * csp_buffer_cow() before modifying the packet.
+ * @param packet Packet to add to the queue
+ */
+void csp_promisc_add_ref(csp_packet_t * packet);
+
 #endif /* CSP_PROMISC_H_ */
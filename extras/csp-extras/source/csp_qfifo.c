@@ -21,67 +21,178 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <csp/csp.h>
 #include <csp/csp_interface.h>
 #include <csp/arch/csp_queue.h>
+#include <csp/arch/csp_semaphore.h>
 #include "csp_qfifo.h"
 
-static csp_queue_handle_t qfifo[CSP_ROUTE_FIFOS];
+/* Number of router workers in use, packets are sharded over these */
+static unsigned int qfifo_workers = 1;
+
+int csp_qfifo_set_workers(unsigned int workers) {
+
+	if ((workers == 0) || (workers > CSP_ROUTE_WORKERS))
+		return CSP_ERR_INVAL;
+
+	qfifo_workers = workers;
+
+	return CSP_ERR_NONE;
+
+}
+
+unsigned int csp_qfifo_worker(uint32_t id) {
+
+	if (qfifo_workers == 1)
+		return 0;
+
+	/* Fibonacci hashing of the connection bits, scaled to the number of workers */
+	return (uint32_t)(((uint64_t)((id & CSP_ID_CONN_MASK) * 2654435761u) * qfifo_workers) >> 32);
+
+}
+
 #ifdef CSP_USE_QOS
-static csp_queue_handle_t qfifo_events;
-#endif
+
+/**
+ * With QoS the router input of each worker is one ring per priority, a bitmap of
+ * the rings that are not empty and a single semaphore to wake the worker. A packet
+ * costs one copy into its ring and one semaphore post, and the worker always takes
+ * the oldest packet of the highest priority (lowest number) first.
+ */
+typedef struct {
+	csp_qfifo_t elem[CSP_FIFO_INPUT];
+	uint16_t head;		/* Index of the oldest element */
+	uint16_t count;		/* Number of elements in the ring */
+} csp_qfifo_ring_t;
+
+typedef struct {
+	csp_qfifo_ring_t ring[CSP_ROUTE_FIFOS];
+	volatile uint32_t pending;	/* Bit n is set when ring[n] is not empty */
+	csp_bin_sem_handle_t wait;
+} csp_qfifo_input_t;
+
+static csp_qfifo_input_t qfifo[CSP_ROUTE_WORKERS];
+static int qfifo_ready;
+
+CSP_DEFINE_CRITICAL(qfifo_lock);
 
 int csp_qfifo_init(void) {
-	int prio;
 
-	/* Create router fifos for each priority */
-	for (prio = 0; prio < CSP_ROUTE_FIFOS; prio++) {
-		if (qfifo[prio] == NULL) {
-			qfifo[prio] = csp_queue_create(CSP_FIFO_INPUT, sizeof(csp_qfifo_t));
-			if (!qfifo[prio])
-				return CSP_ERR_NOMEM;
-		}
-	}
+	int worker;
 
-#ifdef CSP_USE_QOS
-	/* Create QoS fifo notification queue */
-	qfifo_events = csp_queue_create(CSP_FIFO_INPUT, sizeof(int));
-	if (!qfifo_events)
+	if (qfifo_ready)
+		return CSP_ERR_NONE;
+
+	if (CSP_INIT_CRITICAL(qfifo_lock) != CSP_ERR_NONE)
 		return CSP_ERR_NOMEM;
-#endif
+
+	for (worker = 0; worker < CSP_ROUTE_WORKERS; worker++)
+		if (csp_bin_sem_create(&qfifo[worker].wait) != CSP_SEMAPHORE_OK)
+			return CSP_ERR_NOMEM;
+
+	qfifo_ready = 1;
 
 	return CSP_ERR_NONE;
 
 }
 
-int csp_qfifo_read(csp_qfifo_t * input) {
+/* Take the next packet from the highest priority ring that is not empty */
+static int csp_qfifo_pop(csp_qfifo_input_t * fifo, csp_qfifo_t * input) {
 
-#ifdef CSP_USE_QOS
-	int prio, found, event;
+	int prio;
+	csp_qfifo_ring_t * ring;
+
+	CSP_ENTER_CRITICAL(qfifo_lock);
 
-	/* Wait for packet in any queue */
-	if (csp_queue_dequeue(qfifo_events, &event, FIFO_TIMEOUT) != CSP_QUEUE_OK)
+	if (fifo->pending == 0) {
+		CSP_EXIT_CRITICAL(qfifo_lock);
 		return CSP_ERR_TIMEDOUT;
+	}
 
-	/* Find packet with highest priority */
-	found = 0;
-	for (prio = 0; prio < CSP_ROUTE_FIFOS; prio++) {
-		if (csp_queue_dequeue(qfifo[prio], input, 0) == CSP_QUEUE_OK) {
-			found = 1;
-			break;
-		}
+	for (prio = 0; (fifo->pending & (1 << prio)) == 0; prio++);
+
+	ring = &fifo->ring[prio];
+	*input = ring->elem[ring->head];
+	ring->head = (ring->head + 1) % CSP_FIFO_INPUT;
+	if (--ring->count == 0)
+		fifo->pending &= ~(1 << prio);
+
+	CSP_EXIT_CRITICAL(qfifo_lock);
+
+	return CSP_ERR_NONE;
+
+}
+
+/* Add a packet to the ring of its priority, ISRs run with IRQs masked and skip the lock */
+static int csp_qfifo_push(csp_qfifo_input_t * fifo, csp_qfifo_t * input, int prio, int isr) {
+
+	int result = CSP_QUEUE_ERROR;
+	csp_qfifo_ring_t * ring = &fifo->ring[prio];
+
+	if (!isr)
+		CSP_ENTER_CRITICAL(qfifo_lock);
+
+	if (ring->count < CSP_FIFO_INPUT) {
+		ring->elem[(ring->head + ring->count) % CSP_FIFO_INPUT] = *input;
+		ring->count++;
+		fifo->pending |= (1 << prio);
+		result = CSP_QUEUE_OK;
 	}
 
-	if (!found) {
-		csp_log_warn("Spurious wakeup: No packet found");
+	if (!isr)
+		CSP_EXIT_CRITICAL(qfifo_lock);
+
+	return result;
+
+}
+
+int csp_qfifo_read(unsigned int worker, csp_qfifo_t * input, uint32_t timeout) {
+
+	csp_qfifo_input_t * fifo = &qfifo[worker];
+
+	if (csp_qfifo_pop(fifo, input) == CSP_ERR_NONE)
+		return CSP_ERR_NONE;
+
+	if (timeout == 0)
 		return CSP_ERR_TIMEDOUT;
-	}
+
+	/* Wait for a packet in any ring. The semaphore may still be posted for a packet
+	 * that has already been read, in which case the router just runs one more time */
+	if (csp_bin_sem_wait(&fifo->wait, timeout) != CSP_SEMAPHORE_OK)
+		return CSP_ERR_TIMEDOUT;
+
+	return csp_qfifo_pop(fifo, input);
+
+}
+
 #else
-	if (csp_queue_dequeue(qfifo[0], input, FIFO_TIMEOUT) != CSP_QUEUE_OK)
+
+static csp_queue_handle_t qfifo[CSP_ROUTE_WORKERS];
+
+int csp_qfifo_init(void) {
+	int worker;
+
+	/* Create a router fifo for each worker */
+	for (worker = 0; worker < CSP_ROUTE_WORKERS; worker++) {
+		if (qfifo[worker] == NULL) {
+			qfifo[worker] = csp_queue_create(CSP_FIFO_INPUT, sizeof(csp_qfifo_t));
+			if (!qfifo[worker])
+				return CSP_ERR_NOMEM;
+		}
+	}
+
+	return CSP_ERR_NONE;
+
+}
+
+int csp_qfifo_read(unsigned int worker, csp_qfifo_t * input, uint32_t timeout) {
+
+	if (csp_queue_dequeue(qfifo[worker], input, timeout) != CSP_QUEUE_OK)
 		return CSP_ERR_TIMEDOUT;
-#endif
 
 	return CSP_ERR_NONE;
 
 }
 
+#endif
+
 void csp_qfifo_write(csp_packet_t * packet, csp_iface_t * interface, CSP_BASE_TYPE * pxTaskWoken) {
 
 	int result;
@@ -102,26 +213,23 @@ void csp_qfifo_write(csp_packet_t * packet, csp_iface_t * interface, CSP_BASE_TY
 	queue_element.interface = interface;
 	queue_element.packet = packet;
 
-#ifdef CSP_USE_QOS
-	int fifo = packet->id.pri;
-#else
-	int fifo = 0;
-#endif
-
-	if (pxTaskWoken == NULL)
-		result = csp_queue_enqueue(qfifo[fifo], &queue_element, 0);
-	else
-		result = csp_queue_enqueue_isr(qfifo[fifo], &queue_element, pxTaskWoken);
+	/* Packets of one connection always go to the same worker, so they stay in order */
+	unsigned int worker = csp_qfifo_worker(packet->id.ext);
 
 #ifdef CSP_USE_QOS
-	static int event = 0;
+	result = csp_qfifo_push(&qfifo[worker], &queue_element, packet->id.pri, pxTaskWoken != NULL);
 
 	if (result == CSP_QUEUE_OK) {
 		if (pxTaskWoken == NULL)
-			csp_queue_enqueue(qfifo_events, &event, 0);
+			csp_bin_sem_post(&qfifo[worker].wait);
 		else
-			csp_queue_enqueue_isr(qfifo_events, &event, pxTaskWoken);
+			csp_bin_sem_post_isr(&qfifo[worker].wait, pxTaskWoken);
 	}
+#else
+	if (pxTaskWoken == NULL)
+		result = csp_queue_enqueue(qfifo[worker], &queue_element, 0);
+	else
+		result = csp_queue_enqueue_isr(qfifo[worker], &queue_element, pxTaskWoken);
 #endif
 
 	if (result != CSP_QUEUE_OK) {
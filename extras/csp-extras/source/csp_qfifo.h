@@ -22,7 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define CSP_QFIFO_H_
 
 #ifdef CSP_USE_RDP
-#define FIFO_TIMEOUT 100				//! If RDP is enabled, the router needs to awake some times to check timeouts
+#define FIFO_TIMEOUT 10				//! If RDP is enabled, the router needs to awake some times to check timeouts, more often than CSP_RDP_RTO_MIN
 #else
 #define FIFO_TIMEOUT CSP_MAX_DELAY		//! If no RDP, the router can sleep untill data arrives
 #endif
@@ -40,9 +40,27 @@ typedef struct {
 
 /**
  * Read next packet from router input queue
+ * @param worker router worker, 0 when a single router task is used
  * @param input pointer to router queue item element
+ * @param timeout time in ms to wait for a packet
  * @return CSP_ERR type
  */
-int csp_qfifo_read(csp_qfifo_t * input);
+int csp_qfifo_read(unsigned int worker, csp_qfifo_t * input, uint32_t timeout);
+
+/**
+ * Set the number of router workers the input is sharded over
+ * @param workers number of workers, at most CSP_ROUTE_WORKERS
+ * @return CSP_ERR type
+ */
+int csp_qfifo_set_workers(unsigned int workers);
+
+/**
+ * Get the router worker that handles a CSP id.
+ * Only the connection bits (CSP_ID_CONN_MASK) are used, so every packet
+ * of a connection is handled by the same worker.
+ * @param id CSP id, as id.ext
+ * @return worker number
+ */
+unsigned int csp_qfifo_worker(uint32_t id);
 
 #endif /* CSP_QFIFO_H_ */
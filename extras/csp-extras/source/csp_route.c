@@ -18,8 +18,10 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <inttypes.h>
 
 /* CSP includes */
@@ -29,6 +31,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <csp/arch/csp_thread.h>
 #include <csp/arch/csp_queue.h>
+#include <csp/arch/csp_time.h>
 
 #include "crypto/csp_hmac.h"
 #include "crypto/csp_xtea.h"
@@ -41,6 +44,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "csp_dedup.h"
 #include "transport/csp_transport.h"
 
+/** Minimum time in ms between two connection timeout checks in the router */
+#ifndef CSP_ROUTE_TIMEOUT_INTERVAL
+#define CSP_ROUTE_TIMEOUT_INTERVAL	1
+#endif
+
+static csp_route_stats_t route_stats[CSP_ROUTE_WORKERS];
+#ifdef CSP_USE_RDP
+static uint32_t route_timeout_check[CSP_ROUTE_WORKERS];
+#endif
+
 /**
  * Check supported packet options
  * @param interface pointer to incoming interface
@@ -166,40 +179,52 @@ static int csp_route_security_check(uint32_t security_opts, csp_iface_t * interf
 
 }
 
-int csp_route_work(uint32_t timeout) {
+/**
+ * Make sure the router holds the only reference to a packet before modifying it
+ * @param packet pointer to packet pointer, updated if the packet was copied
+ * @return CSP_ERR_NONE if the packet may be modified, CSP_ERR_NOMEM if it was dropped
+ */
+static int csp_route_unshare(csp_packet_t ** packet) {
+
+#ifdef CSP_USE_PROMISC
+	csp_packet_t * own = csp_buffer_cow(*packet);
+	if (own == NULL) {
+		csp_log_error("No buffer to unshare packet");
+		csp_buffer_free(*packet);
+		return CSP_ERR_NOMEM;
+	}
+	*packet = own;
+#endif
+
+	return CSP_ERR_NONE;
+
+}
+
+/* Route or deliver one packet from the router input */
+static void csp_route_packet(unsigned int worker, csp_qfifo_t * input) {
 
-	csp_qfifo_t input;
 	csp_packet_t * packet;
 	csp_conn_t * conn;
 	csp_socket_t * socket;
 
-#ifdef CSP_USE_RDP
-	/* Check connection timeouts (currently only for RDP) */
-	csp_conn_check_timeouts();
-#endif
-
-	/* Get next packet to route */
-	if (csp_qfifo_read(&input) != CSP_ERR_NONE)
-		return -1;
-
-	packet = input.packet;
+	packet = input->packet;
 
 	csp_log_packet("INP: S %u, D %u, Dp %u, Sp %u, Pr %u, Fl 0x%02X, Sz %"PRIu16" VIA: %s",
 			packet->id.src, packet->id.dst, packet->id.dport,
-			packet->id.sport, packet->id.pri, packet->id.flags, packet->length, input.interface->name);
+			packet->id.sport, packet->id.pri, packet->id.flags, packet->length, input->interface->name);
 
 	/* Here there be promiscuous mode */
 #ifdef CSP_USE_PROMISC
-	csp_promisc_add(packet);
+	csp_promisc_add_ref(packet);
 #endif
 
 #ifdef CSP_USE_DEDUP
 	/* Check for duplicates */
-	if (csp_dedup_is_duplicate(packet)) {
+	if (csp_dedup_is_duplicate(worker, packet)) {
 		/* Discard packet */
 		csp_log_packet("Duplicate packet discarded");
 		csp_buffer_free(packet);
-		return 0;
+		return;
 	}
 #endif
 
@@ -210,11 +235,15 @@ int csp_route_work(uint32_t timeout) {
 		csp_iface_t * dstif = csp_rtable_find_iface(packet->id.dst);
 
 		/* If the message resolves to the input interface, don't loop it back out */
-		if ((dstif == NULL) || ((dstif == input.interface) && (input.interface->split_horizon_off == 0))) {
+		if ((dstif == NULL) || ((dstif == input->interface) && (input->interface->split_horizon_off == 0))) {
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
 
+		/* Interfaces may write to the buffer, so stop sharing it */
+		if (csp_route_unshare(&packet) != CSP_ERR_NONE)
+			return;
+
 		/* Otherwise, actually send the message */
 		if (csp_send_direct(packet->id, packet, dstif, 0) != CSP_ERR_NONE) {
 			csp_log_warn("Router failed to send");
@@ -222,13 +251,13 @@ int csp_route_work(uint32_t timeout) {
 		}
 
 		/* Next message, please */
-		return 0;
+		return;
 	}
 
 	/* Discard packets with unsupported options */
-	if (csp_route_check_options(input.interface, packet) != CSP_ERR_NONE) {
+	if (csp_route_check_options(input->interface, packet) != CSP_ERR_NONE) {
 		csp_buffer_free(packet);
-		return 0;
+		return;
 	}
 
 	/* The message is to me, search for incoming socket */
@@ -236,34 +265,42 @@ int csp_route_work(uint32_t timeout) {
 
 	/* If the socket is connection-less, deliver now */
 	if (socket && (socket->opts & CSP_SO_CONN_LESS)) {
-		if (csp_route_security_check(socket->opts, input.interface, packet) < 0) {
+		/* Decryption writes to the buffer */
+		if (csp_route_unshare(&packet) != CSP_ERR_NONE)
+			return;
+		if (csp_route_security_check(socket->opts, input->interface, packet) < 0) {
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
 		if (csp_queue_enqueue(socket->socket, &packet, 0) != CSP_QUEUE_OK) {
 			csp_log_error("Conn-less socket queue full");
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
-		return 0;
+		return;
 	}
 
 	/* Search for an existing connection */
 	conn = csp_conn_find(packet->id.ext, CSP_ID_CONN_MASK);
 
+	/* Reject packet if no matching connection or socket is found */
+	if ((conn == NULL) && !socket) {
+		csp_buffer_free(packet);
+		return;
+	}
+
+	/* Decryption and transport processing write to the buffer, only a packet
+	 * that is delivered needs to be copied */
+	if (csp_route_unshare(&packet) != CSP_ERR_NONE)
+		return;
+
 	/* If this is an incoming packet on a new connection */
 	if (conn == NULL) {
 
-		/* Reject packet if no matching socket is found */
-		if (!socket) {
-			csp_buffer_free(packet);
-			return 0;
-		}
-
 		/* Run security check on incoming packet */
-		if (csp_route_security_check(socket->opts, input.interface, packet) < 0) {
+		if (csp_route_security_check(socket->opts, input->interface, packet) < 0) {
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
 
 		/* New incoming connection accepted */
@@ -282,7 +319,7 @@ int csp_route_work(uint32_t timeout) {
 		if (!conn) {
 			csp_log_error("No more connections available");
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
 
 		/* Store the socket queue and options */
@@ -293,9 +330,9 @@ int csp_route_work(uint32_t timeout) {
 	} else {
 
 		/* Run security check on incoming packet */
-		if (csp_route_security_check(conn->opts, input.interface, packet) < 0) {
+		if (csp_route_security_check(conn->opts, input->interface, packet) < 0) {
 			csp_buffer_free(packet);
-			return 0;
+			return;
 		}
 
 	}
@@ -304,34 +341,124 @@ int csp_route_work(uint32_t timeout) {
 	/* Pass packet to RDP module */
 	if (packet->id.flags & CSP_FRDP) {
 		csp_rdp_new_packet(conn, packet);
-		return 0;
+		return;
 	}
 #endif
 
 	/* Pass packet to UDP module */
 	csp_udp_new_packet(conn, packet);
+	return;
+}
+
+/* Process the router input of one worker, see csp_route_work() */
+static int csp_route_worker(unsigned int worker, uint32_t timeout) {
+
+	csp_qfifo_t input;
+	unsigned int count;
+	csp_route_stats_t * stats = &route_stats[worker];
+
+#ifdef CSP_USE_RDP
+	/* Check connection timeouts (currently only for RDP), at most once per interval */
+	uint32_t time_now = csp_get_ms();
+	if ((uint32_t)(time_now - route_timeout_check[worker]) >= CSP_ROUTE_TIMEOUT_INTERVAL) {
+		route_timeout_check[worker] = time_now;
+		stats->timeout_checks++;
+		csp_conn_check_timeouts(worker);
+	}
+#endif
+
+	/* Wait for the first packet, then drain what is already queued without blocking */
+	if (csp_qfifo_read(worker, &input, timeout) != CSP_ERR_NONE)
+		return -1;
+
+	count = 0;
+	do {
+		csp_route_packet(worker, &input);
+		count++;
+	} while ((count < CSP_ROUTE_BATCH) && (csp_qfifo_read(worker, &input, 0) == CSP_ERR_NONE));
+
+	stats->batches++;
+	stats->packets += count;
+	if (count > stats->max_batch)
+		stats->max_batch = count;
+	if (count == CSP_ROUTE_BATCH)
+		stats->full_batches++;
+
 	return 0;
+
+}
+
+int csp_route_work(uint32_t timeout) {
+
+	return csp_route_worker(0, timeout);
+
+}
+
+void csp_route_get_stats(csp_route_stats_t * stats) {
+
+	int worker;
+
+	/* Sum the statistics of all workers */
+	memset(stats, 0, sizeof(*stats));
+	for (worker = 0; worker < CSP_ROUTE_WORKERS; worker++) {
+		stats->batches += route_stats[worker].batches;
+		stats->packets += route_stats[worker].packets;
+		stats->full_batches += route_stats[worker].full_batches;
+		stats->timeout_checks += route_stats[worker].timeout_checks;
+		if (route_stats[worker].max_batch > stats->max_batch)
+			stats->max_batch = route_stats[worker].max_batch;
+	}
+
 }
 
 static CSP_DEFINE_TASK(csp_task_router) {
 
+	unsigned int worker = (uintptr_t) param;
+
 	/* Here there be routing */
 	while (1) {
-		csp_route_work(FIFO_TIMEOUT);
+		csp_route_worker(worker, FIFO_TIMEOUT);
 	}
 
+	return CSP_TASK_RETURN;
+
 }
 
-int csp_route_start_task(unsigned int task_stack_size, unsigned int priority) {
+int csp_route_start_workers(unsigned int workers, unsigned int task_stack_size, unsigned int priority) {
 
-	static csp_thread_handle_t handle_router;
-	int ret = csp_thread_create(csp_task_router, "RTE", task_stack_size, NULL, priority, &handle_router);
+	static csp_thread_handle_t handle_router[CSP_ROUTE_WORKERS];
+	static char name[CSP_ROUTE_WORKERS][16];
+	unsigned int worker;
 
-	if (ret != 0) {
-		csp_log_error("Failed to start router task");
-		return CSP_ERR_NOMEM;
+	if ((workers == 0) || (workers > CSP_ROUTE_WORKERS)) {
+		csp_log_error("Invalid number of router workers %u, max %u", workers, CSP_ROUTE_WORKERS);
+		return CSP_ERR_INVAL;
 	}
 
-	return CSP_ERR_NONE;
+	for (worker = 0; worker < workers; worker++) {
+		if (workers == 1)
+			snprintf(name[worker], sizeof(name[worker]), "RTE");
+		else
+			snprintf(name[worker], sizeof(name[worker]), "RTE%u", worker);
+		int ret = csp_thread_create(csp_task_router, name[worker], task_stack_size,
+				(void *) (uintptr_t) worker, priority, &handle_router[worker]);
+		if (ret != 0) {
+			csp_log_error("Failed to start router task");
+			break;
+		}
+	}
+
+	/* Only shard packets over the workers that are running. Until now, packets
+	 * have gone to worker 0, which is started first. */
+	if (worker > 0)
+		csp_qfifo_set_workers(worker);
+
+	return (worker == workers) ? CSP_ERR_NONE : CSP_ERR_NOMEM;
+
+}
+
+int csp_route_start_task(unsigned int task_stack_size, unsigned int priority) {
+
+	return csp_route_start_workers(1, task_stack_size, priority);
 
 }
@@ -143,19 +143,22 @@ static int do_cmp_poke(struct csp_cmp_message *cmp) {
 
 static int do_cmp_clock(struct csp_cmp_message *cmp) {
 
-	cmp->clock.tv_sec = csp_ntoh32(cmp->clock.tv_sec);
-	cmp->clock.tv_nsec = csp_ntoh32(cmp->clock.tv_nsec);
+	/* The message is packed, so the clock functions get an aligned copy */
+	csp_timestamp_t clock;
 
-	if ((cmp->clock.tv_sec != 0) && (clock_set_time != NULL)) {
-		clock_set_time(&cmp->clock);
+	clock.tv_sec = csp_ntoh32(cmp->clock.tv_sec);
+	clock.tv_nsec = csp_ntoh32(cmp->clock.tv_nsec);
+
+	if ((clock.tv_sec != 0) && (clock_set_time != NULL)) {
+		clock_set_time(&clock);
 	}
 
 	if (clock_get_time != NULL) {
-		clock_get_time(&cmp->clock);
+		clock_get_time(&clock);
 	}
 
-	cmp->clock.tv_sec = csp_hton32(cmp->clock.tv_sec);
-	cmp->clock.tv_nsec = csp_hton32(cmp->clock.tv_nsec);
+	cmp->clock.tv_sec = csp_hton32(clock.tv_sec);
+	cmp->clock.tv_nsec = csp_hton32(clock.tv_nsec);
 	return CSP_ERR_NONE;
 
 }
@@ -23,8 +23,30 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <csp/csp.h>
 #include <csp/csp_endian.h>
 #include <csp/arch/csp_malloc.h>
+#include <csp/arch/csp_time.h>
 #include "csp_conn.h"
 
+/** Ranges of data the streaming receiver holds beyond the contiguous part, each hole costs one */
+#ifndef CSP_SFP_RANGES
+#define CSP_SFP_RANGES		8
+#endif
+
+/** Missing ranges reported in one status packet */
+#ifndef CSP_SFP_NACKS
+#define CSP_SFP_NACKS		4
+#endif
+
+/** Status intervals per timeout, a streaming transfer is given up after timeout ms without progress */
+#define CSP_SFP_POLLS		8
+
+/** Status packets sent when a streaming transfer completes, the sender only finishes when one arrives */
+#define CSP_SFP_FINAL_STATUS	2
+
+/** Progress in bytes between checkpoints of a resumable transfer, a stalled transfer is always saved */
+#ifndef CSP_SFP_CHECKPOINT
+#define CSP_SFP_CHECKPOINT	8192
+#endif
+
 typedef struct __attribute__((__packed__)) {
 	uint32_t offset;
 	uint32_t totalsize;
@@ -165,3 +187,522 @@ int csp_sfp_recv(csp_conn_t * conn, void ** dataout, int * datasize, uint32_t ti
 	return csp_sfp_recv_fp(conn, dataout, datasize, timeout, NULL);
 }
 
+/**
+ * Streaming SFP:
+ * Data fragments are the same as above. The receiver answers on the same
+ * connection with status packets (without CSP_FFRAG), telling the sender how
+ * much data it has received in sequence and which ranges beyond that are
+ * missing. The sender keeps at most window fragments in flight beyond the
+ * acknowledged data and resends missing ranges, so a lost fragment costs a
+ * retransmission instead of the whole transfer.
+ *
+ * A resuming sender first sends a probe, a fragment at offset totalsize
+ * holding the transfer id, and waits for the status before sending data.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t offset;
+	uint32_t size;
+} sfp_range_t;
+
+typedef struct __attribute__((__packed__)) {
+	uint32_t received;			/* All data before this offset has been received */
+	uint32_t totalsize;
+	sfp_range_t missing[CSP_SFP_NACKS];	/* Holes after received, only count entries are sent */
+} sfp_status_t;
+
+#define SFP_STATUS_SIZE(count)	(2 * sizeof(uint32_t) + (count) * sizeof(sfp_range_t))
+
+/* Ask the receiver for its state, and tell it which transfer is resumed */
+static int csp_sfp_send_probe(csp_conn_t * conn, uint32_t id, uint32_t totalsize, uint32_t timeout) {
+
+	csp_packet_t * packet = csp_buffer_get(sizeof(id) + sizeof(sfp_header_t));
+	if (packet == NULL)
+		return -1;
+
+	id = csp_hton32(id);
+	memcpy(packet->data, &id, sizeof(id));
+	packet->length = sizeof(id);
+
+	conn->idout.flags |= CSP_FFRAG;
+
+	sfp_header_t * sfp_header = csp_sfp_header_add(packet);
+	sfp_header->totalsize = csp_hton32(totalsize);
+	sfp_header->offset = csp_hton32(totalsize);
+
+	if (!csp_send(conn, packet, timeout)) {
+		csp_buffer_free(packet);
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/* Send one fragment of the data at offset */
+static int csp_sfp_send_fragment(csp_conn_t * conn, void * data, uint32_t offset, uint32_t totalsize, int mtu,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t)) {
+
+	csp_packet_t * packet = csp_buffer_get(mtu + sizeof(sfp_header_t));
+	if (packet == NULL)
+		return -1;
+
+	uint32_t size = totalsize - offset;
+	if (size > (uint32_t) mtu)
+		size = mtu;
+
+	(*memcpyfcn)(packet->data, (uint8_t *) data + offset, size);
+	packet->length = size;
+
+	conn->idout.flags |= CSP_FFRAG;
+
+	sfp_header_t * sfp_header = csp_sfp_header_add(packet);
+	sfp_header->totalsize = csp_hton32(totalsize);
+	sfp_header->offset = csp_hton32(offset);
+
+	if (!csp_send(conn, packet, timeout)) {
+		csp_buffer_free(packet);
+		return -1;
+	}
+
+	return size;
+
+}
+
+/* Send a streaming transfer, when resuming the receiver is asked what it already has of transfer id */
+static int csp_sfp_send_stream(csp_conn_t * conn, void * data, uint32_t totalsize, int mtu, unsigned int window,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t), int resume, uint32_t id) {
+
+	uint32_t next = 0;		/* Next offset never sent */
+	uint32_t acked = 0;		/* Offset the receiver has all data before */
+	uint32_t resend_mark = 0;	/* Holes before this have been resent recently */
+	uint32_t resend_time = 0;
+	uint32_t holdoff = timeout / CSP_SFP_POLLS + 1;
+	uint32_t progress_time = csp_get_ms();
+	csp_packet_t * packet;
+	sfp_status_t status;
+	int i, count, size;
+
+	if ((conn == NULL) || (mtu <= 0) || (window == 0))
+		return -1;
+
+	if (memcpyfcn == NULL)
+		memcpyfcn = &memcpy;
+
+	/* An empty transfer is a single empty fragment */
+	if (totalsize == 0)
+		return (csp_sfp_send_fragment(conn, data, 0, 0, mtu, timeout, memcpyfcn) < 0) ? -1 : 0;
+
+	while (acked < totalsize) {
+
+		if (csp_get_ms() - progress_time >= timeout) {
+			csp_debug(CSP_WARN, "SFP transfer stalled at %u/%u", acked, totalsize);
+			return -1;
+		}
+
+		/* The probe makes the receiver report the ranges it has, nothing is sent until it answers */
+		if (resume) {
+			if (csp_sfp_send_probe(conn, id, totalsize, timeout) < 0)
+				return -1;
+		}
+
+		/* Fill the window with new fragments */
+		while (!resume && (next < totalsize) && (next - acked < window * (uint32_t) mtu)) {
+			size = csp_sfp_send_fragment(conn, data, next, totalsize, mtu, timeout, memcpyfcn);
+			if (size < 0)
+				return -1;
+			next += size;
+		}
+
+		/* Wait for the receiver status */
+		packet = csp_read(conn, holdoff);
+		if (resume && (packet == NULL))
+			continue;
+		if (packet == NULL) {
+			/* Nothing heard, the end of the window or the status may have been lost */
+			if (csp_sfp_send_fragment(conn, data, acked, totalsize, mtu, timeout, memcpyfcn) < 0)
+				return -1;
+			resend_mark = 0;
+			continue;
+		}
+
+		if ((packet->id.flags & CSP_FFRAG) || (packet->length < SFP_STATUS_SIZE(0)) ||
+				(packet->length > sizeof(status)) || ((packet->length - SFP_STATUS_SIZE(0)) % sizeof(sfp_range_t))) {
+			csp_buffer_free(packet);
+			continue;
+		}
+
+		memcpy(&status, packet->data, packet->length);
+		count = (packet->length - SFP_STATUS_SIZE(0)) / sizeof(sfp_range_t);
+		csp_buffer_free(packet);
+
+		status.received = csp_ntoh32(status.received);
+		if ((status.received > totalsize) || (csp_ntoh32(status.totalsize) != totalsize))
+			continue;
+
+		/* Continue after the data the receiver holds, the last hole reported is either the
+		 * untransferred tail or lies before data that is already there */
+		if (resume) {
+			resume = 0;
+			next = status.received;
+			if (count > 0) {
+				uint32_t offset = csp_ntoh32(status.missing[count - 1].offset);
+				uint32_t end = offset + csp_ntoh32(status.missing[count - 1].size);
+				if ((offset >= next) && (end > offset) && (end <= totalsize))
+					next = (end == totalsize) ? offset : end;
+			}
+			csp_debug(CSP_INFO, "SFP resuming at %u/%u", next, totalsize);
+		}
+
+		if ((status.received > acked) && (status.received <= next)) {
+			acked = status.received;
+			progress_time = csp_get_ms();
+		}
+
+		/* Resend each hole once per holdoff, the status repeats them until they arrive */
+		if (csp_get_ms() - resend_time >= holdoff)
+			resend_mark = 0;
+
+		for (i = 0; i < count; i++) {
+			uint32_t offset = csp_ntoh32(status.missing[i].offset);
+			uint32_t end = offset + csp_ntoh32(status.missing[i].size);
+			if (end > next)
+				end = next;
+			if ((offset < resend_mark) || (offset < acked) || (offset >= end))
+				continue;
+			while (offset < end) {
+				size = csp_sfp_send_fragment(conn, data, offset, totalsize, mtu, timeout, memcpyfcn);
+				if (size < 0)
+					return -1;
+				offset += size;
+			}
+			resend_mark = end;
+			resend_time = csp_get_ms();
+		}
+
+	}
+
+	return 0;
+
+}
+
+int csp_sfp_send_window(csp_conn_t * conn, void * data, uint32_t totalsize, int mtu, unsigned int window,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t)) {
+	return csp_sfp_send_stream(conn, data, totalsize, mtu, window, timeout, memcpyfcn, 0, 0);
+}
+
+int csp_sfp_send_resume(csp_conn_t * conn, uint32_t id, void * data, uint32_t totalsize, int mtu, unsigned int window,
+		uint32_t timeout, void * (*memcpyfcn)(void *, const void *, size_t)) {
+	return csp_sfp_send_stream(conn, data, totalsize, mtu, window, timeout, memcpyfcn, 1, id);
+}
+
+/* Receiver state of a streaming transfer */
+typedef struct {
+	uint32_t id;				/* Transfer id from the probe, valid if identified */
+	int identified;
+	uint32_t totalsize;
+	uint32_t received;			/* All data before this offset has been delivered */
+	uint32_t nack_mark;			/* Holes before this have been reported */
+	sfp_range_t range[CSP_SFP_RANGES];	/* Data delivered beyond received, sorted and disjoint */
+	int ranges;
+} sfp_rx_t;
+
+/* Receiver state as saved to a csp_sfp_store_t, in host byte order */
+typedef struct {
+	uint32_t magic;
+	uint32_t id;
+	uint32_t totalsize;
+	uint32_t received;
+	uint32_t ranges;
+	sfp_range_t range[CSP_SFP_RANGES];
+} sfp_checkpoint_t;
+
+#define SFP_CHECKPOINT_MAGIC	0x53465002
+
+static void csp_sfp_checkpoint_save(const csp_sfp_store_t * store, sfp_rx_t * rx) {
+
+	sfp_checkpoint_t checkpoint;
+
+	memset(&checkpoint, 0, sizeof(checkpoint));
+	checkpoint.magic = SFP_CHECKPOINT_MAGIC;
+	checkpoint.id = rx->id;
+	checkpoint.totalsize = rx->totalsize;
+	checkpoint.received = rx->received;
+	checkpoint.ranges = rx->ranges;
+	memcpy(checkpoint.range, rx->range, rx->ranges * sizeof(sfp_range_t));
+
+	if (store->save(store->arg, &checkpoint, sizeof(checkpoint)) != 0)
+		csp_debug(CSP_WARN, "SFP checkpoint at %u not saved", rx->received);
+
+}
+
+static int csp_sfp_checkpoint_load(const csp_sfp_store_t * store, sfp_rx_t * rx) {
+
+	sfp_checkpoint_t checkpoint;
+
+	if (store->load(store->arg, &checkpoint, sizeof(checkpoint)) != 0)
+		return 0;
+
+	if ((checkpoint.magic != SFP_CHECKPOINT_MAGIC) || (checkpoint.received > checkpoint.totalsize) ||
+			(checkpoint.totalsize == UINT32_MAX) || (checkpoint.ranges > CSP_SFP_RANGES))
+		return 0;
+
+	rx->id = checkpoint.id;
+	rx->identified = 1;
+	rx->totalsize = checkpoint.totalsize;
+	rx->received = checkpoint.received;
+	rx->ranges = checkpoint.ranges;
+	memcpy(rx->range, checkpoint.range, rx->ranges * sizeof(sfp_range_t));
+	rx->nack_mark = rx->ranges ? rx->range[rx->ranges - 1].offset + rx->range[rx->ranges - 1].size : rx->received;
+
+	return 1;
+
+}
+
+/* Report the receiver state, with tail set the data after the last range is reported missing too */
+static void csp_sfp_send_status(csp_conn_t * conn, sfp_rx_t * rx, int tail, uint32_t timeout) {
+
+	sfp_status_t status;
+	uint32_t offset = rx->received;
+	int i, count = 0;
+
+	status.received = csp_hton32(rx->received);
+	status.totalsize = csp_hton32(rx->totalsize);
+
+	/* Report the holes in front of each range */
+	for (i = 0; (i < rx->ranges) && (count < CSP_SFP_NACKS); i++) {
+		status.missing[count].offset = csp_hton32(offset);
+		status.missing[count].size = csp_hton32(rx->range[i].offset - offset);
+		offset = rx->range[i].offset + rx->range[i].size;
+		count++;
+	}
+	if (tail && (count < CSP_SFP_NACKS) && (offset < rx->totalsize)) {
+		status.missing[count].offset = csp_hton32(offset);
+		status.missing[count].size = csp_hton32(rx->totalsize - offset);
+		count++;
+	}
+	if (offset > rx->nack_mark)
+		rx->nack_mark = offset;
+
+	csp_packet_t * packet = csp_buffer_get(sizeof(status));
+	if (packet == NULL)
+		return;
+
+	memcpy(packet->data, &status, SFP_STATUS_SIZE(count));
+	packet->length = SFP_STATUS_SIZE(count);
+
+	conn->idout.flags &= ~CSP_FFRAG;
+	if (!csp_send(conn, packet, timeout))
+		csp_buffer_free(packet);
+
+}
+
+/**
+ * Record a fragment in the receiver state
+ * @return 1 if the fragment is new and should be delivered, 0 if it is
+ * already delivered or there is no room to record it
+ */
+static int csp_sfp_rx_add(sfp_rx_t * rx, uint32_t offset, uint32_t size) {
+
+	uint32_t end = offset + size;
+	int i, j;
+
+	if (end <= rx->received)
+		return 0;
+
+	/* Find the first range ending at or after the fragment */
+	for (i = 0; (i < rx->ranges) && (rx->range[i].offset + rx->range[i].size < offset); i++);
+
+	if ((i < rx->ranges) && (rx->range[i].offset <= offset) && (rx->range[i].offset + rx->range[i].size >= end))
+		return 0;
+
+	/* Fragments are resent with the same boundaries, so a partial overlap is only extended */
+	if ((i < rx->ranges) && (rx->range[i].offset <= end)) {
+		if (offset < rx->range[i].offset) {
+			rx->range[i].size += rx->range[i].offset - offset;
+			rx->range[i].offset = offset;
+		}
+		if (end > rx->range[i].offset + rx->range[i].size)
+			rx->range[i].size = end - rx->range[i].offset;
+	} else {
+		if (rx->ranges >= CSP_SFP_RANGES)
+			return 0;
+		for (j = rx->ranges; j > i; j--)
+			rx->range[j] = rx->range[j - 1];
+		rx->range[i].offset = offset;
+		rx->range[i].size = size;
+		rx->ranges++;
+	}
+
+	/* Merge with the next range */
+	if ((i + 1 < rx->ranges) && (rx->range[i].offset + rx->range[i].size >= rx->range[i + 1].offset)) {
+		end = rx->range[i + 1].offset + rx->range[i + 1].size;
+		if (end > rx->range[i].offset + rx->range[i].size)
+			rx->range[i].size = end - rx->range[i].offset;
+		rx->ranges--;
+		for (j = i + 1; j < rx->ranges; j++)
+			rx->range[j] = rx->range[j + 1];
+	}
+
+	/* Advance the in-sequence part */
+	if ((rx->ranges > 0) && (rx->range[0].offset <= rx->received)) {
+		rx->received = rx->range[0].offset + rx->range[0].size;
+		rx->ranges--;
+		for (j = 0; j < rx->ranges; j++)
+			rx->range[j] = rx->range[j + 1];
+	}
+
+	return 1;
+
+}
+
+/* Receive a streaming transfer, continuing from and saving checkpoints when store is set */
+static int csp_sfp_recv_state(csp_conn_t * conn, csp_sfp_deliver_t deliver, void * arg, unsigned int window,
+		uint32_t timeout, const csp_sfp_store_t * store) {
+
+	sfp_rx_t rx;
+	csp_packet_t * packet;
+	uint32_t holdoff = timeout / CSP_SFP_POLLS + 1;
+	uint32_t progress_time = csp_get_ms();
+	uint32_t saved = 0;
+	unsigned int unacked = 0;
+	uint32_t offset, totalsize, received, id = 0;
+	int i, ranges, probe, restored = 0;
+
+	if ((conn == NULL) || (deliver == NULL))
+		return -1;
+
+	memset(&rx, 0, sizeof(rx));
+	rx.totalsize = UINT32_MAX;
+
+	if (store != NULL) {
+		restored = csp_sfp_checkpoint_load(store, &rx);
+		if (restored) {
+			saved = rx.received;
+			csp_debug(CSP_INFO, "SFP checkpoint at %u/%u", rx.received, rx.totalsize);
+		}
+	}
+
+	/* A restored transfer is only finished once the sender has confirmed it is the same */
+	while (restored || (rx.received < rx.totalsize)) {
+
+		if (csp_get_ms() - progress_time >= timeout) {
+			csp_debug(CSP_WARN, "SFP transfer stalled at %u", rx.received);
+			if ((store != NULL) && !restored && rx.identified)
+				csp_sfp_checkpoint_save(store, &rx);
+			return -1;
+		}
+
+		packet = csp_read(conn, holdoff);
+		if (packet == NULL) {
+			/* Nothing is in flight, ask again for whatever is missing */
+			if (rx.totalsize != UINT32_MAX)
+				csp_sfp_send_status(conn, &rx, 1, timeout);
+			continue;
+		}
+
+		if (((packet->id.flags & CSP_FFRAG) == 0) || (packet->length < sizeof(sfp_header_t))) {
+			csp_debug(CSP_ERROR, "Missing SFP header");
+			csp_buffer_free(packet);
+			continue;
+		}
+
+		sfp_header_t * sfp_header = csp_sfp_header_remove(packet);
+		offset = csp_ntoh32(sfp_header->offset);
+		totalsize = csp_ntoh32(sfp_header->totalsize);
+		probe = (offset == totalsize) && (totalsize > 0) && (packet->length == sizeof(id));
+		if (probe) {
+			memcpy(&id, packet->data, sizeof(id));
+			id = csp_ntoh32(id);
+		}
+
+		/* The checkpoint is of another transfer, or the sender is not resuming it */
+		if (restored && (!probe || (id != rx.id) || (totalsize != rx.totalsize))) {
+			csp_debug(CSP_WARN, "SFP checkpoint of transfer %u discarded", rx.id);
+			memset(&rx, 0, sizeof(rx));
+			rx.totalsize = UINT32_MAX;
+			saved = 0;
+		}
+		restored = 0;
+
+		if (rx.totalsize == UINT32_MAX) {
+			rx.totalsize = totalsize;
+			rx.id = id;
+			rx.identified = probe;
+		}
+
+		/* A probe asks for the ranges held, answer with the tail to resume a transfer */
+		if (probe) {
+			csp_buffer_free(packet);
+			if ((totalsize != rx.totalsize) || (rx.identified && (id != rx.id))) {
+				csp_debug(CSP_ERROR, "SFP probe of transfer %u during transfer %u", id, rx.id);
+				continue;
+			}
+			csp_sfp_send_status(conn, &rx, 1, timeout);
+			continue;
+		}
+
+		if ((totalsize != rx.totalsize) || (offset + packet->length > totalsize) || (offset + packet->length < offset)) {
+			csp_debug(CSP_ERROR, "SFP fragment %u+%u does not fit %u", offset, packet->length, rx.totalsize);
+			csp_buffer_free(packet);
+			continue;
+		}
+
+		if ((packet->length == 0) && (totalsize > 0)) {
+			csp_buffer_free(packet);
+			continue;
+		}
+
+		/* Deliver straight from the packet buffer */
+		ranges = rx.ranges;
+		received = rx.received;
+		if (csp_sfp_rx_add(&rx, offset, packet->length)) {
+			progress_time = csp_get_ms();
+			if (deliver(arg, offset, packet->data, packet->length, totalsize) != 0) {
+				csp_buffer_free(packet);
+				return -1;
+			}
+		}
+		csp_buffer_free(packet);
+
+		/* Report a new or filled hole at once, and progress every half window */
+		if (((rx.ranges > 0) && (rx.range[rx.ranges - 1].offset >= rx.nack_mark)) ||
+				((ranges > 0) && ((rx.ranges < ranges) || (rx.received != received))) ||
+				(++unacked >= (window + 1) / 2)) {
+			csp_sfp_send_status(conn, &rx, 0, timeout);
+			unacked = 0;
+		}
+
+		/* Data is saved by deliver before it is recorded in a checkpoint. Only
+		 * a transfer with an id can be resumed. */
+		if ((store != NULL) && rx.identified && (rx.received - saved >= CSP_SFP_CHECKPOINT)) {
+			csp_sfp_checkpoint_save(store, &rx);
+			saved = rx.received;
+		}
+
+	}
+
+	/* Tell the sender it is done, more than once as a status may be lost */
+	if (rx.totalsize > 0)
+		for (i = 0; i < CSP_SFP_FINAL_STATUS; i++)
+			csp_sfp_send_status(conn, &rx, 0, timeout);
+
+	/* Nothing to resume, a checkpoint left behind would make the sender skip data next time */
+	if ((store != NULL) && (store->save(store->arg, NULL, 0) != 0)) {
+		csp_debug(CSP_ERROR, "SFP checkpoint not erased");
+		return -1;
+	}
+
+	return 0;
+
+}
+
+int csp_sfp_recv_stream(csp_conn_t * conn, csp_sfp_deliver_t deliver, void * arg, unsigned int window, uint32_t timeout) {
+	return csp_sfp_recv_state(conn, deliver, arg, window, timeout, NULL);
+}
+
+int csp_sfp_recv_resume(csp_conn_t * conn, csp_sfp_deliver_t deliver, void * arg, unsigned int window, uint32_t timeout,
+		const csp_sfp_store_t * store) {
+	if (store == NULL)
+		return -1;
+	return csp_sfp_recv_state(conn, deliver, arg, window, timeout, store);
+}
@@ -19,81 +19,354 @@
 #include "os_semphr.h"
 #include "os_task.h"
 
-#include "can.h"
+#include "HL_can.h"
+#include "HL_sys_vim.h"
 #include <csp/csp.h>
 #include <csp/interfaces/csp_if_can.h>
+#include <csp/arch/csp_semaphore.h>
 #include "csp/drivers/can.h"
 
+// CAN node used by CSP and its VIM channel for interrupt line 0
+#define CAN_NODE                canREG2
+#define CAN_VIM_CHANNEL         35U
+
+// Message objects 1-8 form the TX bank. The DCAN sends pending objects
+// lowest number first, so frames are written to the bank in ascending order
+// and the bank has to drain before it is reused from object 1.
+#define CAN_TX_MBOX_FIRST       1U
+#define CAN_TX_MBOX_COUNT       8U
+#define CAN_TX_MBOX_LAST        (CAN_TX_MBOX_FIRST + CAN_TX_MBOX_COUNT - 1U)
+#define CAN_TX_MBOX_MASK        (((1U << CAN_TX_MBOX_COUNT) - 1U) << (CAN_TX_MBOX_FIRST - 1U))
+
+// Time to wait for the bank to drain before giving up, e.g. when bus off
+#define CAN_TX_TIMEOUT_MS       100U
+
+// Message objects 9-40 receive from one CFP source address each, object
+// 9 + n accepting source n. They have EoB clear, so a frame arriving while
+// the object still holds unread data continues to the RX FIFO.
+#define CAN_RX_SRC_FIRST        9U
+#define CAN_RX_SRC_LAST         (CAN_RX_SRC_FIRST + (1U << CFP_HOST_SIZE) - 1U)
+
+// Message objects 41-64 form the RX FIFO. The DCAN stores a frame in the
+// lowest numbered object of the FIFO that has no new data, the last object
+// has EoB set.
+#define CAN_RX_FIFO_FIRST       41U
+#define CAN_RX_FIFO_LAST        64U
+
+// Received objects are read without clearing NewDat and stay held until no
+// interrupt is pending. A freed object would take the next frame at once,
+// and a source object or a low FIFO object refilled that way is read before
+// older frames still waiting higher up in the FIFO.
+#define CAN_MBOX_REG(box)       (((box) - 1U) >> 5U)
+#define CAN_MBOX_BIT(box)       (1U << (((box) - 1U) & 0x1FU))
+#define CAN_RX_FIFO_REG         CAN_MBOX_REG(CAN_RX_FIFO_FIRST)
+#define CAN_RX_FIFO_MASK        (~(CAN_MBOX_BIT(CAN_RX_FIFO_FIRST) - 1U))
+
+// IFx command bits
+#define CAN_IFCMD_WR            0x80U
+#define CAN_IFCMD_MASK          0x40U
+#define CAN_IFCMD_ARB           0x20U
+#define CAN_IFCMD_CONTROL       0x10U
+#define CAN_IFCMD_CLRINTPND     0x08U
+#define CAN_IFCMD_NEWDAT        0x04U
+#define CAN_IFCMD_DATAA         0x02U
+#define CAN_IFCMD_DATAB         0x01U
+
+// IFx arbitration, mask and message control bits
+#define CAN_IFARB_MSGVAL        0x80000000U
+#define CAN_IFARB_XTD           0x40000000U
+#define CAN_IFARB_DIR           0x20000000U
+#define CAN_IFMSK_MXTD          0x80000000U
+#define CAN_IFMSK_MDIR          0x40000000U
+#define CAN_IFMCTL_NEWDAT       0x00008000U
+#define CAN_IFMCTL_UMASK        0x00001000U
+#define CAN_IFMCTL_TXIE         0x00000800U
+#define CAN_IFMCTL_RXIE         0x00000400U
+#define CAN_IFMCTL_EOB          0x00000080U
+#define CAN_IFMCTL_DLC          0x0000000FU
+#define CAN_ID_MASK             0x1FFFFFFFU
+
+#define CAN_IFSTAT_BUSY         0x80U
+
+// Writing the message number starts the IFx transfer, the register
+// simulator of the host tests replaces these
+#ifndef CAN_IF1_START
+#define CAN_IF1_START(node, box)    ((node)->IF1NO = (uint8) (box))
+#define CAN_IF2_START(node, box)    ((node)->IF2NO = (uint8) (box))
+#endif
+#define CAN_INT_STATUS          0x8000U
+
+#if ((__little_endian__ == 1) || (__LITTLE_ENDIAN__ == 1))
+#define CAN_DATA_INDEX(i)       (i)
+#else
+static const uint8_t can_byte_order[8] = {3U, 2U, 1U, 0U, 7U, 6U, 5U, 4U};
+#define CAN_DATA_INDEX(i)       (can_byte_order[i])
+#endif
+
 // the following function definitions are as defined by CSP. This file converts their functionality
 // to that defined by CSP
 int can_send(can_id_t id, uint8_t * data, uint8_t dlc); // The CSP definition of sending a CAN frame
 int can_init(uint32_t id, uint32_t mask, struct csp_can_config *conf);
-// This sends data byte by byte, dlc should always be 8
 
+// Posted from the interrupt handler when the TX bank has drained
+static csp_bin_sem_handle_t can_tx_sem;
+
+// Next object of the TX bank to fill, relative to CAN_TX_MBOX_FIRST
+static uint32 can_tx_next;
+
+static uint32 can_tx_pending(void)
+{
+    return CAN_NODE->TXRQx[0] & CAN_TX_MBOX_MASK;
+}
+
+static int can_tx_wait_idle(void)
+{
+    while (can_tx_pending() != 0U) {
+        if (csp_bin_sem_wait(&can_tx_sem, CAN_TX_TIMEOUT_MS) != CSP_SEMAPHORE_OK) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Called by csp_can_tx with the frames of one packet in order. Frames are
+// queued in the TX bank without waiting for the bus, the caller only blocks
+// when the bank is full.
 int can_send(can_id_t id, uint8_t* data, uint8_t dlc) {
-    // populate data values in message box 1, on can register 1
-    // TODO: make a switch case for different message boxes for different dlc values...
-    //canUpdateID(canREG2, canMESSAGE_BOX1, id);
-    canTransmit(canREG2, canMESSAGE_BOX2, data); // send the data?
+    uint32 box;
+    uint32 i;
+
+    if (can_tx_next == CAN_TX_MBOX_COUNT) {
+        if (can_tx_wait_idle() != 0) {
+            return -1;
+        }
+        can_tx_next = 0U;
+    }
+
+    box = CAN_TX_MBOX_FIRST + can_tx_next;
+    if ((canIsTxMessagePending(CAN_NODE, box) != 0U) && (can_tx_wait_idle() != 0)) {
+        return -1;
+    }
+
+    while ((CAN_NODE->IF1STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+    if (dlc > 8U) {
+        dlc = 8U;
+    }
+
+    // Only dlc bytes go on the wire, the short last fragment of a packet
+    // does not pay for a full frame
+    CAN_NODE->IF1ARB = CAN_IFARB_MSGVAL | CAN_IFARB_XTD | CAN_IFARB_DIR | (id & CAN_ID_MASK);
+    CAN_NODE->IF1MCTL = CAN_IFMCTL_NEWDAT | CAN_IFMCTL_TXIE | CAN_IFMCTL_EOB | dlc;
+    for (i = 0U; i < dlc; i++) {
+        CAN_NODE->IF1DATx[CAN_DATA_INDEX(i)] = data[i];
+    }
+    CAN_NODE->IF1CMD = (uint8) (CAN_IFCMD_WR | CAN_IFCMD_ARB | CAN_IFCMD_CONTROL | CAN_IFCMD_NEWDAT |
+                                CAN_IFCMD_DATAA | CAN_IFCMD_DATAB);
+    CAN_IF1_START(CAN_NODE, box);
+
+    can_tx_next++;
+
     return 0;
 }
 
+// IF1 belongs to task context (can_send), IF2 to the interrupt handler.
+// Configuration through IF1 must therefore happen before the interrupt is enabled.
+static void can_config_mbox(canBASE_t *node, uint32 messageBox, uint32 arb, uint32 msk, uint32 mctl)
+{
+    while ((node->IF1STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+    node->IF1MSK = msk;
+    node->IF1ARB = arb;
+    node->IF1MCTL = mctl;
+    node->IF1CMD = (uint8) (CAN_IFCMD_WR | CAN_IFCMD_MASK | CAN_IFCMD_ARB | CAN_IFCMD_CONTROL | CAN_IFCMD_CLRINTPND);
+    CAN_IF1_START(node, messageBox);
+    while ((node->IF1STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+}
 
-static void can_rx_thread(void * parameters)
+// Read one message object through IF2, clearing IntPnd in the same
+// transfer. NewDat stays set, see can_release_held.
+static void can_read_mbox(canBASE_t *node, uint32 messageBox, can_frame_t *frame)
+{
+    uint32 i;
+
+    while ((node->IF2STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+    node->IF2CMD = (uint8) (CAN_IFCMD_ARB | CAN_IFCMD_CONTROL | CAN_IFCMD_CLRINTPND |
+                            CAN_IFCMD_DATAA | CAN_IFCMD_DATAB);
+    CAN_IF2_START(node, messageBox);
+    while ((node->IF2STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+
+    frame->id = (can_id_t) (node->IF2ARB & CAN_ID_MASK);
+    frame->dlc = (uint8_t) (node->IF2MCTL & CAN_IFMCTL_DLC);
+    if (frame->dlc > 8U) {
+        frame->dlc = 8U;
+    }
+    for (i = 0U; i < frame->dlc; i++) {
+        frame->data[i] = node->IF2DATx[CAN_DATA_INDEX(i)];
+    }
+}
+
+static void can_clear_mbox(canBASE_t *node, uint32 messageBox, uint32 cmd)
+{
+    while ((node->IF2STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+    node->IF2CMD = (uint8) cmd;
+    CAN_IF2_START(node, messageBox);
+    while ((node->IF2STAT & CAN_IFSTAT_BUSY) == CAN_IFSTAT_BUSY) {
+    }
+}
+
+static CSP_BASE_TYPE can_task_woken;
+
+// Objects read but not released, laid out like NWDATx
+static uint32 can_rx_held[2];
+
+static void can_read_held(canBASE_t *node, uint32 messageBox)
 {
     can_frame_t frame;
-    int nbytes;
-    // recieve on canREG1, box 2
-    // TODO: check which message box it's arriving on and
-    // change dlc field depending on that.
-    while (1) {
 
-        while(!canIsRxMessageArrived(canREG2, canMESSAGE_BOX1)){
-            vTaskDelay(10);
+    can_read_mbox(node, messageBox, &frame);
+    can_rx_held[CAN_MBOX_REG(messageBox)] |= CAN_MBOX_BIT(messageBox);
+    csp_can_rx_frame(&frame, &can_task_woken);
+}
+
+static void can_release_mbox(canBASE_t *node, uint32 messageBox)
+{
+    can_rx_held[CAN_MBOX_REG(messageBox)] &= ~CAN_MBOX_BIT(messageBox);
+    can_clear_mbox(node, messageBox, CAN_IFCMD_NEWDAT);
+}
+
+// Called when no interrupt is pending. The FIFO is released first, lowest
+// object first, so frames arriving meanwhile still fill it in order. Frames
+// that reach the FIFO before a source object is released are older than
+// anything that object receives afterwards, so they are read right away.
+static void can_release_held(canBASE_t *node)
+{
+    uint32 pending;
+    uint32 box;
+    uint32 fifo;
+
+    for (box = CAN_RX_FIFO_FIRST; box <= CAN_RX_FIFO_LAST; box++) {
+        if ((can_rx_held[CAN_MBOX_REG(box)] & CAN_MBOX_BIT(box)) != 0U) {
+            can_release_mbox(node, box);
         }
-        /* Read CAN frame */
-        //uint8_t * rx_data = (uint8_t *)pvPortMalloc(8*sizeof(uint8_t));
-        uint8_t rx_data[8] = {0};
-        canGetData(canREG2, canMESSAGE_BOX1, rx_data);
-        frame.data32[0] = (uint32_t) (rx_data);
-        frame.data32[1] = (uint32_t) (rx_data + sizeof(uint32_t));
-        frame.id = (can_id_t) canGetID(canREG2, canMESSAGE_BOX1);
-        frame.dlc = 8; // TODO make this not a magic number
-//        if (nbytes < 0) {
-//            csp_log_error("read: %s", strerror(errno));
-//            continue;
-//        }
-//
-//        if (nbytes != sizeof(frame)) {
-//            csp_log_warn("Read incomplete CAN frame");
-//            continue;
-//        }
-//
-//        /* Frame type */
-//        if (frame.can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG) || !(frame.can_id & CAN_EFF_FLAG)) {
-//            /* Drop error and remote frames */
-//            csp_log_warn("Discarding ERR/RTR/SFF frame");
-//            continue;
-//        }
-
-//        /* Strip flags */
-        //frame.id &= CAN_EFF_MASK;
-//
-//        /* Call RX callback */
-        csp_can_rx_frame((can_frame_t *)&frame, NULL);
     }
 
-    return 0;
+    for (box = CAN_RX_SRC_FIRST; box <= CAN_RX_SRC_LAST; box++) {
+        if ((can_rx_held[CAN_MBOX_REG(box)] & CAN_MBOX_BIT(box)) == 0U) {
+            continue;
+        }
+        can_release_mbox(node, box);
+
+        pending = node->NWDATx[CAN_RX_FIFO_REG] & CAN_RX_FIFO_MASK & ~can_rx_held[CAN_RX_FIFO_REG];
+        for (fifo = CAN_RX_FIFO_FIRST; pending != 0U; fifo++) {
+            if ((pending & CAN_MBOX_BIT(fifo)) != 0U) {
+                pending &= ~CAN_MBOX_BIT(fifo);
+                can_read_held(node, fifo);
+            }
+        }
+    }
+}
+
+// Overrides the weak HALCoGen definition in HL_notification.c. Called with
+// interrupts disabled from can_interrupt for every message object with a
+// pending interrupt.
+void canMessageNotification(canBASE_t *node, uint32 messageBox)
+{
+    if (messageBox <= CAN_TX_MBOX_LAST) {
+        can_clear_mbox(node, messageBox, CAN_IFCMD_CLRINTPND);
+        if (can_tx_pending() == 0U) {
+            csp_bin_sem_post_isr(&can_tx_sem, &can_task_woken);
+        }
+        return;
+    }
+
+    if ((messageBox < CAN_RX_SRC_FIRST) || (messageBox > CAN_RX_FIFO_LAST)) {
+        can_clear_mbox(node, messageBox, CAN_IFCMD_CLRINTPND);
+        return;
+    }
+
+    can_read_held(node, messageBox);
 }
 
+// Interrupt line 0 handler. Drains every pending message object before
+// returning, lowest message number (oldest FIFO entry) first, and releases
+// the objects it read once no interrupt is pending.
+#pragma CODE_STATE(can_interrupt, 32)
+#pragma INTERRUPT(can_interrupt, IRQ)
+static void can_interrupt(void)
+{
+    uint32 value;
+
+    can_task_woken = pdFALSE;
+
+    while (1) {
+        value = CAN_NODE->INT & 0xFFFFU;
+        if (value == 0U) {
+            if ((can_rx_held[0] | can_rx_held[1]) == 0U) {
+                break;
+            }
+            can_release_held(CAN_NODE);
+            continue;
+        }
+        if (value == CAN_INT_STATUS) {
+            // reading ES clears the status interrupt
+            (void) CAN_NODE->ES;
+            continue;
+        }
+        canMessageNotification(CAN_NODE, value);
+    }
+
+    portYIELD_FROM_ISR(can_task_woken);
+}
+
+// Program the acceptance filters: id and mask select the CFP destination
+// field (mask is 0 in promiscuous mode), the per-source objects additionally
+// match on the CFP source field. Frames for other nodes never reach the CPU.
 int can_init(uint32_t id, uint32_t mask, struct csp_can_config *conf) {
-    // must init the can reg.
-    // TODO: figure out how to configure halcogen CAN on the fly
+    uint32 box;
+    uint32 arb;
+    uint32 msk;
+    uint32 mctl;
+
+    if (csp_bin_sem_create(&can_tx_sem) != CSP_SEMAPHORE_OK) {
+        return -1;
+    }
+
     canInit(); // the halcogen call takes no parameters, all configurations are done in the halcogen GUI
-    xTaskHandle can_rx;
-    xTaskCreate(can_rx_thread, "RX_CAN", 1000, ( void * ) NULL, 0, &can_rx );
 
-    return 0;
-}
+    id &= mask & CAN_ID_MASK;
+    mask &= CAN_ID_MASK;
+
+    // Replace the HALCoGen message objects by the TX bank, the per-source
+    // objects and the RX FIFO
+    for (box = CAN_TX_MBOX_FIRST; box <= CAN_TX_MBOX_LAST; box++) {
+        can_config_mbox(CAN_NODE, box, CAN_IFARB_MSGVAL | CAN_IFARB_XTD | CAN_IFARB_DIR, 0U,
+                        CAN_IFMCTL_TXIE | CAN_IFMCTL_EOB | 8U);
+    }
+    can_tx_next = 0U;
+
+    for (box = CAN_RX_SRC_FIRST; box <= CAN_RX_SRC_LAST; box++) {
+        arb = CAN_IFARB_MSGVAL | CAN_IFARB_XTD | id | CFP_MAKE_SRC(box - CAN_RX_SRC_FIRST);
+        msk = CAN_IFMSK_MXTD | CAN_IFMSK_MDIR | mask | CFP_MAKE_SRC((1U << CFP_HOST_SIZE) - 1U);
+        can_config_mbox(CAN_NODE, box, arb, msk, CAN_IFMCTL_UMASK | CAN_IFMCTL_RXIE | 8U);
+    }
+    can_rx_held[0] = 0U;
+    can_rx_held[1] = 0U;
+
+    for (box = CAN_RX_FIFO_FIRST; box <= CAN_RX_FIFO_LAST; box++) {
+        mctl = CAN_IFMCTL_UMASK | CAN_IFMCTL_RXIE | 8U;
+        if (box == CAN_RX_FIFO_LAST) {
+            mctl |= CAN_IFMCTL_EOB;
+        }
+        can_config_mbox(CAN_NODE, box, CAN_IFARB_MSGVAL | CAN_IFARB_XTD | id, CAN_IFMSK_MXTD | CAN_IFMSK_MDIR | mask, mctl);
+    }
 
+    vimChannelMap(CAN_VIM_CHANNEL, CAN_VIM_CHANNEL, &can_interrupt);
+    vimEnableInterrupt(CAN_VIM_CHANNEL, SYS_IRQ);
 
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * halcogen_crc.c
+ *
+ * Hashing of CSP packets with the TMS570 CRC module.
+ *
+ * The CRC module compresses 64-bit words into a 64-bit PSA signature, the
+ * CRC-64 with polynomial x^64 + x^4 + x^3 + x + 1 of the words, most
+ * significant bit first. Areas are written to the PSA register by the CPU
+ * (full-CPU mode). With CRC_DMA_MIN_WORDS set, longer 8-byte aligned areas
+ * are transferred by a DMA control packet and the channel counts the words
+ * as one sector (semi-CPU mode). The PSA polynomial is not the Castagnoli
+ * CRC32 used by CSP_FCRC32, so csp_crc32_append and csp_crc32_verify keep
+ * using software. The hash is used for duplicate detection, which needs the
+ * same hash for the same data on every call, so when the module cannot be
+ * used the signature is calculated in software instead.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "HL_crc.h"
+#include "HL_sys_dma.h"
+#include <csp/csp.h>
+#include <csp/csp_crc32.h>
+#include <csp/arch/csp_semaphore.h>
+#include "csp/drivers/crc.h"
+
+// CRC module and channel used by CSP
+#define CRC_NODE                crcREG1
+#define CRC_CHANNEL             CRC_CH1
+#define CRC_CHANNEL_CC          CRC_CH1_CC
+#define CRC_PSA_SIGREG          (&CRC_NODE->PSA_SIGREGL1)
+
+// PSA register write, the register simulator of the host tests replaces it
+#ifndef CRC_PSA_WRITE
+#define CRC_PSA_WRITE(word)     (*(volatile uint64 *) CRC_PSA_SIGREG = (word))
+#endif
+
+// Feedback taps of the PSA polynomial
+#define CRC_PSA_POLY            0x000000000000001BULL
+
+// DMA channel for semi-CPU mode. Areas of at least CRC_DMA_MIN_WORDS words
+// use the DMA, 0 (the default) never does. Only enable it when packet
+// buffers are not in write-back cached RAM, which the DMA would read stale.
+#define CRC_DMA_CHANNEL         DMA_CH15
+#ifndef CRC_DMA_MIN_WORDS
+#define CRC_DMA_MIN_WORDS       0U
+#endif
+
+// Polls of the compression complete flag before giving up on the DMA
+#define CRC_DMA_POLL_MAX        10000U
+
+static csp_mutex_t crc_lock;
+static int crc_ready = 0;
+
+// PSA signature calculated in software, the same value as the module gives
+static uint64 crc_psa_soft(const uint8_t * data, uint32_t words)
+{
+    uint64 sig = 0U;
+    uint32_t length = words * sizeof(uint64);
+    uint32_t bit;
+
+    while (length--) {
+        sig ^= (uint64) *data++ << 56;
+        for (bit = 0U; bit < 8U; bit++) {
+            sig = (sig << 1) ^ (((sig >> 63) != 0U) ? CRC_PSA_POLY : 0U);
+        }
+    }
+
+    return sig;
+}
+
+// Write 64-bit words to the PSA register, the source may be unaligned
+static void crc_full_cpu(const uint8_t * data, uint32_t words)
+{
+    uint64 word;
+
+    while (words--) {
+        memcpy(&word, data, sizeof(word));
+        CRC_PSA_WRITE(word);
+        data += sizeof(word);
+    }
+}
+
+// Let the DMA write the words to the PSA register, data must be 8-byte aligned
+static int crc_semi_cpu(const uint8_t * data, uint32_t words)
+{
+    g_dmaCTRL ctrl;
+    uint32_t poll;
+
+    ctrl.SADD = (uint32) data;
+    ctrl.DADD = (uint32) CRC_PSA_SIGREG;
+    ctrl.CHCTRL = 0U;
+    ctrl.FRCNT = 1U;
+    ctrl.ELCNT = words;
+    ctrl.ELDOFFSET = 0U;
+    ctrl.ELSOFFSET = 0U;
+    ctrl.FRDOFFSET = 0U;
+    ctrl.FRSOFFSET = 0U;
+    ctrl.PORTASGN = PORTA_READ_PORTB_WRITE;
+    ctrl.RDSIZE = ACCESS_64_BIT;
+    ctrl.WRSIZE = ACCESS_64_BIT;
+    ctrl.TTYPE = BLOCK_TRANSFER;
+    ctrl.ADDMODERD = ADDR_INC1;
+    ctrl.ADDMODEWR = ADDR_FIXED;
+    ctrl.AUTOINIT = AUTOINIT_OFF;
+
+    dmaSetCtrlPacket(CRC_DMA_CHANNEL, ctrl);
+    dmaSetChEnable(CRC_DMA_CHANNEL, DMA_SW);
+
+    // The channel sets CC once all words of the sector are compressed
+    for (poll = 0U; poll < CRC_DMA_POLL_MAX; poll++) {
+        if (CRC_NODE->STATUS & CRC_CHANNEL_CC) {
+            CRC_NODE->STATUS = CRC_CHANNEL_CC;
+            return 0;
+        }
+    }
+
+    // Stop the channel before the CRC channel is reset, so no words arrive
+    // after the reset
+    dmaREG->SWCHENAR = (uint32) 1U << CRC_DMA_CHANNEL;
+
+    return -1;
+}
+
+int crc_init(void)
+{
+    if (csp_mutex_create(&crc_lock) != CSP_MUTEX_OK) {
+        return -1;
+    }
+
+    crc_ready = 1;
+
+    return 0;
+}
+
+uint32_t crc_hash(const uint8_t * data, uint32_t length)
+{
+    crcConfig_t config;
+    uint32_t words = length / sizeof(uint64);
+    uint32_t tail = length % sizeof(uint64);
+    uint64 sig;
+    uint32_t hash;
+
+    if (!crc_ready) {
+        sig = crc_psa_soft(data, words);
+    } else {
+        // Wait for other users, a software signature would cost more
+        csp_mutex_lock(&crc_lock, CSP_MAX_DELAY);
+
+        config.crc_channel = CRC_CHANNEL;
+        config.pcount = words;
+        config.scount = 1U;
+        config.wdg_preload = 0U;
+        config.block_preload = 0U;
+
+        if ((CRC_DMA_MIN_WORDS > 0U) && (words >= CRC_DMA_MIN_WORDS) && (((uint32) data % sizeof(uint64)) == 0U)) {
+            // crcSetConfig resets the channel, which clears the signatures
+            config.mode = CRC_SEMI_CPU;
+            crcSetConfig(CRC_NODE, &config);
+            if (crc_semi_cpu(data, words) == 0) {
+                sig = crcGetSectorSig(CRC_NODE, CRC_CHANNEL);
+            } else {
+                crcChannelReset(CRC_NODE, CRC_CHANNEL);
+                sig = crc_psa_soft(data, words);
+            }
+        } else {
+            config.mode = CRC_FULL_CPU;
+            crcSetConfig(CRC_NODE, &config);
+            crc_full_cpu(data, words);
+            sig = crcGetPSASig(CRC_NODE, CRC_CHANNEL);
+        }
+
+        csp_mutex_unlock(&crc_lock);
+    }
+
+    // Fold the signature and mix in the length, so zero bytes at the end still count
+    hash = (uint32_t) (sig >> 32) ^ (uint32_t) sig ^ length;
+
+    // The last partial word is cheaper in software than padding a copy
+    if (tail > 0U) {
+        hash ^= csp_crc32_memory(data + words * sizeof(uint64), tail);
+    }
+
+    return hash;
+}
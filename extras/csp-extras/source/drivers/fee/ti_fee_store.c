@@ -0,0 +1,96 @@
+/*
+ * ti_fee_store.c
+ *
+ * SFP checkpoint store in the TI FEE emulated EEPROM.
+ *
+ * Writes are asynchronous: the checkpoint is copied to a buffer that stays
+ * valid until the FEE job completes, and the application's task calling
+ * TI_Fee_MainFunction() moves it to flash. The store never calls
+ * TI_Fee_MainFunction() itself, FEE is not reentrant, so waiting for a job
+ * polls its status with csp_sleep_ms() and gives up after FEE_STORE_TIMEOUT.
+ * A checkpoint is skipped while a previous write is still in
+ * progress, the receiver saves again as the transfer progresses. Erasing is
+ * never skipped, a stale checkpoint would make the sender skip data the next
+ * time. The store serves one transfer at a time.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ti_fee.h"
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+#include "csp/drivers/fee.h"
+
+// Largest checkpoint, must not exceed the configured FEE block size
+#ifndef FEE_STORE_SIZE
+#define FEE_STORE_SIZE          128U
+#endif
+
+// Longest wait for the MainFunction task to complete a job, in ms
+#ifndef FEE_STORE_TIMEOUT
+#define FEE_STORE_TIMEOUT       1000U
+#endif
+
+// Status poll interval in ms, at least one tick so the MainFunction task runs
+#ifndef FEE_STORE_POLL_MS
+#define FEE_STORE_POLL_MS       10U
+#endif
+
+static uint8 fee_buffer[FEE_STORE_SIZE];
+
+static int fee_store_wait(void)
+{
+    uint32_t waited = 0;
+
+    while (TI_Fee_GetStatus(0U) != IDLE) {
+        if (waited >= FEE_STORE_TIMEOUT)
+            return -1;
+        csp_sleep_ms(FEE_STORE_POLL_MS);
+        waited += FEE_STORE_POLL_MS;
+    }
+
+    return 0;
+}
+
+int fee_store_load(void * arg, void * data, uint32_t size)
+{
+    uint16 block = (uint16) (uintptr_t) arg;
+
+    if (size > FEE_STORE_SIZE)
+        return -1;
+
+    // Wait for a write of the same block to land
+    if (fee_store_wait() != 0)
+        return -1;
+
+    if (TI_Fee_ReadSync(block, 0U, (uint8 *) data, (uint16) size) != E_OK)
+        return -1;
+
+    return 0;
+}
+
+int fee_store_save(void * arg, const void * data, uint32_t size)
+{
+    uint16 block = (uint16) (uintptr_t) arg;
+
+    if (size > FEE_STORE_SIZE)
+        return -1;
+
+    if (data == NULL) {
+        if (fee_store_wait() != 0)
+            return -1;
+        if (TI_Fee_InvalidateBlock(block) != E_OK)
+            return -1;
+        if (fee_store_wait() != 0)
+            return -1;
+        return (TI_Fee_GetJobResult(0U) == JOB_OK) ? 0 : -1;
+    }
+
+    if (TI_Fee_GetStatus(0U) != IDLE)
+        return -1;
+
+    memset(fee_buffer, 0, sizeof(fee_buffer));
+    memcpy(fee_buffer, data, size);
+
+    return (TI_Fee_WriteAsync(block, fee_buffer) == E_OK) ? 0 : -1;
+}
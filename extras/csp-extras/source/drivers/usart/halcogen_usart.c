@@ -0,0 +1,322 @@
+/*
+ * halcogen_usart.c
+ *
+ * USART driver for SCI3 or SCI4 of the TMS570, e.g. for the KISS interface.
+ *
+ * Transmit data is copied to a ring buffer which a DMA channel moves to the
+ * SCI, one byte per TX ready request, so the CPU is not involved per byte.
+ * The block transfer complete interrupt starts the next contiguous part of
+ * the ring. Received bytes are put in a ring buffer by the SCI receive
+ * interrupt, and a task passes them to the callback in chunks.
+ *
+ * sciInit() and dmaEnable() must have been called by the application, and
+ * the DMA group A block transfer complete interrupt must be enabled in the
+ * VIM. This file defines dmaGroupANotification().
+ */
+#include "FreeRTOS.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "os_task.h"
+
+#include "HL_sci.h"
+#include "HL_sys_dma.h"
+#include "HL_sys_vim.h"
+#include <csp/csp.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/arch/csp_semaphore.h>
+#include <csp/arch/csp_queue.h>
+#include "csp/drivers/usart.h"
+
+// VIM channels of the SCI level 0 interrupt and DMA request lines of the
+// SCI transmitter, see the device datasheet
+#define USART_SCI3_VIM_CHANNEL  64U
+#define USART_SCI4_VIM_CHANNEL  119U
+#define USART_SCI3_TX_DMA_REQ   DMA_REQ31
+#define USART_SCI4_TX_DMA_REQ   DMA_REQ43
+
+#define USART_DMA_CHANNEL       DMA_CH14
+
+// Ring sizes, powers of two
+#ifndef USART_TX_BUF_SIZE
+#define USART_TX_BUF_SIZE       1024U
+#endif
+#ifndef USART_RX_BUF_SIZE
+#define USART_RX_BUF_SIZE       512U
+#endif
+
+#define USART_GETC_QUEUE_LENGTH 64U
+#define USART_RX_TASK_STACK     256U
+#define USART_RX_TASK_PRIO      2U
+
+// Time to wait for room in the TX ring, e.g. when the line is stuck
+#define USART_TX_TIMEOUT_MS     1000U
+
+// SCI SETINT bits
+#define SCI_SET_TX_DMA          0x00010000U
+
+// The SCI is accessed a byte at a time in the low byte of TD
+#if ((__little_endian__ == 1) || (__LITTLE_ENDIAN__ == 1))
+#define USART_TD_ADDR(sci)      ((uint32) &(sci)->TD)
+#else
+#define USART_TD_ADDR(sci)      ((uint32) &(sci)->TD + 3U)
+#endif
+
+static sciBASE_t * usart_sci;
+
+static uint8 usart_tx_buf[USART_TX_BUF_SIZE];
+static volatile uint32 usart_tx_head;       // written by tasks
+static volatile uint32 usart_tx_tail;       // advanced when a DMA block completes
+static volatile uint32 usart_tx_dma;        // bytes in the running DMA block, 0 when idle
+static csp_mutex_t usart_tx_lock;
+static csp_bin_sem_handle_t usart_tx_sem;   // posted when a DMA block completes
+CSP_DEFINE_CRITICAL(usart_tx_critical);
+
+static uint8 usart_rx_buf[USART_RX_BUF_SIZE];
+static volatile uint32 usart_rx_head;       // written by the interrupt
+static volatile uint32 usart_rx_tail;       // read by the RX task
+static csp_bin_sem_handle_t usart_rx_sem;
+static uint32 usart_rx_overrun;
+
+static usart_callback_t usart_callback;
+static csp_queue_handle_t usart_getc_queue;
+
+// Start a DMA block of the contiguous data at the tail of the TX ring.
+// Called with the DMA idle, from a critical section or the DMA interrupt.
+static void usart_tx_start(void)
+{
+    g_dmaCTRL ctrl;
+    uint32 tail = usart_tx_tail & (USART_TX_BUF_SIZE - 1U);
+    uint32 count = usart_tx_head - usart_tx_tail;
+
+    if (count == 0U) {
+        return;
+    }
+    if (count > USART_TX_BUF_SIZE - tail) {
+        count = USART_TX_BUF_SIZE - tail;
+    }
+
+    // One element per TX ready request
+    ctrl.SADD = (uint32) &usart_tx_buf[tail];
+    ctrl.DADD = USART_TD_ADDR(usart_sci);
+    ctrl.CHCTRL = 0U;
+    ctrl.FRCNT = count;
+    ctrl.ELCNT = 1U;
+    ctrl.ELDOFFSET = 0U;
+    ctrl.ELSOFFSET = 0U;
+    ctrl.FRDOFFSET = 0U;
+    ctrl.FRSOFFSET = 0U;
+    ctrl.PORTASGN = PORTA_READ_PORTB_WRITE;
+    ctrl.RDSIZE = ACCESS_8_BIT;
+    ctrl.WRSIZE = ACCESS_8_BIT;
+    ctrl.TTYPE = FRAME_TRANSFER;
+    ctrl.ADDMODERD = ADDR_INC1;
+    ctrl.ADDMODEWR = ADDR_FIXED;
+    ctrl.AUTOINIT = AUTOINIT_OFF;
+
+    usart_tx_dma = count;
+    dmaSetCtrlPacket(USART_DMA_CHANNEL, ctrl);
+    dmaSetChEnable(USART_DMA_CHANNEL, DMA_HW);
+}
+
+// Overrides the weak HALCoGen definition in HL_notification.c
+void dmaGroupANotification(dmaInterrupt_t inttype, uint32 channel)
+{
+    CSP_BASE_TYPE task_woken = pdFALSE;
+
+    if ((inttype != BTC) || (channel != (uint32) USART_DMA_CHANNEL)) {
+        return;
+    }
+
+    usart_tx_tail += usart_tx_dma;
+    usart_tx_dma = 0U;
+    usart_tx_start();
+
+    csp_bin_sem_post_isr(&usart_tx_sem, &task_woken);
+    portYIELD_FROM_ISR(task_woken);
+}
+
+// SCI level 0 interrupt, only receive is enabled
+#pragma CODE_STATE(usart_interrupt, 32)
+#pragma INTERRUPT(usart_interrupt, IRQ)
+static void usart_interrupt(void)
+{
+    CSP_BASE_TYPE task_woken = pdFALSE;
+    uint32 flags = usart_sci->FLR;
+
+    if (flags & ((uint32) SCI_FE_INT | (uint32) SCI_OE_INT | (uint32) SCI_PE_INT)) {
+        usart_sci->FLR = (uint32) SCI_FE_INT | (uint32) SCI_OE_INT | (uint32) SCI_PE_INT;
+        usart_rx_overrun++;
+    }
+
+    // Reading RD clears the receive flag
+    while (usart_sci->FLR & (uint32) SCI_RX_INT) {
+        uint8 c = (uint8) (usart_sci->RD & 0xFFU);
+        if (usart_rx_head - usart_rx_tail < USART_RX_BUF_SIZE) {
+            usart_rx_buf[usart_rx_head & (USART_RX_BUF_SIZE - 1U)] = c;
+            usart_rx_head++;
+        } else {
+            usart_rx_overrun++;
+        }
+    }
+
+    csp_bin_sem_post_isr(&usart_rx_sem, &task_woken);
+    portYIELD_FROM_ISR(task_woken);
+}
+
+// Pass received bytes to the callback, one contiguous part of the ring at a time
+static CSP_DEFINE_TASK(usart_rx_task)
+{
+    uint32 head;
+    uint32 tail;
+    uint32 count;
+    uint32 i;
+
+    while (1) {
+        csp_bin_sem_wait(&usart_rx_sem, CSP_MAX_DELAY);
+
+        while ((head = usart_rx_head) != usart_rx_tail) {
+            tail = usart_rx_tail & (USART_RX_BUF_SIZE - 1U);
+            count = head - usart_rx_tail;
+            if (count > USART_RX_BUF_SIZE - tail) {
+                count = USART_RX_BUF_SIZE - tail;
+            }
+            if (usart_callback != NULL) {
+                usart_callback(&usart_rx_buf[tail], (int) count, NULL);
+            } else {
+                for (i = 0U; i < count; i++) {
+                    usart_insert((char) usart_rx_buf[tail + i], NULL);
+                }
+            }
+            usart_rx_tail += count;
+        }
+    }
+
+    return CSP_TASK_RETURN;
+}
+
+void usart_init(struct usart_conf *conf)
+{
+    csp_thread_handle_t handle;
+    uint32 vim;
+
+    // device selects the SCI, "sci4" or SCI3 otherwise
+    if ((conf->device != NULL) && (strcmp(conf->device, "sci4") == 0)) {
+        usart_sci = sciREG4;
+        vim = USART_SCI4_VIM_CHANNEL;
+        dmaReqAssign(USART_DMA_CHANNEL, USART_SCI4_TX_DMA_REQ);
+    } else {
+        usart_sci = sciREG3;
+        vim = USART_SCI3_VIM_CHANNEL;
+        dmaReqAssign(USART_DMA_CHANNEL, USART_SCI3_TX_DMA_REQ);
+    }
+
+    // Frame format comes from the HALCoGen configuration
+    if (conf->baudrate != 0U) {
+        sciSetBaudrate(usart_sci, conf->baudrate);
+    }
+
+    if ((csp_mutex_create(&usart_tx_lock) != CSP_MUTEX_OK) ||
+        (csp_bin_sem_create(&usart_tx_sem) != CSP_SEMAPHORE_OK) ||
+        (csp_bin_sem_create(&usart_rx_sem) != CSP_SEMAPHORE_OK)) {
+        return;
+    }
+    usart_getc_queue = csp_queue_create(USART_GETC_QUEUE_LENGTH, sizeof(char));
+
+    usart_tx_head = 0U;
+    usart_tx_tail = 0U;
+    usart_tx_dma = 0U;
+    usart_rx_head = 0U;
+    usart_rx_tail = 0U;
+
+    csp_thread_create(usart_rx_task, "USART", USART_RX_TASK_STACK, NULL, USART_RX_TASK_PRIO, &handle);
+
+    dmaEnableInterrupt(USART_DMA_CHANNEL, BTC, DMA_INTA);
+    usart_sci->SETINT = SCI_SET_TX_DMA;
+
+    // Receive interrupt on level 0
+    usart_sci->CLEARINTLVL = (uint32) SCI_RX_INT | (uint32) SCI_FE_INT | (uint32) SCI_OE_INT | (uint32) SCI_PE_INT;
+    usart_sci->SETINT = (uint32) SCI_RX_INT;
+    vimChannelMap(vim, vim, &usart_interrupt);
+    vimEnableInterrupt(vim, SYS_IRQ);
+}
+
+void usart_set_callback(usart_callback_t callback)
+{
+    usart_callback = callback;
+}
+
+void usart_insert(char c, void *pxTaskWoken)
+{
+    if (usart_getc_queue == NULL) {
+        return;
+    }
+    if (pxTaskWoken != NULL) {
+        csp_queue_enqueue_isr(usart_getc_queue, &c, pxTaskWoken);
+    } else {
+        csp_queue_enqueue(usart_getc_queue, &c, 0);
+    }
+}
+
+void usart_putc(char c)
+{
+    usart_putstr(&c, 1);
+}
+
+// Copy to the TX ring and start the DMA if it is idle, waiting for room
+// when the ring is full
+void usart_putstr(char *buf, int len)
+{
+    uint32 head;
+    uint32 count;
+
+    if (csp_mutex_lock(&usart_tx_lock, CSP_MAX_DELAY) != CSP_MUTEX_OK) {
+        return;
+    }
+
+    while (len > 0) {
+        count = USART_TX_BUF_SIZE - (usart_tx_head - usart_tx_tail);
+        if (count == 0U) {
+            if (csp_bin_sem_wait(&usart_tx_sem, USART_TX_TIMEOUT_MS) != CSP_SEMAPHORE_OK) {
+                break;
+            }
+            continue;
+        }
+
+        head = usart_tx_head & (USART_TX_BUF_SIZE - 1U);
+        if (count > USART_TX_BUF_SIZE - head) {
+            count = USART_TX_BUF_SIZE - head;
+        }
+        if (count > (uint32) len) {
+            count = (uint32) len;
+        }
+        memcpy(&usart_tx_buf[head], buf, count);
+        buf += count;
+        len -= (int) count;
+
+        CSP_ENTER_CRITICAL(usart_tx_critical);
+        usart_tx_head += count;
+        if (usart_tx_dma == 0U) {
+            usart_tx_start();
+        }
+        CSP_EXIT_CRITICAL(usart_tx_critical);
+    }
+
+    csp_mutex_unlock(&usart_tx_lock);
+}
+
+char usart_getc(void)
+{
+    char c = 0;
+
+    if (usart_getc_queue != NULL) {
+        csp_queue_dequeue(usart_getc_queue, &c, CSP_MAX_DELAY);
+    }
+
+    return c;
+}
+
+int usart_messages_waiting(int handle)
+{
+    return (usart_getc_queue != NULL) ? csp_queue_size(usart_getc_queue) : 0;
+}
@@ -0,0 +1,180 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* USART driver for a Linux serial device or pty, one device per process */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <csp/csp.h>
+#include <csp/arch/csp_queue.h>
+#include <csp/drivers/usart.h>
+
+/* Bytes read from the device at a time */
+#define USART_RX_CHUNK		256
+
+/* Characters kept for usart_getc */
+#define USART_GETC_QUEUE_LENGTH	256
+
+static int fd = -1;
+static usart_callback_t usart_callback = NULL;
+static csp_queue_handle_t usart_getc_queue = NULL;
+static pthread_t usart_rx_thread;
+
+static speed_t usart_speed(uint32_t baudrate) {
+
+	switch (baudrate) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 500000: return B500000;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	case 2000000: return B2000000;
+	case 4000000: return B4000000;
+	default: return B0;
+	}
+
+}
+
+/* Pass everything read to the callback, or keep it for usart_getc */
+static void * usart_rx_task(void * param) {
+
+	uint8_t buf[USART_RX_CHUNK];
+	ssize_t len, i;
+
+	while (1) {
+		len = read(fd, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			csp_log_error("USART read error: %s", strerror(errno));
+			break;
+		}
+		if (len == 0)
+			break;
+		if (usart_callback != NULL) {
+			usart_callback(buf, len, NULL);
+		} else {
+			for (i = 0; i < len; i++)
+				usart_insert(buf[i], NULL);
+		}
+	}
+
+	return NULL;
+
+}
+
+void usart_init(struct usart_conf * conf) {
+
+	struct termios options;
+	speed_t speed;
+
+	fd = open(conf->device, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		csp_log_error("Failed to open %s: %s", conf->device, strerror(errno));
+		return;
+	}
+
+	/* Raw bytes, the settings of a pty are ignored by the kernel but harmless */
+	if (tcgetattr(fd, &options) == 0) {
+		cfmakeraw(&options);
+		speed = usart_speed(conf->baudrate);
+		if (speed != B0) {
+			cfsetispeed(&options, speed);
+			cfsetospeed(&options, speed);
+		}
+		options.c_cflag |= CLOCAL | CREAD;
+		if (conf->stopbits == 2)
+			options.c_cflag |= CSTOPB;
+		options.c_cc[VMIN] = 1;
+		options.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &options);
+	}
+
+	usart_getc_queue = csp_queue_create(USART_GETC_QUEUE_LENGTH, sizeof(char));
+
+	if (pthread_create(&usart_rx_thread, NULL, usart_rx_task, NULL) != 0)
+		csp_log_error("Failed to start USART RX thread");
+
+}
+
+void usart_set_callback(usart_callback_t callback) {
+
+	usart_callback = callback;
+
+}
+
+void usart_insert(char c, void * pxTaskWoken) {
+
+	if (usart_getc_queue != NULL)
+		csp_queue_enqueue(usart_getc_queue, &c, 0);
+
+}
+
+void usart_putc(char c) {
+
+	usart_putstr(&c, 1);
+
+}
+
+void usart_putstr(char * buf, int len) {
+
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+
+}
+
+char usart_getc(void) {
+
+	char c = 0;
+
+	if (usart_getc_queue != NULL)
+		csp_queue_dequeue(usart_getc_queue, &c, CSP_MAX_DELAY);
+
+	return c;
+
+}
+
+int usart_messages_waiting(int handle) {
+
+	return (usart_getc_queue != NULL) ? csp_queue_size(usart_getc_queue) : 0;
+
+}
@@ -57,41 +57,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <csp/drivers/can.h>
 
-/* CAN header macros */
-#define CFP_HOST_SIZE		5
-#define CFP_TYPE_SIZE		1
-#define CFP_REMAIN_SIZE		8
-#define CFP_ID_SIZE		10
-
-/* Macros for extracting header fields */
-#define CFP_FIELD(id,rsiz,fsiz) ((uint32_t)((uint32_t)((id) >> (rsiz)) & (uint32_t)((1 << (fsiz)) - 1)))
-#define CFP_SRC(id)		CFP_FIELD(id, CFP_HOST_SIZE + CFP_TYPE_SIZE + CFP_REMAIN_SIZE + CFP_ID_SIZE, CFP_HOST_SIZE)
-#define CFP_DST(id)		CFP_FIELD(id, CFP_TYPE_SIZE + CFP_REMAIN_SIZE + CFP_ID_SIZE, CFP_HOST_SIZE)
-#define CFP_TYPE(id)		CFP_FIELD(id, CFP_REMAIN_SIZE + CFP_ID_SIZE, CFP_TYPE_SIZE)
-#define CFP_REMAIN(id)		CFP_FIELD(id, CFP_ID_SIZE, CFP_REMAIN_SIZE)
-#define CFP_ID(id)		CFP_FIELD(id, 0, CFP_ID_SIZE)
-
-/* Macros for building CFP headers */
-#define CFP_MAKE_FIELD(id,fsiz,rsiz) ((uint32_t)(((id) & (uint32_t)((uint32_t)(1 << (fsiz)) - 1)) << (rsiz)))
-#define CFP_MAKE_SRC(id)	CFP_MAKE_FIELD(id, CFP_HOST_SIZE, CFP_HOST_SIZE + CFP_TYPE_SIZE + CFP_REMAIN_SIZE + CFP_ID_SIZE)
-#define CFP_MAKE_DST(id)	CFP_MAKE_FIELD(id, CFP_HOST_SIZE, CFP_TYPE_SIZE + CFP_REMAIN_SIZE + CFP_ID_SIZE)
-#define CFP_MAKE_TYPE(id)	CFP_MAKE_FIELD(id, CFP_TYPE_SIZE, CFP_REMAIN_SIZE + CFP_ID_SIZE)
-#define CFP_MAKE_REMAIN(id)	CFP_MAKE_FIELD(id, CFP_REMAIN_SIZE, CFP_ID_SIZE)
-#define CFP_MAKE_ID(id)		CFP_MAKE_FIELD(id, CFP_ID_SIZE, 0)
-
-/* Mask to uniquely separate connections */
-#define CFP_ID_CONN_MASK	(CFP_MAKE_SRC((uint32_t)(1 << CFP_HOST_SIZE) - 1) | \
-				 CFP_MAKE_DST((uint32_t)(1 << CFP_HOST_SIZE) - 1) | \
-				 CFP_MAKE_ID((uint32_t)(1 << CFP_ID_SIZE) - 1))
-
 /* Maximum Transmission Unit for CSP over CAN */
 #define CSP_CAN_MTU		256
 
 /* Maximum number of frames in RX queue */
 #define CSP_CAN_RX_QUEUE_SIZE	100
 
-/* Number of packet buffer elements */
-#define PBUF_ELEMENTS		CSP_CONN_MAX
+/* Number of packet buffer elements, at least one per CFP source address */
+#define PBUF_ELEMENTS		(1 << CFP_HOST_SIZE)
 
 /* Buffer element timeout in ms */
 #define PBUF_TIMEOUT_MS		10000
@@ -108,6 +81,9 @@ static int csp_can_id = 0;
 /* CFP identification number semaphore */
 static csp_bin_sem_handle_t csp_can_id_sem;
 
+/* Serializes packets, so the frames of a packet are sent back to back */
+static csp_bin_sem_handle_t csp_can_tx_sem;
+
 /* RX task handle */
 static csp_thread_handle_t csp_can_rx_task_h;
 
@@ -198,64 +174,78 @@ static int csp_can_pbuf_free(csp_can_pbuf_element_t *buf)
 	return CSP_ERR_NONE;
 }
 
-static csp_can_pbuf_element_t *csp_can_pbuf_new(uint32_t id)
+static void csp_can_pbuf_cleanup(void)
 {
 	int i;
-	csp_can_pbuf_element_t *buf, *ret = NULL;
+	csp_can_pbuf_element_t *buf;
 
 	for (i = 0; i < PBUF_ELEMENTS; i++) {
 		buf = &csp_can_pbuf[i];
-		if (buf->state == BUF_FREE) {
-			buf->state = BUF_USED;
-			buf->cfpid = id;
-			buf->remain = 0;
-			csp_can_pbuf_timestamp(buf);
-			ret = buf;
-			break;
+
+		/* Skip if not used */
+		if (buf->state != BUF_USED)
+			continue;
+
+		/* Check timeout */
+		uint32_t now = csp_get_ms();
+		if (now - buf->last_used > PBUF_TIMEOUT_MS) {
+			csp_log_warn("CAN Buffer element timed out");
+			/* Recycle packet buffer */
+			csp_can_pbuf_free(buf);
 		}
 	}
+}
 
-	return ret;
+static int csp_can_pbuf_match(csp_can_pbuf_element_t *buf, can_id_t id)
+{
+	return (buf->state == BUF_USED) && ((buf->cfpid & CFP_ID_CONN_MASK) == (id & CFP_ID_CONN_MASK));
 }
 
-static csp_can_pbuf_element_t *csp_can_pbuf_find(uint32_t id, uint32_t mask)
+/* Packets are told apart by source, destination and CFP identifier. The
+ * buffer of the source address is tried first, so in the common case of one
+ * packet per source there is no search. Packets from the same source to
+ * another destination or sent by another node, e.g. two nodes forwarding
+ * from the same source, take another buffer. */
+static csp_can_pbuf_element_t *csp_can_pbuf_find(can_id_t id)
 {
 	int i;
-	csp_can_pbuf_element_t *buf, *ret = NULL;
+	csp_can_pbuf_element_t *buf = &csp_can_pbuf[CFP_SRC(id)];
 
-	for (i = 0; i < PBUF_ELEMENTS; i++) {
-		buf = &csp_can_pbuf[i];
+	if (csp_can_pbuf_match(buf, id))
+		return buf;
 
-		if ((buf->state == BUF_USED) && ((buf->cfpid & mask) == (id & mask))) {
-			csp_can_pbuf_timestamp(buf);
-			ret = buf;
-			break;
-		}
+	for (i = 0; i < PBUF_ELEMENTS; i++) {
+		if (csp_can_pbuf_match(&csp_can_pbuf[i], id))
+			return &csp_can_pbuf[i];
 	}
 
-	return ret;
+	return NULL;
 }
 
-static void csp_can_pbuf_cleanup(void)
+/* Buffer for a new packet, the least recently used one if none is free */
+static csp_can_pbuf_element_t *csp_can_pbuf_new(can_id_t id)
 {
 	int i;
-	csp_can_pbuf_element_t *buf;
+	uint32_t now = csp_get_ms();
+	csp_can_pbuf_element_t *buf = &csp_can_pbuf[CFP_SRC(id)];
+	csp_can_pbuf_element_t *oldest = buf;
+
+	if (buf->state == BUF_FREE)
+		return buf;
 
 	for (i = 0; i < PBUF_ELEMENTS; i++) {
 		buf = &csp_can_pbuf[i];
+		if (buf->state == BUF_FREE)
+			return buf;
+		if (now - buf->last_used > now - oldest->last_used)
+			oldest = buf;
+	}
 
-		/* Skip if not used */
-		if (buf->state != BUF_USED)
-			continue;
+	csp_log_warn("Incomplete frame");
+	csp_if_can.frame++;
+	csp_can_pbuf_free(oldest);
 
-		/* Check timeout */
-		uint32_t now = csp_get_ms();
-		if (now - buf->last_used > PBUF_TIMEOUT_MS) {
-			csp_log_warn("CAN Buffer element timed out");
-			/* Recycle packet buffer */
-			csp_can_pbuf_free(buf);
-		}
-	}
+	return oldest;
 }
 
 static int csp_can_process_frame(can_frame_t *frame)
@@ -265,24 +255,20 @@ static int csp_can_process_frame(can_frame_t *frame)
 
 	can_id_t id = frame->id;
 
-	/* Bind incoming frame to a packet buffer */
-	buf = csp_can_pbuf_find(id, CFP_ID_CONN_MASK);
-
-	/* Check returned buffer */
+	/* Check buffer belongs to this packet */
+	buf = csp_can_pbuf_find(id);
 	if (buf == NULL) {
-		if (CFP_TYPE(id) == CFP_BEGIN) {
-			buf = csp_can_pbuf_new(id);
-			if (buf == NULL) {
-				csp_log_warn("No available packet buffer for CAN");
-				csp_if_can.rx_error++;
-				return CSP_ERR_NOMEM;
-			}
-		} else {
+		if (CFP_TYPE(id) != CFP_BEGIN) {
 			csp_log_warn("Out of order MORE frame received");
 			csp_if_can.frame++;
 			return CSP_ERR_INVAL;
 		}
+		buf = csp_can_pbuf_new(id);
+		buf->state = BUF_USED;
+		buf->cfpid = id;
+		buf->remain = 0;
 	}
+	csp_can_pbuf_timestamp(buf);
 
 	/* Reset frame data offset */
 	offset = 0;
@@ -402,13 +388,22 @@ static CSP_DEFINE_TASK(csp_can_rx_task)
 
 int csp_can_rx_frame(can_frame_t *frame, CSP_BASE_TYPE *task_woken)
 {
+	/* Called from the driver interrupt handler if task_woken is set */
+	if (task_woken != NULL) {
+		if (csp_queue_enqueue_isr(csp_can_rx_queue, frame, task_woken) != CSP_QUEUE_OK) {
+			csp_if_can.rx_error++;
+			return CSP_ERR_NOMEM;
+		}
+		return CSP_ERR_NONE;
+	}
+
 	if (csp_queue_enqueue(csp_can_rx_queue, frame, 1000) != CSP_QUEUE_OK)
 		return CSP_ERR_NOMEM;
 
 	return CSP_ERR_NONE;
 }
 
-static int csp_can_tx(csp_iface_t *interface, csp_packet_t *packet, uint32_t timeout)
+static int csp_can_tx_frames(csp_packet_t *packet)
 {
 	uint16_t tx_count;
 	uint8_t bytes, overhead, avail, dest;
@@ -482,11 +477,29 @@ static int csp_can_tx(csp_iface_t *interface, csp_packet_t *packet, uint32_t tim
 		}
 	}
 
-	csp_buffer_free(packet);
-
 	return CSP_ERR_NONE;
 }
 
+static int csp_can_tx(csp_iface_t *interface, csp_packet_t *packet, uint32_t timeout)
+{
+	int ret;
+
+	/* One packet at a time, so its frames go out back to back */
+	if (csp_bin_sem_wait(&csp_can_tx_sem, 1000) != CSP_SEMAPHORE_OK) {
+		csp_if_can.tx_error++;
+		return CSP_ERR_TIMEDOUT;
+	}
+
+	ret = csp_can_tx_frames(packet);
+
+	csp_bin_sem_post(&csp_can_tx_sem);
+
+	if (ret == CSP_ERR_NONE)
+		csp_buffer_free(packet);
+
+	return ret;
+}
+
 int csp_can_init(uint8_t mode, struct csp_can_config *conf)
 {
 	int ret;
@@ -504,6 +517,11 @@ int csp_can_init(uint8_t mode, struct csp_can_config *conf)
 		return CSP_ERR_NOMEM;
 	}
 
+	if (csp_bin_sem_create(&csp_can_tx_sem) != CSP_SEMAPHORE_OK) {
+		csp_log_error("Failed to initialize CAN TX semaphore");
+		return CSP_ERR_NOMEM;
+	}
+
 	if (mode == CSP_CAN_MASKED) {
 		mask = CFP_MAKE_DST((1 << CFP_HOST_SIZE) - 1);
 	} else if (mode == CSP_CAN_PROMISC) {
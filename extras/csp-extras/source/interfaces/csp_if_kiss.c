@@ -0,0 +1,325 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+#include <csp/csp_interface.h>
+#include <csp/csp_crc32.h>
+#include <csp/interfaces/csp_if_kiss.h>
+
+#define FEND		0xC0
+#define FESC		0xDB
+#define TFEND		0xDC
+#define TFESC		0xDD
+
+#define TNC_DATA	0x00
+
+/* Frames carry a CRC32 of the data after the CSP id */
+#ifdef CSP_USE_CRC32
+#define KISS_CRC_SIZE	sizeof(uint32_t)
+#else
+#define KISS_CRC_SIZE	0
+#endif
+
+/* Encoded bytes collected before they are passed to the write function */
+#ifndef CSP_KISS_TX_CHUNK
+#define CSP_KISS_TX_CHUNK	64
+#endif
+
+/* Byte classes on receive */
+#define KISS_DATA	0
+#define KISS_FEND	1
+#define KISS_FESC	2
+
+/* Second byte of the escape sequence of a byte on transmit, 0 if the byte is sent as is */
+static const uint8_t kiss_escape[256] = {
+	[FEND] = TFEND,
+	[FESC] = TFESC,
+};
+
+/* Byte an escape sequence stands for on receive, 0 if the sequence is invalid */
+static const uint8_t kiss_unescape[256] = {
+	[TFEND] = FEND,
+	[TFESC] = FESC,
+};
+
+static const uint8_t kiss_class[256] = {
+	[FEND] = KISS_FEND,
+	[FESC] = KISS_FESC,
+};
+
+/* Output state of a frame being encoded */
+typedef struct {
+	csp_kiss_handle_t * driver;
+	unsigned int count;
+	char buf[CSP_KISS_TX_CHUNK];
+} kiss_tx_t;
+
+static void kiss_tx_flush(kiss_tx_t * tx) {
+
+	unsigned int i;
+
+	if (tx->driver->kiss_write != NULL) {
+		tx->driver->kiss_write(tx->buf, tx->count);
+	} else {
+		for (i = 0; i < tx->count; i++)
+			tx->driver->kiss_putc(tx->buf[i]);
+	}
+	tx->count = 0;
+
+}
+
+static void kiss_tx_byte(kiss_tx_t * tx, uint8_t c) {
+
+	if (tx->count == sizeof(tx->buf))
+		kiss_tx_flush(tx);
+	tx->buf[tx->count++] = c;
+
+}
+
+/* Escape and queue data, runs without escapes are copied in one go */
+static void kiss_tx_data(kiss_tx_t * tx, const uint8_t * data, unsigned int length) {
+
+	unsigned int i, run;
+
+	while (length > 0) {
+		for (run = 0; (run < length) && (kiss_escape[data[run]] == 0); run++);
+
+		while (run > 0) {
+			if (tx->count == sizeof(tx->buf))
+				kiss_tx_flush(tx);
+			i = sizeof(tx->buf) - tx->count;
+			if (i > run)
+				i = run;
+			memcpy(&tx->buf[tx->count], data, i);
+			tx->count += i;
+			data += i;
+			length -= i;
+			run -= i;
+		}
+
+		if (length > 0) {
+			kiss_tx_byte(tx, FESC);
+			kiss_tx_byte(tx, kiss_escape[*data]);
+			data++;
+			length--;
+		}
+	}
+
+}
+
+static int csp_kiss_tx(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	csp_kiss_handle_t * driver = interface->driver;
+	kiss_tx_t tx;
+	uint32_t id;
+
+	/* One frame at a time, router workers may send on the same interface */
+	if (csp_bin_sem_wait(&driver->tx_sem, 1000) != CSP_SEMAPHORE_OK) {
+		interface->tx_error++;
+		return CSP_ERR_TIMEDOUT;
+	}
+
+	tx.driver = driver;
+	tx.count = 0;
+
+	kiss_tx_byte(&tx, FEND);
+	kiss_tx_byte(&tx, TNC_DATA);
+
+	id = csp_hton32(packet->id.ext);
+	kiss_tx_data(&tx, (uint8_t *) &id, sizeof(id));
+	kiss_tx_data(&tx, packet->data, packet->length);
+
+#ifdef CSP_USE_CRC32
+	uint32_t crc = csp_hton32(csp_crc32_memory(packet->data, packet->length));
+	kiss_tx_data(&tx, (uint8_t *) &crc, sizeof(crc));
+#endif
+
+	kiss_tx_byte(&tx, FEND);
+	kiss_tx_flush(&tx);
+
+	csp_bin_sem_post(&driver->tx_sem);
+
+	csp_buffer_free(packet);
+
+	return CSP_ERR_NONE;
+
+}
+
+/* Hand a complete frame to the router */
+static void csp_kiss_rx_frame(csp_iface_t * interface, csp_kiss_handle_t * driver, void * pxTaskWoken) {
+
+	csp_packet_t * packet = driver->rx_packet;
+
+	if (driver->rx_length < sizeof(packet->id) + KISS_CRC_SIZE) {
+		interface->frame++;
+		return;
+	}
+
+	packet->length = driver->rx_length - sizeof(packet->id);
+	packet->id.ext = csp_ntoh32(packet->id.ext);
+
+#ifdef CSP_USE_CRC32
+	if (csp_crc32_verify(packet, false) != CSP_ERR_NONE) {
+		interface->rx_error++;
+		return;
+	}
+#endif
+
+	interface->rxbytes += packet->length;
+	driver->rx_packet = NULL;
+	csp_qfifo_write(packet, interface, pxTaskWoken);
+
+}
+
+void csp_kiss_rx(csp_iface_t * interface, uint8_t * buf, int len, void * pxTaskWoken) {
+
+	csp_kiss_handle_t * driver = interface->driver;
+	unsigned int max = sizeof(uint32_t) + interface->mtu + KISS_CRC_SIZE;
+	unsigned int run;
+	uint8_t c;
+
+	while (len > 0) {
+
+		c = *buf;
+
+		switch (driver->rx_mode) {
+
+		case KISS_MODE_NOT_STARTED:
+			buf++;
+			len--;
+			if (c == FEND) {
+				driver->rx_mode = KISS_MODE_STARTED;
+				driver->rx_first = 1;
+				driver->rx_length = 0;
+			} else if (driver->kiss_discard != NULL) {
+				driver->kiss_discard(c, pxTaskWoken);
+			}
+			break;
+
+		case KISS_MODE_STARTED:
+			if (driver->rx_first) {
+				buf++;
+				len--;
+				/* Repeated FENDs are fill between frames */
+				if (c == FEND)
+					break;
+				driver->rx_first = 0;
+				if (c != TNC_DATA) {
+					driver->rx_mode = KISS_MODE_SKIP_FRAME;
+					break;
+				}
+				if (driver->rx_packet == NULL) {
+					driver->rx_packet = (pxTaskWoken != NULL) ?
+							csp_buffer_get_isr(interface->mtu + KISS_CRC_SIZE) : csp_buffer_get(interface->mtu + KISS_CRC_SIZE);
+					if (driver->rx_packet == NULL) {
+						interface->drop++;
+						driver->rx_mode = KISS_MODE_SKIP_FRAME;
+						break;
+					}
+				}
+				driver->rx_cbuf = (unsigned char *) &driver->rx_packet->id.ext;
+				break;
+			}
+
+			/* Copy the run of plain bytes at once */
+			for (run = 0; (run < (unsigned int) len) && (kiss_class[buf[run]] == KISS_DATA); run++);
+			if (run > 0) {
+				if (driver->rx_length + run > max) {
+					interface->frame++;
+					driver->rx_mode = KISS_MODE_SKIP_FRAME;
+					break;
+				}
+				memcpy((unsigned char *) driver->rx_cbuf + driver->rx_length, buf, run);
+				driver->rx_length += run;
+				buf += run;
+				len -= run;
+				break;
+			}
+
+			buf++;
+			len--;
+			if (c == FESC) {
+				driver->rx_mode = KISS_MODE_ESCAPED;
+				break;
+			}
+
+			/* FEND ends the frame and starts the next */
+			csp_kiss_rx_frame(interface, driver, pxTaskWoken);
+			driver->rx_mode = KISS_MODE_STARTED;
+			driver->rx_first = 1;
+			driver->rx_length = 0;
+			break;
+
+		case KISS_MODE_ESCAPED:
+			buf++;
+			len--;
+			c = kiss_unescape[c];
+			if ((c == 0) || (driver->rx_length >= max)) {
+				interface->frame++;
+				driver->rx_mode = KISS_MODE_SKIP_FRAME;
+				break;
+			}
+			driver->rx_cbuf[driver->rx_length++] = c;
+			driver->rx_mode = KISS_MODE_STARTED;
+			break;
+
+		case KISS_MODE_SKIP_FRAME:
+			buf++;
+			len--;
+			if (c == FEND) {
+				driver->rx_mode = KISS_MODE_STARTED;
+				driver->rx_first = 1;
+				driver->rx_length = 0;
+			}
+			break;
+
+		}
+
+	}
+
+}
+
+void csp_kiss_init(csp_iface_t * csp_iface, csp_kiss_handle_t * csp_kiss_handle, csp_kiss_putc_f kiss_putc_f, csp_kiss_discard_f kiss_discard_f, const char * name) {
+
+	memset(csp_kiss_handle, 0, sizeof(*csp_kiss_handle));
+	csp_kiss_handle->kiss_putc = kiss_putc_f;
+	csp_kiss_handle->kiss_discard = kiss_discard_f;
+	csp_kiss_handle->rx_mode = KISS_MODE_NOT_STARTED;
+	if (csp_bin_sem_create(&csp_kiss_handle->tx_sem) != CSP_SEMAPHORE_OK)
+		csp_log_error("Failed to initialize KISS TX semaphore");
+
+	csp_iface->driver = csp_kiss_handle;
+	csp_iface->nexthop = csp_kiss_tx;
+	csp_iface->name = name;
+	csp_iface->mtu = csp_buffer_size() - CSP_BUFFER_PACKET_OVERHEAD - KISS_CRC_SIZE;
+
+	csp_iflist_add(csp_iface);
+
+}
+
+void csp_kiss_set_write(csp_kiss_handle_t * csp_kiss_handle, csp_kiss_write_f kiss_write_f) {
+
+	csp_kiss_handle->kiss_write = kiss_write_f;
+
+}
@@ -0,0 +1,240 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+#include <csp/csp_interface.h>
+#include <csp/csp_rtable.h>
+#include <csp/arch/csp_thread.h>
+#include <csp/interfaces/csp_if_zmqhub.h>
+
+/* Frame header, the destination address goes before the CSP id */
+#define HUB_HEADER_SIZE		(1 + sizeof(uint32_t))
+
+static int hub_publisher = -1;
+static int hub_subscriber = -1;
+static csp_thread_handle_t hub_rx_handle;
+
+/* Connect a sequenced packet socket to the hub, zmq style ipc:// urls are plain paths */
+static int csp_zmqhub_connect(const char * url) {
+
+	struct sockaddr_un addr;
+	int sock;
+
+	if (strncmp(url, "ipc://", 6) == 0)
+		url += 6;
+
+	if (strlen(url) >= sizeof(addr.sun_path))
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, url);
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (sock < 0)
+		return -1;
+
+	if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		csp_log_error("ZMQHUB: connect to %s failed: %s", url, strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+
+}
+
+/* Send the frame straight from the packet buffer */
+static int csp_zmqhub_tx(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	struct iovec iov[2];
+	struct msghdr msg;
+	uint8_t dest;
+	uint16_t length = packet->length;
+
+	dest = csp_rtable_find_mac(packet->id.dst);
+	if (dest == CSP_NODE_MAC)
+		dest = packet->id.dst;
+
+	packet->id.ext = csp_hton32(packet->id.ext);
+
+	iov[0].iov_base = &dest;
+	iov[0].iov_len = sizeof(dest);
+	iov[1].iov_base = &packet->id;
+	iov[1].iov_len = sizeof(packet->id) + length;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	while (sendmsg(hub_publisher, &msg, 0) < 0) {
+		if (errno == EINTR)
+			continue;
+		packet->id.ext = csp_ntoh32(packet->id.ext);
+		interface->tx_error++;
+		return CSP_ERR_DRIVER;
+	}
+
+	csp_buffer_free(packet);
+
+	return CSP_ERR_NONE;
+
+}
+
+/* Receive frames straight into packet buffers */
+static CSP_DEFINE_TASK(csp_zmqhub_rx_task) {
+
+	csp_packet_t * packet = NULL;
+	struct iovec iov[2];
+	struct msghdr msg;
+	uint8_t dest;
+	uint8_t discard[HUB_HEADER_SIZE];
+	ssize_t received;
+
+	while (1) {
+
+		if (packet == NULL)
+			packet = csp_buffer_get(csp_if_zmqhub.mtu);
+
+		iov[0].iov_base = &dest;
+		iov[0].iov_len = sizeof(dest);
+		if (packet != NULL) {
+			iov[1].iov_base = &packet->id;
+			iov[1].iov_len = sizeof(packet->id) + csp_if_zmqhub.mtu;
+		} else {
+			/* Out of buffers, the frame is read and dropped */
+			iov[1].iov_base = discard;
+			iov[1].iov_len = sizeof(discard) - 1;
+		}
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 2;
+
+		received = recvmsg(hub_subscriber, &msg, 0);
+		if (received < 0) {
+			if (errno == EINTR)
+				continue;
+			csp_log_error("ZMQHUB: receive failed: %s", strerror(errno));
+			break;
+		}
+		if (received == 0) {
+			csp_log_error("ZMQHUB: hub closed the connection");
+			break;
+		}
+
+		if (packet == NULL) {
+			csp_if_zmqhub.drop++;
+			continue;
+		}
+
+		if ((received < (ssize_t) HUB_HEADER_SIZE) || (msg.msg_flags & MSG_TRUNC)) {
+			csp_if_zmqhub.frame++;
+			continue;
+		}
+
+		packet->length = received - HUB_HEADER_SIZE;
+		packet->id.ext = csp_ntoh32(packet->id.ext);
+		csp_if_zmqhub.rxbytes += packet->length;
+
+		csp_qfifo_write(packet, &csp_if_zmqhub, NULL);
+		packet = NULL;
+
+	}
+
+	if (packet != NULL)
+		csp_buffer_free(packet);
+
+	return CSP_TASK_RETURN;
+
+}
+
+int csp_zmqhub_init(char addr, char * host) {
+
+	if (host == NULL)
+		host = CSP_ZMQHUB_PATH;
+
+	return csp_zmqhub_init_w_endpoints(addr, host, host);
+
+}
+
+/* Close the hub sockets after a failed init */
+static void csp_zmqhub_close(void) {
+
+	if (hub_subscriber != hub_publisher)
+		close(hub_subscriber);
+	close(hub_publisher);
+	hub_subscriber = -1;
+	hub_publisher = -1;
+
+}
+
+int csp_zmqhub_init_w_endpoints(char _addr, char * publisher_url, char * subscriber_url) {
+
+	uint8_t addr = (uint8_t) _addr;
+
+	hub_publisher = csp_zmqhub_connect(publisher_url);
+	if (hub_publisher < 0)
+		return CSP_ERR_DRIVER;
+
+	if (strcmp(publisher_url, subscriber_url) == 0) {
+		hub_subscriber = hub_publisher;
+	} else {
+		hub_subscriber = csp_zmqhub_connect(subscriber_url);
+		if (hub_subscriber < 0) {
+			close(hub_publisher);
+			hub_publisher = -1;
+			return CSP_ERR_DRIVER;
+		}
+	}
+
+	/* A one byte message subscribes to an address */
+	if (send(hub_subscriber, &addr, sizeof(addr), 0) != sizeof(addr)) {
+		csp_zmqhub_close();
+		return CSP_ERR_DRIVER;
+	}
+
+	csp_if_zmqhub.mtu = csp_buffer_size() - CSP_BUFFER_PACKET_OVERHEAD;
+
+	if (csp_thread_create(csp_zmqhub_rx_task, "ZMQ", 0, NULL, 0, &hub_rx_handle) != 0) {
+		csp_zmqhub_close();
+		return CSP_ERR_NOMEM;
+	}
+
+	csp_iflist_add(&csp_if_zmqhub);
+
+	return CSP_ERR_NONE;
+
+}
+
+/* Interface definition */
+csp_iface_t csp_if_zmqhub = {
+	.name = "ZMQHUB",
+	.nexthop = csp_zmqhub_tx,
+};
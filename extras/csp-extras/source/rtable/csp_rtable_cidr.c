@@ -0,0 +1,280 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <csp/csp.h>
+
+/**
+ * CIDR routing table.
+ * Routes are kept as address/netmask entries and the longest prefix match of
+ * every node is precomputed into a per-node cache whenever the table changes.
+ * The hot path (csp_rtable_find_iface/mac) is then a single array lookup, as
+ * with the static table. Build with CSP_USE_RTABLE_CIDR to use this table
+ * instead of csp_rtable_static.c.
+ */
+#ifdef CSP_USE_RTABLE_CIDR
+
+/** Maximum number of CIDR entries, a full static table always fits */
+#ifndef CSP_RTABLE_CIDR_MAX
+#define CSP_RTABLE_CIDR_MAX		CSP_ROUTE_COUNT
+#endif
+
+/* Local typedef for the lookup cache, same layout as the static routing table */
+typedef struct __attribute__((__packed__)) csp_rtable_s {
+	csp_iface_t * interface;
+	uint8_t mac;
+} csp_rtable_t;
+
+/* Local typedef for CIDR entries */
+typedef struct csp_rtable_cidr_s {
+	csp_iface_t * interface;
+	uint8_t address;		/* Network address, host bits are zero */
+	uint8_t netmask;		/* Number of bits in netmask */
+	uint8_t mac;
+} csp_rtable_cidr_t;
+
+static csp_rtable_cidr_t entries[CSP_RTABLE_CIDR_MAX];
+static int entry_count = 0;
+
+/* Longest prefix match of each node, rebuilt by csp_rtable_update() */
+static csp_rtable_t cache[CSP_ROUTE_COUNT];
+
+static uint8_t csp_rtable_netmask(uint8_t bits) {
+
+	return (uint8_t) (CSP_ID_HOST_MAX << (CSP_ID_HOST_SIZE - bits)) & CSP_ID_HOST_MAX;
+
+}
+
+/**
+ * Find the entry with the longest netmask matching a node
+ * @param id Node
+ * @return entry index or -1 if no entry matches
+ */
+static int csp_rtable_match(uint8_t id) {
+
+	int i, best = -1;
+
+	for (i = 0; i < entry_count; i++) {
+		if ((id & csp_rtable_netmask(entries[i].netmask)) != entries[i].address)
+			continue;
+		if ((best < 0) || (entries[i].netmask > entries[best].netmask))
+			best = i;
+	}
+
+	return best;
+
+}
+
+/* Recompute the lookup cache after the entries have changed */
+static void csp_rtable_update(void) {
+
+	int id, i;
+
+	for (id = 0; id <= CSP_ID_HOST_MAX; id++) {
+		i = csp_rtable_match(id);
+		if (i < 0) {
+			cache[id].interface = NULL;
+			cache[id].mac = 0;
+		} else {
+			cache[id].interface = entries[i].interface;
+			cache[id].mac = entries[i].mac;
+		}
+	}
+
+}
+
+csp_iface_t * csp_rtable_find_iface(uint8_t id) {
+	if (id > CSP_ID_HOST_MAX)
+		return NULL;
+	return cache[id].interface;
+}
+
+uint8_t csp_rtable_find_mac(uint8_t id) {
+	if ((id > CSP_ID_HOST_MAX) || (cache[id].interface == NULL))
+		return 255;
+	return cache[id].mac;
+}
+
+void csp_rtable_clear(void) {
+	entry_count = 0;
+	memset(entries, 0, sizeof(entries));
+	memset(cache, 0, sizeof(cache));
+}
+
+/**
+ * Find the entry of a network
+ * @param node Host, or CSP_DEFAULT_ROUTE for 0/0
+ * @param mask Number of bits in netmask
+ * @return entry index, entry_count if there is none or -1 if the network is invalid
+ */
+static int csp_rtable_entry(uint8_t node, uint8_t mask) {
+
+	int i;
+
+	/* The default route is the same as 0/0 */
+	if (node == CSP_DEFAULT_ROUTE) {
+		node = 0;
+		mask = 0;
+	}
+
+	if ((node > CSP_ID_HOST_MAX) || (mask > CSP_ID_HOST_SIZE))
+		return -1;
+
+	node &= csp_rtable_netmask(mask);
+
+	for (i = 0; i < entry_count; i++)
+		if ((entries[i].address == node) && (entries[i].netmask == mask))
+			break;
+
+	return i;
+
+}
+
+/* Add or replace an entry, without updating the cache */
+static int csp_rtable_add(uint8_t node, uint8_t mask, csp_iface_t *ifc, uint8_t mac) {
+
+	int i = csp_rtable_entry(node, mask);
+
+	if (i < 0) {
+		csp_log_error("Failed to set route: invalid address %u/%u", node, mask);
+		return CSP_ERR_INVAL;
+	}
+
+	if (node == CSP_DEFAULT_ROUTE) {
+		node = 0;
+		mask = 0;
+	}
+
+	if (i == entry_count) {
+		if (entry_count >= CSP_RTABLE_CIDR_MAX) {
+			csp_log_error("Failed to set route: table full");
+			return CSP_ERR_NOMEM;
+		}
+		entry_count++;
+	}
+
+	entries[i].address = node & csp_rtable_netmask(mask);
+	entries[i].netmask = mask;
+	entries[i].interface = ifc;
+	entries[i].mac = mac;
+
+	return CSP_ERR_NONE;
+
+}
+
+/**
+ * The raw table format has one entry per node and one for the default route.
+ * Loading turns these into host routes and a 0/0 route.
+ */
+void csp_route_table_load(uint8_t route_table_in[CSP_ROUTE_TABLE_SIZE]) {
+
+	csp_rtable_t route;
+	int id;
+
+	csp_rtable_clear();
+
+	for (id = 0; id <= CSP_DEFAULT_ROUTE; id++) {
+		memcpy(&route, &route_table_in[id * sizeof(route)], sizeof(route));
+		if (route.interface != NULL)
+			csp_rtable_add(id, CSP_ID_HOST_SIZE, route.interface, route.mac);
+	}
+
+	csp_rtable_update();
+
+}
+
+/**
+ * Nodes that are routed by a longer prefix than 0/0 are saved as host routes,
+ * the rest fall back to the default route when loaded again.
+ */
+void csp_route_table_save(uint8_t route_table_out[CSP_ROUTE_TABLE_SIZE]) {
+
+	csp_rtable_t routes[CSP_ROUTE_COUNT];
+	int id, i;
+
+	memset(routes, 0, sizeof(routes));
+
+	for (id = 0; id <= CSP_ID_HOST_MAX; id++) {
+		i = csp_rtable_match(id);
+		if ((i >= 0) && (entries[i].netmask > 0))
+			routes[id] = cache[id];
+	}
+
+	for (i = 0; i < entry_count; i++) {
+		if (entries[i].netmask == 0) {
+			routes[CSP_DEFAULT_ROUTE].interface = entries[i].interface;
+			routes[CSP_DEFAULT_ROUTE].mac = entries[i].mac;
+		}
+	}
+
+	memcpy(route_table_out, routes, sizeof(routes[0]) * CSP_ROUTE_COUNT);
+
+}
+
+int csp_rtable_set(uint8_t node, uint8_t mask, csp_iface_t *ifc, uint8_t mac) {
+
+	int result;
+
+	/* Don't add nothing */
+	if (ifc == NULL)
+		return CSP_ERR_INVAL;
+
+	/* Register the interface on first use, see csp_rtable_static.c */
+	csp_iflist_add(ifc);
+
+	result = csp_rtable_add(node, mask, ifc, mac);
+	if (result != CSP_ERR_NONE)
+		return result;
+
+	csp_rtable_update();
+
+	return CSP_ERR_NONE;
+
+}
+
+int csp_rtable_remove(uint8_t node, uint8_t mask) {
+
+	int i = csp_rtable_entry(node, mask);
+
+	if ((i < 0) || (i == entry_count))
+		return CSP_ERR_INVAL;
+
+	/* The order of the entries does not matter, the last one takes the free place */
+	entries[i] = entries[--entry_count];
+	memset(&entries[entry_count], 0, sizeof(entries[0]));
+
+	csp_rtable_update();
+
+	return CSP_ERR_NONE;
+
+}
+
+#ifdef CSP_DEBUG
+void csp_rtable_print(void) {
+	int i;
+	printf("Address  Interface  Mac\r\n");
+	for (i = 0; i < entry_count; i++)
+		printf("%4u/%u   %-9s  %u\r\n", entries[i].address, entries[i].netmask,
+			entries[i].interface->name, entries[i].mac);
+}
+#endif
+
+#endif // CSP_USE_RTABLE_CIDR
@@ -22,6 +22,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <csp/csp.h>
 #include <stdio.h>
 
+/* The CIDR table in csp_rtable_cidr.c is used instead when CSP_USE_RTABLE_CIDR is set */
+#ifndef CSP_USE_RTABLE_CIDR
+
 /* Local typedef for routing table */
 typedef struct __attribute__((__packed__)) csp_rtable_s {
 	csp_iface_t * interface;
@@ -106,6 +109,18 @@ int csp_rtable_set(uint8_t node, uint8_t mask, csp_iface_t *ifc, uint8_t mac) {
 
 }
 
+int csp_rtable_remove(uint8_t node, uint8_t mask) {
+
+	if ((node > CSP_DEFAULT_ROUTE) || (routes[node].interface == NULL))
+		return CSP_ERR_INVAL;
+
+	routes[node].interface = NULL;
+	routes[node].mac = 0;
+
+	return CSP_ERR_NONE;
+
+}
+
 #ifdef CSP_DEBUG
 void csp_rtable_print(void) {
 	int i;
@@ -119,3 +134,5 @@ void csp_rtable_print(void) {
 
 }
 #endif
+
+#endif // CSP_USE_RTABLE_CIDR
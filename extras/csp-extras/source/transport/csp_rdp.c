@@ -49,6 +49,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define RDP_EAK 0x04
 #define RDP_RST	0x08
 
+/* An EACK lists the RX ring, which holds segments up to two windows ahead */
+#define RDP_EACK_MAX	(CSP_RDP_MAX_WINDOW * 2)
+
 static uint32_t csp_rdp_window_size = 4;
 static uint32_t csp_rdp_conn_timeout = 10000;
 static uint32_t csp_rdp_packet_timeout = 1000;
@@ -56,9 +59,6 @@ static uint32_t csp_rdp_delayed_acks = 1;
 static uint32_t csp_rdp_ack_timeout = 1000 / 4;
 static uint32_t csp_rdp_ack_delay_count = 4 / 2;
 
-/* Used for queue calls */
-static CSP_BASE_TYPE pdTrue = 1;
-
 typedef struct __attribute__((__packed__)) {
 	/* The timestamp is placed in the padding bytes */
 	uint8_t padding[CSP_PADDING_BYTES - 2 * sizeof(uint32_t)];
@@ -117,6 +117,19 @@ static rdp_header_t * csp_rdp_header_ref(csp_packet_t * packet) {
 	return header;
 }
 
+/* The rings are sized for CSP_RDP_MAX_WINDOW, a larger window from the user or
+ * the peer's SYN would overrun them */
+static uint32_t csp_rdp_window_clamp(uint32_t window_size) {
+
+	if (window_size < 1)
+		return 1;
+	if (window_size > CSP_RDP_MAX_WINDOW)
+		return CSP_RDP_MAX_WINDOW;
+
+	return window_size;
+
+}
+
 /* Functions for comparing wrapping sequence numbers and timestamps */
 
 /* Return 1 if seq is between start and end (both inclusive) */
@@ -149,6 +162,276 @@ static inline int csp_rdp_time_after(uint32_t time, uint32_t cmp) {
 	return csp_rdp_time_before(cmp, time);
 }
 
+/**
+ * ROUND-TRIP TIME
+ * The retransmission timeout is estimated per connection as in RFC 6298, from the
+ * time between sending a segment and receiving the ACK or EACK for it. Segments that
+ * have been retransmitted are not sampled (Karn's algorithm), and each timeout
+ * doubles the RTO until a new sample is taken. srtt and rttvar are kept scaled by
+ * 8 and 4 so that millisecond samples on fast links are not lost to rounding.
+ */
+static void csp_rdp_rtt_init(csp_conn_t * conn) {
+
+	conn->rdp.srtt = 0;
+	conn->rdp.rttvar = 0;
+	conn->rdp.rto = conn->rdp.packet_timeout;
+	conn->rdp.retransmits = 0;
+	conn->rdp.probed = 0;
+
+}
+
+static void csp_rdp_rtt_sample(csp_conn_t * conn, uint32_t rtt) {
+
+	int32_t delta;
+
+	/* Timestamps have ms resolution, a zero sample would look like no estimate */
+	if (rtt == 0)
+		rtt = 1;
+
+	if (conn->rdp.srtt == 0) {
+		conn->rdp.srtt = rtt << 3;
+		conn->rdp.rttvar = rtt << 1;
+	} else {
+		/* srtt = 7/8 srtt + 1/8 rtt, rttvar = 3/4 rttvar + 1/4 |srtt - rtt| */
+		delta = (int32_t) rtt - (int32_t) (conn->rdp.srtt >> 3);
+		conn->rdp.srtt += delta;
+		if (delta < 0)
+			delta = -delta;
+		delta -= (int32_t) (conn->rdp.rttvar >> 2);
+		conn->rdp.rttvar += delta;
+	}
+
+	/* rto = srtt + 4 * rttvar, bounded below by the minimum and above by the connection timeout */
+	conn->rdp.rto = (conn->rdp.srtt >> 3) + conn->rdp.rttvar;
+	if (conn->rdp.rto < CSP_RDP_RTO_MIN)
+		conn->rdp.rto = CSP_RDP_RTO_MIN;
+
+	/* A receiver using delayed ACKs may hold the ACK for ack_timeout. Those segments are
+	 * rarely sampled, because they are retransmitted before the ACK arrives, so the
+	 * samples alone would not cover the delay */
+	if (conn->rdp.delayed_acks && (conn->rdp.rto < (conn->rdp.srtt >> 3) + conn->rdp.ack_timeout))
+		conn->rdp.rto = (conn->rdp.srtt >> 3) + conn->rdp.ack_timeout;
+	if (conn->rdp.rto > conn->rdp.conn_timeout)
+		conn->rdp.rto = conn->rdp.conn_timeout;
+
+	csp_log_protocol("RTT sample %"PRIu32" ms, srtt %"PRIu32", rttvar %"PRIu32", rto %"PRIu32,
+			rtt, conn->rdp.srtt >> 3, conn->rdp.rttvar >> 2, conn->rdp.rto);
+
+}
+
+static void csp_rdp_rtt_backoff(csp_conn_t * conn) {
+
+	conn->rdp.rto *= 2;
+	if (conn->rdp.rto > conn->rdp.conn_timeout)
+		conn->rdp.rto = conn->rdp.conn_timeout;
+
+}
+
+/**
+ * CONGESTION CONTROL
+ * The number of segments in flight is limited to the congestion window as well
+ * as the negotiated window_size. The congestion window starts small and grows by
+ * one segment per ACKed segment (slow start) until it reaches ssthresh, and by one
+ * segment per window after that. A loss signalled by an EACK halves the window,
+ * a retransmission timeout drops it to the minimum. Only one reduction is made per
+ * window of data, losses of segments sent before the reduction are not counted again.
+ * The window is kept large enough for the receiver to ACK on ack_delay_count, so a
+ * small window does not wait for the delayed ACK timeout on every round trip.
+ */
+static uint32_t csp_rdp_cwnd_min(csp_conn_t * conn) {
+
+	uint32_t min = conn->rdp.delayed_acks ? conn->rdp.ack_delay_count + 1 : 2;
+
+	if (min > conn->rdp.window_size)
+		min = conn->rdp.window_size;
+
+	return min;
+
+}
+
+static void csp_rdp_cwnd_init(csp_conn_t * conn) {
+
+	conn->rdp.cwnd = CSP_RDP_CWND_INIT;
+	if (conn->rdp.cwnd < csp_rdp_cwnd_min(conn))
+		conn->rdp.cwnd = csp_rdp_cwnd_min(conn);
+	conn->rdp.ssthresh = conn->rdp.window_size;
+	conn->rdp.cwnd_acked = 0;
+	conn->rdp.snd_recover = conn->rdp.snd_una;
+
+}
+
+/* Return the number of segments that may be in flight */
+static inline uint32_t csp_rdp_send_window(csp_conn_t * conn) {
+
+	if (conn->rdp.cwnd < conn->rdp.window_size)
+		return conn->rdp.cwnd;
+
+	return conn->rdp.window_size;
+
+}
+
+static void csp_rdp_cwnd_acked(csp_conn_t * conn, uint16_t acked) {
+
+	if (conn->rdp.cwnd < conn->rdp.ssthresh) {
+		conn->rdp.cwnd += acked;
+	} else {
+		conn->rdp.cwnd_acked += acked;
+		if (conn->rdp.cwnd_acked >= conn->rdp.cwnd) {
+			conn->rdp.cwnd_acked -= conn->rdp.cwnd;
+			conn->rdp.cwnd++;
+		}
+	}
+
+	if (conn->rdp.cwnd > conn->rdp.window_size)
+		conn->rdp.cwnd = conn->rdp.window_size;
+
+}
+
+static void csp_rdp_cwnd_loss(csp_conn_t * conn, int timeout) {
+
+	/* Still recovering from an earlier loss in this window */
+	if (csp_rdp_seq_before(conn->rdp.snd_una, conn->rdp.snd_recover))
+		return;
+
+	conn->rdp.ssthresh = (uint16_t)(conn->rdp.snd_nxt - conn->rdp.snd_una) / 2;
+	if (conn->rdp.ssthresh < csp_rdp_cwnd_min(conn))
+		conn->rdp.ssthresh = csp_rdp_cwnd_min(conn);
+	conn->rdp.cwnd = timeout ? csp_rdp_cwnd_min(conn) : conn->rdp.ssthresh;
+	conn->rdp.cwnd_acked = 0;
+	conn->rdp.snd_recover = conn->rdp.snd_nxt;
+
+	csp_log_protocol("Congestion %s, cwnd %"PRIu32", ssthresh %"PRIu32,
+			timeout ? "timeout" : "EACK", conn->rdp.cwnd, conn->rdp.ssthresh);
+
+}
+
+/**
+ * RETRANSMISSION RING
+ * Unacknowledged segments are stored in tx_ring at seq_nr & (CSP_RDP_TX_RING_SIZE - 1).
+ * The slots are also linked in the order they were (re)transmitted, so the head of the
+ * list is the first segment to time out and the timeout check stops at the first
+ * segment that is not due. The ring is shared by the sending task and the router
+ * task, and must only be accessed with the connection locked.
+ */
+#define RDP_TX_NONE	0xFFFF
+
+static void csp_rdp_tx_unlink(csp_conn_t * conn, uint16_t slot) {
+
+	uint16_t next = conn->rdp.tx_next[slot];
+	uint16_t prev = conn->rdp.tx_prev[slot];
+
+	if (prev == RDP_TX_NONE)
+		conn->rdp.tx_head = next;
+	else
+		conn->rdp.tx_next[prev] = next;
+
+	if (next == RDP_TX_NONE)
+		conn->rdp.tx_tail = prev;
+	else
+		conn->rdp.tx_prev[next] = prev;
+
+}
+
+static void csp_rdp_tx_link_tail(csp_conn_t * conn, uint16_t slot) {
+
+	conn->rdp.tx_next[slot] = RDP_TX_NONE;
+	conn->rdp.tx_prev[slot] = conn->rdp.tx_tail;
+
+	if (conn->rdp.tx_tail == RDP_TX_NONE)
+		conn->rdp.tx_head = slot;
+	else
+		conn->rdp.tx_next[conn->rdp.tx_tail] = slot;
+	conn->rdp.tx_tail = slot;
+
+}
+
+static int csp_rdp_tx_add(csp_conn_t * conn, rdp_packet_t * packet, uint16_t seq_nr) {
+
+	uint16_t slot = seq_nr & (CSP_RDP_TX_RING_SIZE - 1);
+
+	if (conn->rdp.tx_ring[slot] != NULL)
+		return CSP_ERR_NOBUFS;
+
+	conn->rdp.tx_ring[slot] = (csp_packet_t *) packet;
+	conn->rdp.tx_retries[slot] = 0;
+	conn->rdp.tx_count++;
+	csp_rdp_tx_link_tail(conn, slot);
+
+	return CSP_ERR_NONE;
+
+}
+
+static rdp_packet_t * csp_rdp_tx_find(csp_conn_t * conn, uint16_t seq_nr) {
+
+	csp_packet_t * packet = conn->rdp.tx_ring[seq_nr & (CSP_RDP_TX_RING_SIZE - 1)];
+
+	if ((packet == NULL) || (csp_ntoh16(csp_rdp_header_ref(packet)->seq_nr) != seq_nr))
+		return NULL;
+
+	return (rdp_packet_t *) packet;
+
+}
+
+static void csp_rdp_tx_free(csp_conn_t * conn, uint16_t seq_nr) {
+
+	uint16_t slot = seq_nr & (CSP_RDP_TX_RING_SIZE - 1);
+
+	if (csp_rdp_tx_find(conn, seq_nr) == NULL)
+		return;
+
+	csp_log_protocol("TX Element %u freed", seq_nr);
+	csp_rdp_tx_unlink(conn, slot);
+	csp_buffer_free(conn->rdp.tx_ring[slot]);
+	conn->rdp.tx_ring[slot] = NULL;
+	conn->rdp.tx_count--;
+
+}
+
+/* Return the segment if it can be used for an RTT sample */
+static rdp_packet_t * csp_rdp_tx_find_sample(csp_conn_t * conn, uint16_t seq_nr) {
+
+	rdp_packet_t * packet = csp_rdp_tx_find(conn, seq_nr);
+
+	if ((packet == NULL) || (conn->rdp.tx_retries[seq_nr & (CSP_RDP_TX_RING_SIZE - 1)] != 0))
+		return NULL;
+
+	return packet;
+
+}
+
+/* Store a new snd_una from a received ACK and free the segments it acknowledges */
+static void csp_rdp_tx_acked(csp_conn_t * conn, uint16_t una) {
+
+	int i;
+	rdp_packet_t * packet;
+
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+
+	/* A reordered ACK older than snd_una acknowledges nothing new */
+	if (csp_rdp_seq_before(conn->rdp.snd_una, una)) {
+
+		/* Sample the RTT of the newest segment this ACK covers */
+		packet = csp_rdp_tx_find_sample(conn, una - 1);
+		if (packet != NULL)
+			csp_rdp_rtt_sample(conn, csp_get_ms() - packet->timestamp);
+		csp_rdp_cwnd_acked(conn, una - conn->rdp.snd_una);
+		conn->rdp.probed = 0;
+
+		for (i = 0; (i < CSP_RDP_TX_RING_SIZE) && (conn->rdp.tx_count > 0) &&
+				csp_rdp_seq_before(conn->rdp.snd_una, una); i++)
+			csp_rdp_tx_free(conn, conn->rdp.snd_una++);
+
+		conn->rdp.snd_una = una;
+	}
+
+	csp_conn_unlock(conn);
+
+	/* Wake the user task, the window may have room for more data */
+	if (conn->rdp.state == RDP_OPEN)
+		csp_bin_sem_post(&conn->rdp.tx_wait);
+
+}
+
 /**
  * CONTROL MESSAGES
  * The following function is used to send empty messages,
@@ -175,13 +458,16 @@ static int csp_rdp_send_cmp(csp_conn_t * conn, csp_packet_t * packet, int flags,
 	header->syn = (flags & RDP_SYN) ? 1 : 0;
 	header->rst = (flags & RDP_RST) ? 1 : 0;
 
-	/* Send copy to tx_queue, before sending packet to IF */
+	/* Send copy to tx_ring, before sending packet to IF */
 	if (flags & RDP_SYN) {
 		rdp_packet_t * rdp_packet = csp_buffer_clone(packet);
 		if (rdp_packet == NULL) return CSP_ERR_NOMEM;
 		rdp_packet->timestamp = csp_get_ms();
-		if (csp_queue_enqueue(conn->rdp.tx_queue, &rdp_packet, 0) != CSP_QUEUE_OK)
+		rdp_packet->quarantine = 0;
+		csp_conn_lock(conn, CSP_MAX_DELAY);
+		if (csp_rdp_tx_add(conn, rdp_packet, seq_nr) != CSP_ERR_NONE)
 			csp_buffer_free(rdp_packet);
+		csp_conn_unlock(conn);
 	}
 
 	/* Send control messages with high priority */
@@ -212,21 +498,21 @@ static int csp_rdp_send_cmp(csp_conn_t * conn, csp_packet_t * packet, int flags,
  */
 static int csp_rdp_send_eack(csp_conn_t * conn) {
 
-	/* Allocate message */
-	csp_packet_t * packet_eack = csp_buffer_get(100);
+	/* Allocate message, the RX ring only holds segments up to two windows ahead */
+	csp_packet_t * packet_eack = csp_buffer_get(RDP_EACK_MAX * sizeof(uint16_t) + sizeof(rdp_header_t));
 	if (packet_eack == NULL) return CSP_ERR_NOMEM;
 	packet_eack->length = 0;
 
-	/* Loop through RX queue */
-	int i, count;
+	/* Walk the RX ring in sequence order, the router adds to it and user tasks flush it */
+	int i, found;
 	csp_packet_t * packet;
-	count = csp_queue_size(conn->rdp.rx_queue);
-	for (i = 0; i < count; i++) {
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	for (i = 1, found = 0; (i <= RDP_EACK_MAX) && (found < conn->rdp.rx_count); i++) {
 
-		if (csp_queue_dequeue_isr(conn->rdp.rx_queue, &packet, &pdTrue) != CSP_QUEUE_OK) {
-			csp_log_error("Cannot dequeue from rx_queue in queue deliver");
-			break;
-		}
+		packet = conn->rdp.rx_ring[(uint16_t)(conn->rdp.rcv_cur + i) & (CSP_RDP_RX_RING_SIZE - 1)];
+		if (packet == NULL)
+			continue;
+		found++;
 
 		/* Add seq nr to EACK packet */
 		rdp_header_t * header = csp_rdp_header_ref(packet);
@@ -234,10 +520,8 @@ static int csp_rdp_send_eack(csp_conn_t * conn) {
 		packet_eack->length += sizeof(uint16_t);
 		csp_log_protocol("Added EACK nr %u", header->seq_nr);
 
-		/* Requeue */
-		csp_queue_enqueue_isr(conn->rdp.rx_queue, &packet, &pdTrue);
-
 	}
+	csp_conn_unlock(conn);
 
 	return csp_rdp_send_cmp(conn, packet_eack, RDP_ACK | RDP_EAK, conn->rdp.snd_nxt, conn->rdp.rcv_cur);
 
@@ -284,120 +568,152 @@ static inline int csp_rdp_receive_data(csp_conn_t * conn, csp_packet_t * packet)
 
 static inline void csp_rdp_rx_queue_flush(csp_conn_t * conn) {
 
-	/* Loop through RX queue */
-	int i, count;
-	csp_packet_t * packet;
+	/* Deliver segments from the RX ring for as long as they are in sequence */
+	csp_packet_t ** slot;
 
-front:
-	count = csp_queue_size(conn->rdp.rx_queue);
-	for (i = 0; i < count; i++) {
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	while (conn->rdp.rx_count > 0) {
 
-		if (csp_queue_dequeue_isr(conn->rdp.rx_queue, &packet, &pdTrue) != CSP_QUEUE_OK) {
-			csp_log_error("Cannot dequeue from rx_queue in queue deliver");
+		slot = &conn->rdp.rx_ring[(uint16_t)(conn->rdp.rcv_cur + 1) & (CSP_RDP_RX_RING_SIZE - 1)];
+		if (*slot == NULL)
 			break;
-		}
 
-		rdp_header_t * header = csp_rdp_header_ref(packet);
-		csp_log_protocol("RX Queue deliver matching Element, seq %u", header->seq_nr);
+		csp_packet_t * packet = *slot;
 
-		/* If the matching packet was found: */
-		if (header->seq_nr == (uint16_t)(conn->rdp.rcv_cur + 1)) {
-			csp_log_protocol("Deliver seq %u", header->seq_nr);
-			csp_rdp_receive_data(conn, packet);
-			conn->rdp.rcv_cur++;
-			/* Loop from first element again */
-			goto front;
+		csp_log_protocol("Deliver seq %u", csp_rdp_header_ref(packet)->seq_nr);
 
-		/* Otherwise, requeue */
-		} else {
-			csp_queue_enqueue_isr(conn->rdp.rx_queue, &packet, &pdTrue);
+		/* The segment has been EACKed and will not be sent again, so it stays in the
+		 * ring until the connection RX queue has room. The header is put back, the
+		 * ring is searched by the sequence number in it. */
+		if (csp_rdp_receive_data(conn, packet) != CSP_ERR_NONE) {
+			packet->length += sizeof(rdp_header_t);
+			break;
 		}
 
+		*slot = NULL;
+		conn->rdp.rx_count--;
+		conn->rdp.rcv_cur++;
+
 	}
+	csp_conn_unlock(conn);
 
 }
 
 static inline bool csp_rdp_seq_in_rx_queue(csp_conn_t * conn, uint16_t seq_nr) {
 
-	/* Loop through RX queue */
-	int i, count;
-	rdp_packet_t * packet;
-	count = csp_queue_size(conn->rdp.rx_queue);
-	for (i = 0; i < count; i++) {
+	csp_packet_t * packet;
+	bool found;
 
-		if (csp_queue_dequeue_isr(conn->rdp.rx_queue, &packet, &pdTrue) != CSP_QUEUE_OK) {
-			csp_log_error("Cannot dequeue from rx_queue in queue exists");
-			break;
-		}
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	packet = conn->rdp.rx_ring[seq_nr & (CSP_RDP_RX_RING_SIZE - 1)];
+	found = (packet != NULL) && (csp_rdp_header_ref(packet)->seq_nr == seq_nr);
+	csp_conn_unlock(conn);
 
-		csp_queue_enqueue_isr(conn->rdp.rx_queue, &packet, &pdTrue);
+	return found;
 
-		rdp_header_t * header = csp_rdp_header_ref((csp_packet_t *) packet);
-		csp_log_protocol("RX Queue exists matching Element, seq %u", header->seq_nr);
+}
 
-		/* If the matching packet was found, deliver */
-		if (header->seq_nr == seq_nr) {
-			csp_log_protocol("We have a match");
-			return true;
-		}
+static inline int csp_rdp_rx_queue_add(csp_conn_t * conn, csp_packet_t * packet, uint16_t seq_nr) {
+
+	csp_packet_t ** slot = &conn->rdp.rx_ring[seq_nr & (CSP_RDP_RX_RING_SIZE - 1)];
+	int result = CSP_QUEUE_ERROR;
 
+	/* Only segments within the ring can be stored, in a free slot */
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	if (((uint16_t)(seq_nr - conn->rdp.rcv_cur - 1) < CSP_RDP_RX_RING_SIZE) && (*slot == NULL)) {
+		*slot = packet;
+		conn->rdp.rx_count++;
+		result = CSP_QUEUE_OK;
 	}
+	csp_conn_unlock(conn);
 
-	return false;
+	return result;
 
 }
 
-static inline int csp_rdp_rx_queue_add(csp_conn_t * conn, csp_packet_t * packet, uint16_t seq_nr) {
+static void csp_rdp_retransmit(csp_conn_t * conn, rdp_packet_t * packet, uint32_t time_now) {
+
+	rdp_header_t * header = csp_rdp_header_ref((csp_packet_t *) packet);
+	uint16_t seq_nr = csp_ntoh16(header->seq_nr);
+
+	csp_log_protocol("Retransmitting seq %u", seq_nr);
+
+	/* Update to latest outgoing ACK */
+	header->ack_nr = csp_hton16(conn->rdp.rcv_cur);
+
+	/* Exclude the segment from RTT sampling, the ACK could belong to either transmission */
+	if (conn->rdp.tx_retries[seq_nr & (CSP_RDP_TX_RING_SIZE - 1)] < UINT8_MAX)
+		conn->rdp.tx_retries[seq_nr & (CSP_RDP_TX_RING_SIZE - 1)]++;
+	conn->rdp.retransmits++;
 
-	if (csp_rdp_seq_in_rx_queue(conn, seq_nr))
-		return CSP_QUEUE_ERROR;
-	return csp_queue_enqueue_isr(conn->rdp.rx_queue, &packet, &pdTrue);
+	/* Restart the timer by moving the segment to the end of the list */
+	packet->timestamp = time_now;
+	csp_rdp_tx_unlink(conn, seq_nr & (CSP_RDP_TX_RING_SIZE - 1));
+	csp_rdp_tx_link_tail(conn, seq_nr & (CSP_RDP_TX_RING_SIZE - 1));
+
+	/* Send copy to interface */
+	csp_packet_t * new_packet = csp_buffer_clone(packet);
+	if (new_packet == NULL) {
+		csp_log_warn("Retransmission failed");
+		return;
+	}
+	csp_iface_t * ifout = csp_rtable_find_iface(conn->idout.dst);
+	if (csp_send_direct(conn->idout, new_packet, ifout, 0) != CSP_ERR_NONE) {
+		csp_log_warn("Retransmission failed");
+		csp_buffer_free(new_packet);
+	}
 
 }
 
 static void csp_rdp_flush_eack(csp_conn_t * conn, csp_packet_t * eack_packet) {
 
-	/* Loop through TX queue */
-	int i, j, count;
+	int i, count, sampled = 0, lost = 0;
+	uint16_t seq_nr, highest = conn->rdp.snd_una;
+	uint32_t rtt = 0, quarantine;
+	uint32_t time_now = csp_get_ms();
 	rdp_packet_t * packet;
-	count = csp_queue_size(conn->rdp.tx_queue);
-	for (i = 0; i < count; i++) {
 
-		if (csp_queue_dequeue(conn->rdp.tx_queue, &packet, 0) != CSP_QUEUE_OK) {
-			csp_log_error("Cannot dequeue from tx_queue in flush EACK");
-			break;
-		}
-
-		rdp_header_t * header = csp_rdp_header_ref((csp_packet_t *) packet);
-		csp_log_protocol("EACK compare element, time %u, seq %u", packet->timestamp, csp_ntoh16(header->seq_nr));
-
-		/* Look for this element in EACKs */
-		int match = 0;
-		for (j = 0; j < (int)((eack_packet->length - sizeof(rdp_header_t)) / sizeof(uint16_t)); j++) {
-			if (csp_ntoh16(eack_packet->data16[j]) == csp_ntoh16(header->seq_nr))
-				match = 1;
-
-			/* Enable this if you want EACK's to trigger retransmission */
-			if (csp_ntoh16(eack_packet->data16[j]) > csp_ntoh16(header->seq_nr)) {
-				uint32_t time_now = csp_get_ms();
-				if (csp_rdp_time_after(time_now, packet->quarantine)) {
-					packet->timestamp = time_now - conn->rdp.packet_timeout - 1;
-					packet->quarantine = time_now +	conn->rdp.packet_timeout / 2;
-				}
+	/* Free every segment listed in the EACK */
+	count = (eack_packet->length - sizeof(rdp_header_t)) / sizeof(uint16_t);
+	for (i = 0; i < count; i++) {
+		seq_nr = csp_ntoh16(eack_packet->data16[i]);
+		csp_log_protocol("EACK seq %u", seq_nr);
+		if (!csp_rdp_seq_between(seq_nr, conn->rdp.snd_una, conn->rdp.snd_nxt - 1))
+			continue;
+		if (csp_rdp_seq_after(seq_nr, highest) || !sampled) {
+			packet = csp_rdp_tx_find_sample(conn, seq_nr);
+			if (packet != NULL) {
+				rtt = time_now - packet->timestamp;
+				sampled = 1;
 			}
 		}
+		csp_rdp_tx_free(conn, seq_nr);
+		if (csp_rdp_seq_after(seq_nr, highest))
+			highest = seq_nr;
+	}
 
-		if (match == 0) {
-			/* If not found, put back on tx queue */
-			csp_queue_enqueue(conn->rdp.tx_queue, &packet, 0);
-		} else {
-			/* Found, free */
-			csp_log_protocol("TX Element %u freed", csp_ntoh16(header->seq_nr));
-			csp_buffer_free(packet);
-		}
-
+	/* Sample the RTT of the newest segment in the EACK */
+	if (sampled)
+		csp_rdp_rtt_sample(conn, rtt);
+
+	/* Segments before the highest EACK'ed one are lost, retransmit them unless they were
+	 * retransmitted less than a round trip ago because of an earlier EACK */
+	if (conn->rdp.srtt != 0)
+		quarantine = (conn->rdp.srtt >> 3) + (conn->rdp.rttvar >> 2);
+	else
+		quarantine = conn->rdp.rto / 2;
+	for (seq_nr = conn->rdp.snd_una; csp_rdp_seq_before(seq_nr, highest); seq_nr++) {
+		packet = csp_rdp_tx_find(conn, seq_nr);
+		if ((packet == NULL) || !csp_rdp_time_after(time_now, packet->quarantine))
+			continue;
+		packet->quarantine = time_now + quarantine;
+		csp_rdp_retransmit(conn, packet, time_now);
+		lost = 1;
 	}
 
+	if (lost)
+		csp_rdp_cwnd_loss(conn, 0);
+
 }
 
 static inline bool csp_rdp_should_ack(csp_conn_t * conn) {
@@ -426,44 +742,59 @@ static inline bool csp_rdp_should_ack(csp_conn_t * conn) {
 
 void csp_rdp_flush_all(csp_conn_t * conn) {
 
-	if ((conn == NULL) || conn->rdp.tx_queue == NULL) {
+	if (conn == NULL) {
 		csp_log_error("Null pointer passed to rdp flush all");
 		return;
 	}
 
-	rdp_packet_t * packet;
-
-	/* Empty TX queue */
-	while (csp_queue_dequeue_isr(conn->rdp.tx_queue, &packet, &pdTrue) == CSP_QUEUE_OK) {
-		if (packet != NULL) {
-			csp_log_protocol("Flush TX Element, time %u, seq %u", packet->timestamp, csp_ntoh16(csp_rdp_header_ref((csp_packet_t *) packet)->seq_nr));
-			csp_buffer_free(packet);
+	/* Empty TX ring */
+	int i;
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	for (i = 0; i < CSP_RDP_TX_RING_SIZE; i++) {
+		if (conn->rdp.tx_ring[i] != NULL) {
+			csp_log_protocol("Flush TX Element, seq %u", csp_ntoh16(csp_rdp_header_ref(conn->rdp.tx_ring[i])->seq_nr));
+			csp_buffer_free(conn->rdp.tx_ring[i]);
+			conn->rdp.tx_ring[i] = NULL;
 		}
 	}
-
-	/* Empty RX queue */
-	while (csp_queue_dequeue_isr(conn->rdp.rx_queue, &packet, &pdTrue) == CSP_QUEUE_OK) {
-		if (packet != NULL) {
-			csp_log_protocol("Flush RX Element, time %u, seq %u", packet->timestamp, csp_ntoh16(csp_rdp_header_ref((csp_packet_t *) packet)->seq_nr));
-			csp_buffer_free(packet);
+	conn->rdp.tx_head = RDP_TX_NONE;
+	conn->rdp.tx_tail = RDP_TX_NONE;
+	conn->rdp.tx_count = 0;
+
+	/* Empty RX ring, the router may be adding to it */
+	for (i = 0; i < CSP_RDP_RX_RING_SIZE; i++) {
+		if (conn->rdp.rx_ring[i] != NULL) {
+			csp_log_protocol("Flush RX Element, seq %u", csp_rdp_header_ref(conn->rdp.rx_ring[i])->seq_nr);
+			csp_buffer_free(conn->rdp.rx_ring[i]);
+			conn->rdp.rx_ring[i] = NULL;
 		}
 	}
+	conn->rdp.rx_count = 0;
+	csp_conn_unlock(conn);
 
 }
 
-int csp_rdp_check_ack(csp_conn_t * conn) {
+static bool csp_rdp_rx_avail(csp_conn_t * conn) {
+
+	/* Check all RX queues for room for another window. A window larger than half the
+	 * queue could never be ACKed. If the queue does fill up, in-sequence segments are
+	 * not ACKed and are sent again, EACKed segments wait in the RX ring */
+	int prio;
+	int32_t needed = conn->rdp.window_size;
+	if (needed > CSP_RX_QUEUE_LENGTH / 2)
+		needed = CSP_RX_QUEUE_LENGTH / 2;
+	for (prio = 0; prio < CSP_RX_QUEUES; prio++)
+		if (CSP_RX_QUEUE_LENGTH - csp_queue_size(conn->rx_queue[prio]) <= needed)
+			return false;
 
-	/* Check all RX queues for spare capacity */
-	int prio, avail = 1;
-	for (prio = 0; prio < CSP_RX_QUEUES; prio++) {
-		if (CSP_RX_QUEUE_LENGTH - csp_queue_size(conn->rx_queue[prio]) <= 2 * (int32_t)conn->rdp.window_size) {
-			avail = 0;
-			break;
-		}
-	}
+	return true;
+
+}
+
+int csp_rdp_check_ack(csp_conn_t * conn) {
 
 	/* If more space available, only send after ack timeout or immediately if delay_acks is zero */
-	if (avail && csp_rdp_should_ack(conn))
+	if (csp_rdp_rx_avail(conn) && csp_rdp_should_ack(conn))
 		csp_rdp_send_cmp(conn, NULL, RDP_ACK, conn->rdp.snd_nxt, conn->rdp.rcv_cur);
 
 	return CSP_ERR_NONE;
@@ -479,6 +810,7 @@ int csp_rdp_check_ack(csp_conn_t * conn) {
 void csp_rdp_check_timeouts(csp_conn_t * conn) {
 
 	rdp_packet_t * packet;
+	int timedout = 0;
 
 	/**
 	 * CONNECTION TIMEOUT:
@@ -507,59 +839,56 @@ void csp_rdp_check_timeouts(csp_conn_t * conn) {
 
 	/**
 	 * MESSAGE TIMEOUT:
-	 * Check each outgoing message for TX timeout
+	 * Retransmit the segments that are due, oldest transmission first,
+	 * and back off the retransmission timeout once per timeout event
 	 */
-	int i, count;
-	count = csp_queue_size(conn->rdp.tx_queue);
-	for (i = 0; i < count; i++) {
-
-		if ((csp_queue_dequeue_isr(conn->rdp.tx_queue, &packet, &pdTrue) != CSP_QUEUE_OK) || packet == NULL) {
-			csp_log_warn("Cannot dequeue from tx_queue in check timeout");
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	while (conn->rdp.tx_head != RDP_TX_NONE) {
+		packet = (rdp_packet_t *) conn->rdp.tx_ring[conn->rdp.tx_head];
+		if (!csp_rdp_time_after(time_now, packet->timestamp + conn->rdp.rto))
 			break;
-		}
-
-		/* Get header */
-		rdp_header_t * header = csp_rdp_header_ref((csp_packet_t *) packet);
-
-		/* If acked, do not retransmit */
-		if (csp_rdp_seq_before(csp_ntoh16(header->seq_nr), conn->rdp.snd_una)) {
-			csp_log_protocol("TX Element Free, time %u, seq %u, una %u", packet->timestamp, csp_ntoh16(header->seq_nr), conn->rdp.snd_una);
-			csp_buffer_free(packet);
-			continue;
-		}
-
-		/* Check timestamp and retransmit if needed */
-		if (csp_rdp_time_after(time_now, packet->timestamp + conn->rdp.packet_timeout)) {
-			csp_log_protocol("TX Element timed out, retransmitting seq %u", csp_ntoh16(header->seq_nr));
-
-			/* Update to latest outgoing ACK */
-			header->ack_nr = csp_hton16(conn->rdp.rcv_cur);
-
-			/* Send copy to tx_queue */
-			packet->timestamp = csp_get_ms();
-			csp_packet_t * new_packet = csp_buffer_clone(packet);
-			csp_iface_t * ifout = csp_rtable_find_iface(conn->idout.dst);
-			if (csp_send_direct(conn->idout, new_packet, ifout, 0) != CSP_ERR_NONE) {
-				csp_log_warn("Retransmission failed");
-				csp_buffer_free(new_packet);
-			}
+		csp_rdp_retransmit(conn, packet, time_now);
+		timedout = 1;
+	}
+	if (timedout) {
+		csp_rdp_rtt_backoff(conn);
+		csp_rdp_cwnd_loss(conn, 1);
+	}
 
+	/**
+	 * TAIL LOSS PROBE:
+	 * Segments lost at the end of a burst produce no EACK, and the receiver holds
+	 * its delayed ACK until it has ack_delay_count of them, so only the RTO would
+	 * recover them. Two round trips after the last transmission, the newest segment
+	 * is sent again, once per advance of snd_una. The receiver answers a duplicate,
+	 * or a segment beyond a gap, with an EACK at once. The probe is not a congestion
+	 * signal, the window is only reduced by the loss it reveals.
+	 */
+	if (!timedout && !conn->rdp.probed && (conn->rdp.srtt != 0) && (conn->rdp.tx_tail != RDP_TX_NONE)) {
+		uint32_t pto = conn->rdp.srtt >> 2;
+		if (pto < CSP_RDP_RTO_MIN)
+			pto = CSP_RDP_RTO_MIN;
+		packet = (rdp_packet_t *) conn->rdp.tx_ring[conn->rdp.tx_tail];
+		if ((pto < conn->rdp.rto) && csp_rdp_time_after(time_now, packet->timestamp + pto)) {
+			csp_log_protocol("Tail loss probe");
+			csp_rdp_retransmit(conn, packet, time_now);
+			conn->rdp.probed = 1;
 		}
-
-		/* Requeue the TX element */
-		csp_queue_enqueue_isr(conn->rdp.tx_queue, &packet, &pdTrue);
-
 	}
+	csp_conn_unlock(conn);
 
 	/**
 	 * ACK TIMEOUT:
-	 * Check ACK timeouts, if we have unacknowledged segments
+	 * Deliver the segments that are waiting in the RX ring for room in the
+	 * connection RX queue, then check ACK timeouts
 	 */
+	if (conn->rdp.state == RDP_OPEN)
+		csp_rdp_rx_queue_flush(conn);
 	csp_rdp_check_ack(conn);
 
 	/* Wake user task if TX queue is ready for more data */
 	if (conn->rdp.state == RDP_OPEN)
-		if (csp_queue_size(conn->rdp.tx_queue) < (int)conn->rdp.window_size)
+		if (conn->rdp.tx_count < csp_rdp_send_window(conn))
 			if (csp_rdp_seq_before(conn->rdp.snd_nxt - conn->rdp.snd_una, conn->rdp.window_size * 2))
 				csp_bin_sem_post(&conn->rdp.tx_wait);
 
@@ -583,7 +912,7 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 
 		if (rx_header->ack) {
 			/* Store current ack'ed sequence number */
-			conn->rdp.snd_una = rx_header->ack_nr + 1;
+			csp_rdp_tx_acked(conn, rx_header->ack_nr + 1);
 		}
 
 		if (conn->rdp.state == RDP_CLOSE_WAIT || conn->rdp.state == RDP_CLOSED) {
@@ -633,12 +962,14 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 		conn->rdp.rcv_lsa = rx_header->seq_nr;
 
 		/* Store RDP options */
-		conn->rdp.window_size 		= csp_ntoh32(packet->data32[0]);
+		conn->rdp.window_size 		= csp_rdp_window_clamp(csp_ntoh32(packet->data32[0]));
 		conn->rdp.conn_timeout 		= csp_ntoh32(packet->data32[1]);
 		conn->rdp.packet_timeout 	= csp_ntoh32(packet->data32[2]);
 		conn->rdp.delayed_acks 		= csp_ntoh32(packet->data32[3]);
 		conn->rdp.ack_timeout 		= csp_ntoh32(packet->data32[4]);
 		conn->rdp.ack_delay_count 	= csp_ntoh32(packet->data32[5]);
+		csp_rdp_rtt_init(conn);
+		csp_rdp_cwnd_init(conn);
 		csp_log_protocol("RDP: Window Size %u, conn timeout %u, packet timeout %u",
 				conn->rdp.window_size, conn->rdp.conn_timeout, conn->rdp.packet_timeout);
 		csp_log_protocol("RDP: Delayed acks: %u, ack timeout %u, ack each %u packet",
@@ -666,7 +997,7 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 			conn->rdp.rcv_cur = rx_header->seq_nr;
 			conn->rdp.rcv_irs = rx_header->seq_nr;
 			conn->rdp.rcv_lsa = rx_header->seq_nr - 1;
-			conn->rdp.snd_una = rx_header->ack_nr + 1;
+			csp_rdp_tx_acked(conn, rx_header->ack_nr + 1);
 			conn->rdp.ack_timestamp = csp_get_ms();
 			conn->rdp.state = RDP_OPEN;
 
@@ -771,12 +1102,15 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 		}
 
 		/* Store current ack'ed sequence number */
-		conn->rdp.snd_una = rx_header->ack_nr + 1;
+		csp_rdp_tx_acked(conn, rx_header->ack_nr + 1);
 
 		/* We have an EACK */
 		if (rx_header->eak) {
-			if (packet->length > sizeof(rdp_header_t))
+			if (packet->length > sizeof(rdp_header_t)) {
+				csp_conn_lock(conn, CSP_MAX_DELAY);
 				csp_rdp_flush_eack(conn, packet);
+				csp_conn_unlock(conn);
+			}
 			goto discard_open;
 		}
 
@@ -784,8 +1118,12 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 		if (packet->length <= sizeof(rdp_header_t))
 			goto discard_open;
 
-		/* If message is not in sequence, send EACK and store packet */
-		if (rx_header->seq_nr != (uint16_t)(conn->rdp.rcv_cur + 1)) {
+		/* Deliver segments still waiting in the RX ring first */
+		csp_rdp_rx_queue_flush(conn);
+
+		/* If message is not in sequence, send EACK and store packet. A segment that is
+		 * already waiting in the RX ring is a duplicate and is not stored again. */
+		if ((rx_header->seq_nr != (uint16_t)(conn->rdp.rcv_cur + 1)) || csp_rdp_seq_in_rx_queue(conn, rx_header->seq_nr)) {
 			if (csp_rdp_rx_queue_add(conn, packet, rx_header->seq_nr) != CSP_QUEUE_OK) {
 				csp_log_protocol("Duplicate sequence number");
 				goto discard_open;
@@ -804,14 +1142,19 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 		/* Update last received packet */
 		conn->rdp.rcv_cur = seq_nr;
 
-		/* Only ACK the message if there is room for a full window in the RX buffer.
-		 * Unacknowledged segments are ACKed by csp_rdp_check_timeouts when the buffer is
-		 * no longer full. */
-		csp_rdp_check_ack(conn);
-
 		/* Flush RX queue */
 		csp_rdp_rx_queue_flush(conn);
 
+		/* Only ACK the message if there is room for a full window in the RX buffer.
+		 * Unacknowledged segments are ACKed by csp_rdp_check_timeouts when the buffer is
+		 * no longer full. A segment that filled a gap is ACKed without delay, the sender
+		 * is waiting for the recovery to be confirmed (RFC 5681). */
+		if ((conn->rdp.rcv_cur != seq_nr) && csp_rdp_rx_avail(conn)) {
+			csp_rdp_send_cmp(conn, NULL, RDP_ACK, conn->rdp.snd_nxt, conn->rdp.rcv_cur);
+		} else {
+			csp_rdp_check_ack(conn);
+		}
+
 		goto accepted_open;
 
 	}
@@ -833,7 +1176,7 @@ void csp_rdp_new_packet(csp_conn_t * conn, csp_packet_t * packet) {
 		}
 
 		/* Store current ack'ed sequence number */
-		conn->rdp.snd_una = rx_header->ack_nr + 1;
+		csp_rdp_tx_acked(conn, rx_header->ack_nr + 1);
 
 		/* Send back a reset */
 		csp_rdp_send_cmp(conn, NULL, RDP_ACK | RDP_RST, conn->rdp.snd_nxt, conn->rdp.rcv_cur);
@@ -873,6 +1216,7 @@ int csp_rdp_connect(csp_conn_t * conn, uint32_t timeout) {
 	conn->rdp.ack_timeout 	  = csp_rdp_ack_timeout;
 	conn->rdp.ack_delay_count = csp_rdp_ack_delay_count;
 	conn->rdp.ack_timestamp   = csp_get_ms();
+	csp_rdp_rtt_init(conn);
 
 retry:
 	csp_log_protocol("RDP: Active connect, conn state %u", conn->rdp.state);
@@ -887,6 +1231,7 @@ retry:
 
 	conn->rdp.snd_nxt = conn->rdp.snd_iss + 1;
 	conn->rdp.snd_una = conn->rdp.snd_iss;
+	csp_rdp_cwnd_init(conn);
 
 	csp_log_protocol("RDP: AC: Sending SYN");
 
@@ -936,7 +1281,7 @@ int csp_rdp_send(csp_conn_t * conn, csp_packet_t * packet, uint32_t timeout) {
 	}
 
 	/* If TX window is full, wait here */
-	while (csp_rdp_seq_after(conn->rdp.snd_nxt, conn->rdp.snd_una + (uint16_t)conn->rdp.window_size)) {
+	while (csp_rdp_seq_after(conn->rdp.snd_nxt, conn->rdp.snd_una + (uint16_t)csp_rdp_send_window(conn))) {
 		csp_log_protocol("RDP: Waiting for window update before sending seq %u", conn->rdp.snd_nxt);
 		csp_bin_sem_wait(&conn->rdp.tx_wait, 0);
 		if ((csp_bin_sem_wait(&conn->rdp.tx_wait, conn->rdp.conn_timeout)) != CSP_SEMAPHORE_OK) {
@@ -956,7 +1301,7 @@ int csp_rdp_send(csp_conn_t * conn, csp_packet_t * packet, uint32_t timeout) {
 	tx_header->seq_nr = csp_hton16(conn->rdp.snd_nxt);
 	tx_header->ack = 1;
 
-	/* Send copy to tx_queue */
+	/* Send copy to tx_ring */
 	rdp_packet_t * rdp_packet = csp_buffer_clone(packet);
 	if (rdp_packet == NULL) {
 		csp_log_error("Failed to allocate packet buffer");
@@ -965,11 +1310,14 @@ int csp_rdp_send(csp_conn_t * conn, csp_packet_t * packet, uint32_t timeout) {
 
 	rdp_packet->timestamp = csp_get_ms();
 	rdp_packet->quarantine = 0;
-	if (csp_queue_enqueue(conn->rdp.tx_queue, &rdp_packet, 0) != CSP_QUEUE_OK) {
+	csp_conn_lock(conn, CSP_MAX_DELAY);
+	if (csp_rdp_tx_add(conn, rdp_packet, conn->rdp.snd_nxt) != CSP_ERR_NONE) {
+		csp_conn_unlock(conn);
 		csp_log_error("No more space in RDP retransmit queue");
 		csp_buffer_free(rdp_packet);
 		return CSP_ERR_NOBUFS;
 	}
+	csp_conn_unlock(conn);
 
 	csp_log_protocol("RDP: Sending  in S %u: syn %u, ack %u, eack %u, "
 				"rst %u, seq_nr %5u, ack_nr %5u, packet_len %u (%u)",
@@ -990,6 +1338,7 @@ int csp_rdp_allocate(csp_conn_t * conn) {
 	conn->rdp.state = RDP_CLOSED;
 	conn->rdp.conn_timeout = csp_rdp_conn_timeout;
 	conn->rdp.packet_timeout = csp_rdp_packet_timeout;
+	csp_rdp_rtt_init(conn);
 
 	/* Create a binary semaphore to wait on for tasks */
 	if (csp_bin_sem_create(&conn->rdp.tx_wait) != CSP_SEMAPHORE_OK) {
@@ -997,22 +1346,15 @@ int csp_rdp_allocate(csp_conn_t * conn) {
 		return CSP_ERR_NOMEM;
 	}
 
-	/* Create TX queue */
-	conn->rdp.tx_queue = csp_queue_create(CSP_RDP_MAX_WINDOW, sizeof(csp_packet_t *));
-	if (conn->rdp.tx_queue == NULL) {
-		csp_log_error("Failed to create TX queue for conn");
-		csp_bin_sem_remove(&conn->rdp.tx_wait);
-		return CSP_ERR_NOMEM;
-	}
+	/* Empty TX ring */
+	memset(conn->rdp.tx_ring, 0, sizeof(conn->rdp.tx_ring));
+	conn->rdp.tx_head = RDP_TX_NONE;
+	conn->rdp.tx_tail = RDP_TX_NONE;
+	conn->rdp.tx_count = 0;
 
-	/* Create RX queue */
-	conn->rdp.rx_queue = csp_queue_create(CSP_RDP_MAX_WINDOW * 2, sizeof(csp_packet_t *));
-	if (conn->rdp.rx_queue == NULL) {
-		csp_log_error("Failed to create RX queue for conn");
-		csp_bin_sem_remove(&conn->rdp.tx_wait);
-		csp_queue_remove(conn->rdp.tx_queue);
-		return CSP_ERR_NOMEM;
-	}
+	/* Empty RX ring */
+	memset(conn->rdp.rx_ring, 0, sizeof(conn->rdp.rx_ring));
+	conn->rdp.rx_count = 0;
 
 	return CSP_ERR_NONE;
 
@@ -1051,7 +1393,7 @@ int csp_rdp_close(csp_conn_t * conn) {
 void csp_rdp_set_opt(unsigned int window_size, unsigned int conn_timeout_ms,
 		unsigned int packet_timeout_ms, unsigned int delayed_acks,
 		unsigned int ack_timeout, unsigned int ack_delay_count) {
-	csp_rdp_window_size = window_size;
+	csp_rdp_window_size = csp_rdp_window_clamp(window_size);
 	csp_rdp_conn_timeout = conn_timeout_ms;
 	csp_rdp_packet_timeout = packet_timeout_ms;
 	csp_rdp_delayed_acks = delayed_acks;
@@ -1085,6 +1427,9 @@ void csp_rdp_conn_print(csp_conn_t * conn) {
 
 	printf("\tRDP: State %"PRIu16", rcv %"PRIu16", snd %"PRIu16", win %"PRIu32"\r\n",
 			conn->rdp.state, conn->rdp.rcv_cur, conn->rdp.snd_una, conn->rdp.window_size);
+	printf("\tRDP: cwnd %"PRIu32", ssthresh %"PRIu32"\r\n", conn->rdp.cwnd, conn->rdp.ssthresh);
+	printf("\tRDP: srtt %"PRIu32", rttvar %"PRIu32", rto %"PRIu32" ms, retransmits %"PRIu32"\r\n",
+			conn->rdp.srtt >> 3, conn->rdp.rttvar >> 2, conn->rdp.rto, conn->rdp.retransmits);
 
 }
 #endif
@@ -0,0 +1,62 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SIM_HL_CAN_H_
+#define _SIM_HL_CAN_H_
+
+/* Host stand-in for the HALCoGen HL_can.h, see sim_halcogen.h */
+
+#include "sim_halcogen.h"
+
+typedef volatile struct {
+	uint32 ES;
+	uint32 INT;
+	uint32 TXRQx[4];
+	uint32 NWDATx[4];
+	uint32 INTPNDx[4];
+	uint8 IF1NO;
+	uint8 IF1STAT;
+	uint8 IF1CMD;
+	uint32 IF1MSK;
+	uint32 IF1ARB;
+	uint32 IF1MCTL;
+	uint8 IF1DATx[8];
+	uint8 IF2NO;
+	uint8 IF2STAT;
+	uint8 IF2CMD;
+	uint32 IF2MSK;
+	uint32 IF2ARB;
+	uint32 IF2MCTL;
+	uint8 IF2DATx[8];
+} canBASE_t;
+
+extern canBASE_t sim_can;
+
+#define canREG2		(&sim_can)
+
+#define CAN_IF1_START(node, box)	sim_can_if_start(node, 1, box)
+#define CAN_IF2_START(node, box)	sim_can_if_start(node, 2, box)
+
+void sim_can_if_start(canBASE_t * node, int interface, uint32 box);
+
+void canInit(void);
+uint32 canIsTxMessagePending(canBASE_t * node, uint32 messageBox);
+
+#endif /* _SIM_HL_CAN_H_ */
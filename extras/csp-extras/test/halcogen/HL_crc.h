@@ -0,0 +1,64 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SIM_HL_CRC_H_
+#define _SIM_HL_CRC_H_
+
+/* Host stand-in for the HALCoGen HL_crc.h, see sim_halcogen.h */
+
+#include "sim_halcogen.h"
+
+typedef struct {
+	uint32 CTRL0;
+	uint32 CTRL2;
+	uint32 STATUS;
+	uint32 PSA_SIGREGL1;
+	uint32 PSA_SIGREGH1;
+	uint32 PSA_SECSIGREGL1;
+	uint32 PSA_SECSIGREGH1;
+} crcBASE_t;
+
+typedef struct crcConfig {
+	uint32 crc_channel;
+	uint32 mode;
+	uint32 pcount;
+	uint32 scount;
+	uint32 wdg_preload;
+	uint32 block_preload;
+} crcConfig_t;
+
+extern crcBASE_t sim_crc;
+
+#define crcREG1		(&sim_crc)
+
+#define CRC_CH1		0x00000000U
+#define CRC_CH1_CC	0x00000001U
+
+#define CRC_SEMI_CPU	0x00000002U
+#define CRC_FULL_CPU	0x00000003U
+
+#define CRC_PSA_WRITE(word)	sim_crc_psa_write(word)
+
+void crcSetConfig(crcBASE_t * crc, crcConfig_t * param);
+uint64 crcGetPSASig(crcBASE_t * crc, uint32 channel);
+uint64 crcGetSectorSig(crcBASE_t * crc, uint32 channel);
+void crcChannelReset(crcBASE_t * crc, uint32 channel);
+
+#endif /* _SIM_HL_CRC_H_ */
@@ -0,0 +1,78 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SIM_HL_SYS_DMA_H_
+#define _SIM_HL_SYS_DMA_H_
+
+/* Host stand-in for the HALCoGen HL_sys_dma.h, see sim_halcogen.h */
+
+#include "sim_halcogen.h"
+
+typedef struct {
+	uint32 HWCHENAS;
+	uint32 HWCHENAR;
+	uint32 SWCHENAS;
+	uint32 SWCHENAR;
+} dmaBASE_t;
+
+typedef struct dmaCTRLPKT {
+	uint32 SADD;
+	uint32 DADD;
+	uint32 CHCTRL;
+	uint32 FRCNT;
+	uint32 ELCNT;
+	uint32 ELDOFFSET;
+	uint32 ELSOFFSET;
+	uint32 FRDOFFSET;
+	uint32 FRSOFFSET;
+	uint32 PORTASGN;
+	uint32 RDSIZE;
+	uint32 WRSIZE;
+	uint32 TTYPE;
+	uint32 ADDMODERD;
+	uint32 ADDMODEWR;
+	uint32 AUTOINIT;
+} g_dmaCTRL;
+
+typedef enum {
+	DMA_CH0, DMA_CH1, DMA_CH2, DMA_CH3, DMA_CH4, DMA_CH5, DMA_CH6, DMA_CH7,
+	DMA_CH8, DMA_CH9, DMA_CH10, DMA_CH11, DMA_CH12, DMA_CH13, DMA_CH14, DMA_CH15,
+} dmaChannel_t;
+
+typedef enum {
+	DMA_HW,
+	DMA_SW,
+} dmaTriggerType_t;
+
+#define PORTA_READ_PORTB_WRITE	0x1U
+#define ACCESS_64_BIT		3U
+#define BLOCK_TRANSFER		1U
+#define ADDR_FIXED		0U
+#define ADDR_INC1		1U
+#define AUTOINIT_OFF		0U
+
+extern dmaBASE_t sim_dma;
+
+#define dmaREG		(&sim_dma)
+
+void dmaSetCtrlPacket(dmaChannel_t channel, g_dmaCTRL g_dmaCTRLPKT);
+void dmaSetChEnable(dmaChannel_t channel, dmaTriggerType_t type);
+
+#endif /* _SIM_HL_SYS_DMA_H_ */
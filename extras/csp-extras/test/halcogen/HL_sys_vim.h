@@ -0,0 +1,38 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SIM_HL_SYS_VIM_H_
+#define _SIM_HL_SYS_VIM_H_
+
+/* Host stand-in for the HALCoGen HL_sys_vim.h, see sim_halcogen.h */
+
+#include "sim_halcogen.h"
+
+typedef void (*t_isrFuncPTR)(void);
+
+typedef enum {
+	SYS_IRQ = 0U,
+	SYS_FIQ = 1U,
+} systemInterrupt_t;
+
+void vimChannelMap(uint32 request, uint32 channel, t_isrFuncPTR handler);
+void vimEnableInterrupt(uint32 channel, systemInterrupt_t inttype);
+
+#endif /* _SIM_HL_SYS_VIM_H_ */
@@ -0,0 +1,2 @@
+/* Host stand-in for the FreeRTOS os_task.h, see FreeRTOS.h */
+#include "FreeRTOS.h"
@@ -0,0 +1,342 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Register simulator of the DCAN, see sim_halcogen.h. Message objects are
+ * transferred through the IF1 and IF2 registers and frames are accepted into
+ * the lowest numbered matching object without new data, continuing past
+ * objects with new data and EoB clear as the DCAN does for a FIFO.
+ * Transmission requests are sent at once, lowest message number first, or
+ * one frame per sim_can_bus_send() call while sim_can_bus_hold is set.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "HL_can.h"
+#include "HL_sys_vim.h"
+
+#define OBJECTS		64
+
+#define IFCMD_WR	0x80U
+#define IFCMD_MASK	0x40U
+#define IFCMD_ARB	0x20U
+#define IFCMD_CONTROL	0x10U
+#define IFCMD_CLRINTPND	0x08U
+#define IFCMD_NEWDAT	0x04U
+#define IFCMD_DATAA	0x02U
+#define IFCMD_DATAB	0x01U
+
+#define ARB_MSGVAL	0x80000000U
+#define ARB_XTD		0x40000000U
+#define ARB_DIR		0x20000000U
+#define MSK_MXTD	0x80000000U
+#define MSK_MDIR	0x40000000U
+#define MCTL_NEWDAT	0x00008000U
+#define MCTL_MSGLST	0x00004000U
+#define MCTL_INTPND	0x00002000U
+#define MCTL_UMASK	0x00001000U
+#define MCTL_TXIE	0x00000800U
+#define MCTL_RXIE	0x00000400U
+#define MCTL_TXRQST	0x00000100U
+#define MCTL_EOB	0x00000080U
+#define MCTL_DLC	0x0000000FU
+#define ID_MASK		0x1FFFFFFFU
+
+/* Data register layout, as the driver addresses it */
+#if ((__little_endian__ == 1) || (__LITTLE_ENDIAN__ == 1))
+#define DATA_INDEX(i)	(i)
+#else
+static const uint8 data_order[8] = {3U, 2U, 1U, 0U, 7U, 6U, 5U, 4U};
+#define DATA_INDEX(i)	(data_order[i])
+#endif
+
+typedef struct {
+	uint32 arb;
+	uint32 msk;
+	uint32 mctl;
+	uint8 data[8];
+} sim_object_t;
+
+canBASE_t sim_can;
+sim_can_stats_t sim_can_stats;
+void (*sim_can_tx)(uint32 id, const uint8 * data, uint8 dlc);
+void (*sim_can_if_hook)(int interface, uint32 box);
+int sim_can_bus_hold;
+
+static sim_object_t objects[OBJECTS + 1];
+static pthread_mutex_t sim_lock;
+static pthread_once_t sim_lock_once = PTHREAD_ONCE_INIT;
+static t_isrFuncPTR sim_isr;
+static int irq_enabled, irq_masked, in_isr;
+
+static void lock_init(void) {
+
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&sim_lock, &attr);
+
+}
+
+static void lock(void) {
+
+	pthread_once(&sim_lock_once, lock_init);
+	pthread_mutex_lock(&sim_lock);
+
+}
+
+static void unlock(void) {
+
+	pthread_mutex_unlock(&sim_lock);
+
+}
+
+/* Status registers follow the message objects */
+static void update(void) {
+
+	uint32 box, bit, reg;
+
+	sim_can.INT = 0;
+	for (reg = 0; reg < 4; reg++) {
+		sim_can.TXRQx[reg] = 0;
+		sim_can.NWDATx[reg] = 0;
+		sim_can.INTPNDx[reg] = 0;
+	}
+
+	for (box = OBJECTS; box >= 1; box--) {
+		reg = (box - 1) >> 5;
+		bit = 1U << ((box - 1) & 0x1F);
+		if (objects[box].mctl & MCTL_TXRQST)
+			sim_can.TXRQx[reg] |= bit;
+		if (objects[box].mctl & MCTL_NEWDAT)
+			sim_can.NWDATx[reg] |= bit;
+		if (objects[box].mctl & MCTL_INTPND) {
+			sim_can.INTPNDx[reg] |= bit;
+			sim_can.INT = box;
+		}
+	}
+
+}
+
+/* Run the interrupt handler until no interrupt is pending */
+static void irq(void) {
+
+	if ((sim_isr == NULL) || !irq_enabled || irq_masked || in_isr)
+		return;
+
+	in_isr = 1;
+	while (sim_can.INT != 0) {
+		sim_can_stats.interrupts++;
+		sim_isr();
+	}
+	in_isr = 0;
+
+}
+
+/* Send the lowest numbered pending object, returns its DLC or -1 */
+static int transmit_one(void) {
+
+	sim_object_t * obj;
+	uint32 box;
+
+	for (box = 1; box <= OBJECTS; box++) {
+		obj = &objects[box];
+		if (!(obj->mctl & MCTL_TXRQST) || !(obj->arb & ARB_MSGVAL))
+			continue;
+		if (sim_can_tx != NULL)
+			sim_can_tx(obj->arb & ID_MASK, obj->data, obj->mctl & MCTL_DLC);
+		sim_can_stats.transmitted++;
+		obj->mctl &= ~(MCTL_TXRQST | MCTL_NEWDAT);
+		if (obj->mctl & MCTL_TXIE)
+			obj->mctl |= MCTL_INTPND;
+		return obj->mctl & MCTL_DLC;
+	}
+
+	return -1;
+
+}
+
+static void transmit(void) {
+
+	if (sim_can_bus_hold)
+		return;
+
+	while (transmit_one() >= 0)
+		;
+
+}
+
+void sim_can_if_start(canBASE_t * node, int interface, uint32 box) {
+
+	volatile uint8 * cmd = (interface == 1) ? &node->IF1CMD : &node->IF2CMD;
+	volatile uint32 * msk = (interface == 1) ? &node->IF1MSK : &node->IF2MSK;
+	volatile uint32 * arb = (interface == 1) ? &node->IF1ARB : &node->IF2ARB;
+	volatile uint32 * mctl = (interface == 1) ? &node->IF1MCTL : &node->IF2MCTL;
+	volatile uint8 * data = (interface == 1) ? node->IF1DATx : node->IF2DATx;
+	sim_object_t * obj;
+	int i;
+
+	if ((box < 1) || (box > OBJECTS))
+		return;
+
+	lock();
+	obj = &objects[box];
+	sim_can_stats.if_transfers++;
+
+	if (*cmd & IFCMD_WR) {
+		if (*cmd & IFCMD_MASK)
+			obj->msk = *msk;
+		if (*cmd & IFCMD_ARB)
+			obj->arb = *arb;
+		if (*cmd & IFCMD_CONTROL)
+			obj->mctl = *mctl;
+		if (*cmd & IFCMD_NEWDAT)
+			obj->mctl |= MCTL_TXRQST;
+		for (i = 0; i < 8; i++)
+			if (*cmd & ((i < 4) ? IFCMD_DATAA : IFCMD_DATAB))
+				obj->data[i] = data[DATA_INDEX(i)];
+	} else {
+		if (*cmd & IFCMD_MASK)
+			*msk = obj->msk;
+		if (*cmd & IFCMD_ARB)
+			*arb = obj->arb;
+		if (*cmd & IFCMD_CONTROL)
+			*mctl = obj->mctl;
+		for (i = 0; i < 8; i++)
+			if (*cmd & ((i < 4) ? IFCMD_DATAA : IFCMD_DATAB))
+				data[DATA_INDEX(i)] = obj->data[i];
+		if (*cmd & IFCMD_CLRINTPND)
+			obj->mctl &= ~MCTL_INTPND;
+		if (*cmd & IFCMD_NEWDAT)
+			obj->mctl &= ~MCTL_NEWDAT;
+	}
+
+	transmit();
+	update();
+	if (sim_can_if_hook != NULL)
+		sim_can_if_hook(interface, box);
+	irq();
+	unlock();
+
+}
+
+static int accepts(const sim_object_t * obj, uint32 id) {
+
+	uint32 mask = ID_MASK;
+
+	if (!(obj->arb & ARB_MSGVAL) || (obj->arb & ARB_DIR) || !(obj->arb & ARB_XTD))
+		return 0;
+	if (obj->mctl & MCTL_UMASK)
+		mask = obj->msk & ID_MASK;
+
+	return ((id ^ obj->arb) & mask) == 0;
+
+}
+
+void sim_can_receive(uint32 id, const uint8 * data, uint8 dlc) {
+
+	sim_object_t * obj;
+	uint32 box;
+
+	lock();
+	sim_can_stats.received++;
+
+	for (box = 1; box <= OBJECTS; box++) {
+		obj = &objects[box];
+		if (!accepts(obj, id))
+			continue;
+		/* A FIFO object with new data passes the frame on */
+		if ((obj->mctl & MCTL_NEWDAT) && !(obj->mctl & MCTL_EOB))
+			continue;
+		if (obj->mctl & MCTL_NEWDAT) {
+			obj->mctl |= MCTL_MSGLST;
+			sim_can_stats.overwritten++;
+		}
+		obj->arb = (obj->arb & ~ID_MASK) | (id & ID_MASK);
+		obj->mctl = (obj->mctl & ~MCTL_DLC) | MCTL_NEWDAT | (dlc & MCTL_DLC);
+		if (obj->mctl & MCTL_RXIE)
+			obj->mctl |= MCTL_INTPND;
+		memcpy(obj->data, data, (dlc < 8) ? dlc : 8);
+		break;
+	}
+
+	if (box > OBJECTS)
+		sim_can_stats.filtered++;
+
+	update();
+	irq();
+	unlock();
+
+}
+
+int sim_can_bus_send(void) {
+
+	int dlc;
+
+	lock();
+	dlc = transmit_one();
+	update();
+	irq();
+	unlock();
+
+	return dlc;
+
+}
+
+void sim_can_mask_irq(int masked) {
+
+	lock();
+	irq_masked = masked;
+	irq();
+	unlock();
+
+}
+
+void canInit(void) {
+
+	lock();
+	memset(objects, 0, sizeof(objects));
+	update();
+	unlock();
+
+}
+
+uint32 canIsTxMessagePending(canBASE_t * node, uint32 messageBox) {
+
+	return node->TXRQx[(messageBox - 1U) >> 5U] & (1U << ((messageBox - 1U) & 0x1FU));
+
+}
+
+void vimChannelMap(uint32 request, uint32 channel, t_isrFuncPTR handler) {
+
+	sim_isr = handler;
+
+}
+
+void vimEnableInterrupt(uint32 channel, systemInterrupt_t inttype) {
+
+	lock();
+	irq_enabled = 1;
+	irq();
+	unlock();
+
+}
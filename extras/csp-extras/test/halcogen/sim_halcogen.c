@@ -0,0 +1,199 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Register simulator of the TMS570 CRC module and DMA, see sim_halcogen.h.
+ * The module is big-endian, a 64-bit word holds the bytes in memory order
+ * from the most significant byte.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "HL_crc.h"
+#include "HL_sys_dma.h"
+
+crcBASE_t sim_crc;
+dmaBASE_t sim_dma;
+sim_stats_t sim_stats;
+int sim_dma_stall;
+
+static uint64 psa_sig;
+static g_dmaCTRL dma_packet[16];
+static uint32 dma_enabled;
+
+void * sim_alloc32(size_t size) {
+
+	void * mem;
+
+#ifdef MAP_32BIT
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+#else
+	mem = malloc(size);
+#endif
+
+	if ((uintptr_t) mem + size > 0x100000000ULL)
+		return NULL;
+
+	return mem;
+
+}
+
+/* The PSA update as given in the TRM, one data bit at a time:
+ * next(0) = sig(63) ^ d, next(1, 3, 4) = sig(j - 1) ^ sig(63) ^ d,
+ * next(j) = sig(j - 1) otherwise */
+static uint64 psa_update(uint64 sig, uint64 data) {
+
+	uint64 next, d, top;
+	int i, j;
+
+	for (i = 63; i >= 0; i--) {
+		d = (data >> i) & 1U;
+		top = (sig >> 63) & 1U;
+		next = top ^ d;
+		for (j = 1; j < 64; j++) {
+			if ((j == 1) || (j == 3) || (j == 4))
+				next |= (((sig >> (j - 1)) & 1U) ^ top ^ d) << j;
+			else
+				next |= ((sig >> (j - 1)) & 1U) << j;
+		}
+		sig = next;
+	}
+
+	return sig;
+
+}
+
+static uint64 load_be64(const uint8_t * bytes) {
+
+	uint64 word = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		word = (word << 8) | bytes[i];
+
+	return word;
+
+}
+
+/* Apply the SW channel enable reset register written by the driver */
+static void dma_sync(void) {
+
+	dma_enabled &= ~sim_dma.SWCHENAR;
+	sim_dma.SWCHENAR = 0;
+	sim_dma.SWCHENAS = dma_enabled;
+
+}
+
+void sim_crc_psa_write(uint64 word) {
+
+	uint8_t bytes[8];
+
+	/* The driver wrote the word as the CPU holds it */
+	memcpy(bytes, &word, sizeof(bytes));
+	psa_sig = psa_update(psa_sig, load_be64(bytes));
+	sim_stats.psa_writes++;
+
+}
+
+void crcSetConfig(crcBASE_t * crc, crcConfig_t * param) {
+
+	crcChannelReset(crc, param->crc_channel);
+	crc->CTRL2 = param->mode;
+	/* CTRL2, CTRL0 twice, PCOUNT, SCOUNT, WDTOPLD, BCTOPLD, CTRL2 */
+	sim_stats.reg_writes += 8;
+
+}
+
+/* HALCoGen returns the low register in the upper half */
+uint64 crcGetPSASig(crcBASE_t * crc, uint32 channel) {
+
+	crc->PSA_SIGREGL1 = (uint32) (psa_sig >> 32);
+	crc->PSA_SIGREGH1 = (uint32) psa_sig;
+	sim_stats.reg_reads += 2;
+
+	return ((uint64) crc->PSA_SIGREGL1 << 32) | crc->PSA_SIGREGH1;
+
+}
+
+uint64 crcGetSectorSig(crcBASE_t * crc, uint32 channel) {
+
+	sim_stats.reg_reads += 2;
+
+	return ((uint64) crc->PSA_SECSIGREGL1 << 32) | crc->PSA_SECSIGREGH1;
+
+}
+
+void crcChannelReset(crcBASE_t * crc, uint32 channel) {
+
+	int ch;
+
+	dma_sync();
+	for (ch = 0; ch < 16; ch++)
+		if ((dma_enabled & (1U << ch)) && (dma_packet[ch].DADD == (uint32) (uintptr_t) &crc->PSA_SIGREGL1))
+			sim_stats.reset_while_dma++;
+
+	psa_sig = 0;
+	crc->STATUS = 0;
+	sim_stats.reg_writes += 2;
+
+}
+
+void dmaSetCtrlPacket(dmaChannel_t channel, g_dmaCTRL g_dmaCTRLPKT) {
+
+	dma_packet[channel] = g_dmaCTRLPKT;
+	/* ISADDR, IDADDR, ITCOUNT, CHCTRL, EIOFF, FIOFF, PARx */
+	sim_stats.reg_writes += 7;
+
+}
+
+void dmaSetChEnable(dmaChannel_t channel, dmaTriggerType_t type) {
+
+	g_dmaCTRL * packet = &dma_packet[channel];
+	const uint8_t * src;
+	uint32 i;
+
+	dma_sync();
+	dma_enabled |= 1U << channel;
+	sim_dma.SWCHENAS = dma_enabled;
+	sim_stats.reg_writes++;
+
+	if (sim_dma_stall)
+		return;
+
+	/* A block transfer of 64-bit words into the PSA register, compressed as
+	 * one sector */
+	src = (const uint8_t *) (uintptr_t) packet->SADD;
+	psa_sig = 0;
+	for (i = 0; i < packet->ELCNT * packet->FRCNT; i++)
+		psa_sig = psa_update(psa_sig, load_be64(&src[i * 8]));
+
+	sim_crc.PSA_SECSIGREGL1 = (uint32) (psa_sig >> 32);
+	sim_crc.PSA_SECSIGREGH1 = (uint32) psa_sig;
+	sim_crc.STATUS |= CRC_CH1_CC;
+	dma_enabled &= ~(1U << channel);
+	sim_dma.SWCHENAS = dma_enabled;
+	sim_stats.dma_transfers++;
+	sim_stats.dma_words += i;
+
+}
@@ -0,0 +1,97 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SIM_HALCOGEN_H_
+#define _SIM_HALCOGEN_H_
+
+/*
+ * Register simulator of the TMS570 CRC module, DMA channels and DCAN, so the
+ * drivers in source/drivers run in the host tests. The HL_*.h, FreeRTOS.h
+ * and os_*.h files in this directory stand in for the HALCoGen and FreeRTOS
+ * headers. Pointers passed to the DMA as uint32 must be below 4 GiB, see
+ * sim_alloc32().
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t uint8;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+/* Register accesses by the driver, PSA writes and DMA transfers */
+typedef struct {
+	unsigned long psa_writes;
+	unsigned long reg_writes;
+	unsigned long reg_reads;
+	unsigned long dma_transfers;
+	unsigned long dma_words;
+	/* Channel reset while its DMA channel was still enabled */
+	unsigned long reset_while_dma;
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+
+/* Leave software triggered DMA channels enabled without transferring */
+extern int sim_dma_stall;
+
+/* Memory the DMA can address, the driver casts pointers to uint32 */
+void * sim_alloc32(size_t size);
+
+/* PSA register of channel 1 */
+void sim_crc_psa_write(uint64 word);
+
+/* DCAN node canREG2. Frames arrive through sim_can_receive() and are
+ * filtered into the message objects as the DCAN does, transmitted frames go
+ * to the tx callback. The interrupt handler mapped with vimChannelMap() runs
+ * when a message object or status interrupt is pending, as if interrupts are
+ * disabled while it runs. */
+typedef struct {
+	unsigned long received;
+	/* No message object accepted the frame */
+	unsigned long filtered;
+	/* Frame overwrote one not yet read */
+	unsigned long overwritten;
+	unsigned long transmitted;
+	unsigned long if_transfers;
+	unsigned long interrupts;
+} sim_can_stats_t;
+
+extern sim_can_stats_t sim_can_stats;
+
+void sim_can_receive(uint32 id, const uint8 * data, uint8 dlc);
+
+/* Hold the interrupt handler back, frames queue up in the message objects */
+void sim_can_mask_irq(int masked);
+
+/* Called with each transmitted frame */
+extern void (*sim_can_tx)(uint32 id, const uint8 * data, uint8 dlc);
+
+/* Keep transmission requests pending until sim_can_bus_send() puts the
+ * lowest numbered one on the bus, as a bus with bit timing would. Returns
+ * the DLC of the frame sent, or -1 when nothing is pending. */
+extern int sim_can_bus_hold;
+int sim_can_bus_send(void);
+
+/* Called after every IFx transfer, e.g. to receive frames while the
+ * interrupt handler runs */
+extern void (*sim_can_if_hook)(int interface, uint32 box);
+
+#endif /* _SIM_HALCOGEN_H_ */
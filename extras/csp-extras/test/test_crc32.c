@@ -0,0 +1,110 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * csp_crc32_memory against a bit at a time CRC32C for every length from 0 to
+ * 4096 bytes at eight alignments. The Makefile links the test once per kernel
+ * of csp_crc32.c (byte-wise, slicing-by-4, slicing-by-8 and the CRC32C
+ * instruction), see CRC32_KERNELS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_crc32.h>
+
+#define MAX_LENGTH	4096
+#define ALIGNMENTS	8
+
+/* Reflected Castagnoli polynomial, one bit per round */
+static uint32_t ref_crc32(const uint8_t * data, uint32_t length) {
+
+	uint32_t crc = 0xFFFFFFFF;
+	int k;
+
+	while (length--) {
+		crc ^= *data++;
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+	}
+
+	return crc ^ 0xFFFFFFFF;
+
+}
+
+int main(void) {
+
+	static uint8_t buf[MAX_LENGTH + ALIGNMENTS];
+	csp_packet_t * packet;
+	uint32_t length, crc;
+	int off, i;
+
+	/* Check value of CRC-32C */
+	crc = csp_crc32_memory((const uint8_t *) "123456789", 9);
+	if (crc != 0xE3069283) {
+		printf("check value %08X, expected E3069283\n", crc);
+		return 1;
+	}
+
+	srand(1);
+	for (i = 0; i < (int) sizeof(buf); i++)
+		buf[i] = rand();
+
+	for (off = 0; off < ALIGNMENTS; off++) {
+		for (length = 0; length <= MAX_LENGTH; length++) {
+			crc = csp_crc32_memory(buf + off, length);
+			if (crc != ref_crc32(buf + off, length)) {
+				printf("length %u offset %d: %08X, expected %08X\n", length, off, crc, ref_crc32(buf + off, length));
+				return 1;
+			}
+		}
+	}
+
+	/* Append and verify round trip, with and without the header */
+	csp_buffer_init(1, 256);
+	packet = csp_buffer_get(256);
+	if (packet == NULL)
+		return 1;
+	for (i = 0; i < 2; i++) {
+		memcpy(packet->data, buf, 200);
+		packet->length = 200;
+		packet->id.ext = 0x12345678;
+		csp_crc32_append(packet, i);
+		if ((packet->length != 204) || (csp_crc32_verify(packet, i) != CSP_ERR_NONE) || (packet->length != 200)) {
+			printf("append/verify failed, include_header %d\n", i);
+			return 1;
+		}
+		packet->data[10] ^= 1;
+		packet->length = 204;
+		if (csp_crc32_verify(packet, i) == CSP_ERR_NONE) {
+			printf("corrupted packet verified, include_header %d\n", i);
+			return 1;
+		}
+	}
+	csp_buffer_free(packet);
+
+	printf("lengths 0-%d at %d alignments match the reference\n", MAX_LENGTH, ALIGNMENTS);
+
+	return 0;
+
+}
@@ -0,0 +1,144 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Reassembly in interfaces/csp_if_can.c. Two nodes forward packets from the
+ * same source at the same time, so the frames of both packets arrive
+ * interleaved with the same CFP source and different CFP identifiers. Both
+ * packets must be received intact. The CAN driver is replaced by can_init
+ * and can_send below.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_endian.h>
+#include <csp/interfaces/csp_if_can.h>
+#include <csp/drivers/can.h>
+
+#define ADDRESS		1
+#define PORT		10
+#define PACKET_SIZE	100
+#define PACKET_FRAMES	((PACKET_SIZE + 6 + 7) / 8)
+
+int can_init(uint32_t id, uint32_t mask, struct csp_can_config *conf) {
+
+	return 0;
+
+}
+
+int can_send(can_id_t id, uint8_t * data, uint8_t dlc) {
+
+	return 0;
+
+}
+
+static void payload(uint8_t * data, int number) {
+
+	int i;
+
+	for (i = 0; i < PACKET_SIZE; i++)
+		data[i] = number * 31 + i;
+
+}
+
+/* CFP frames of one packet, as csp_can_tx sends them */
+static void cfp_build(can_frame_t * cfp, int src, int ident, int number) {
+
+	uint8_t data[PACKET_SIZE];
+	csp_id_t id = {.pri = CSP_PRIO_NORM, .src = src, .dst = ADDRESS, .dport = PORT, .sport = 20};
+	uint32_t id_be = csp_hton32(id.ext);
+	uint16_t length_be = csp_hton16(PACKET_SIZE);
+	int sent = 0, bytes;
+
+	payload(data, number);
+
+	while (sent < PACKET_SIZE) {
+		cfp->id = CFP_MAKE_SRC(src) | CFP_MAKE_DST(ADDRESS) | CFP_MAKE_ID(ident);
+		if (sent == 0) {
+			bytes = 2;
+			memcpy(cfp->data, &id_be, sizeof(id_be));
+			memcpy(cfp->data + 4, &length_be, sizeof(length_be));
+			memcpy(cfp->data + 6, data, bytes);
+			cfp->id |= CFP_MAKE_TYPE(0) | CFP_MAKE_REMAIN((PACKET_SIZE + 6 - 1) / 8);
+			cfp->dlc = 8;
+		} else {
+			bytes = (PACKET_SIZE - sent >= 8) ? 8 : PACKET_SIZE - sent;
+			memcpy(cfp->data, data + sent, bytes);
+			cfp->id |= CFP_MAKE_TYPE(1) | CFP_MAKE_REMAIN((PACKET_SIZE - sent - bytes + 7) / 8);
+			cfp->dlc = bytes;
+		}
+		cfp++;
+		sent += bytes;
+	}
+
+}
+
+int main(void) {
+
+	static can_frame_t cfp[2][PACKET_FRAMES];
+	uint8_t data[PACKET_SIZE];
+	csp_socket_t * sock;
+	csp_packet_t * packet;
+	int received[2] = {0, 0};
+	int i, n;
+
+	csp_debug_set_level(CSP_WARN, 0);
+	csp_buffer_init(10, 256);
+	csp_init(ADDRESS);
+	csp_route_start_task(0, 0);
+	if (csp_can_init(CSP_CAN_MASKED, NULL) != CSP_ERR_NONE) {
+		printf("csp_can_init failed\n");
+		return 1;
+	}
+	sock = csp_socket(CSP_SO_CONN_LESS);
+	csp_bind(sock, PORT);
+
+	/* Source 2 through two forwarders, each with its own CFP identifier */
+	cfp_build(cfp[0], 2, 100, 0);
+	cfp_build(cfp[1], 2, 7, 1);
+	for (i = 0; i < PACKET_FRAMES; i++)
+		for (n = 0; n < 2; n++)
+			csp_can_rx_frame(&cfp[n][i], NULL);
+
+	while ((packet = csp_recvfrom(sock, 1000)) != NULL) {
+		n = (packet->data[0] == 0) ? 0 : 1;
+		payload(data, n);
+		if ((packet->id.src != 2) || (packet->length != PACKET_SIZE) || memcmp(packet->data, data, PACKET_SIZE)) {
+			printf("packet %d corrupted\n", n);
+			return 1;
+		}
+		received[n]++;
+		csp_buffer_free(packet);
+	}
+
+	if ((received[0] != 1) || (received[1] != 1)) {
+		printf("received %d and %d of the forwarded packets, %lu frame errors\n", received[0], received[1],
+				(unsigned long) csp_if_can.frame);
+		return 1;
+	}
+
+	printf("two packets from one source through two forwarders received intact\n");
+
+	return 0;
+
+}
@@ -0,0 +1,212 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * drivers/can/halcogen_can.c against the DCAN register simulator in
+ * test/halcogen: acceptance filtering, frames queued in the message objects
+ * while the interrupt is held back, frames arriving while the interrupt
+ * handler runs, and the TX bank. Received frames are
+ * recorded by csp_can_rx_frame below instead of going to csp_if_can.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/interfaces/csp_if_can.h>
+#include <csp/drivers/can.h>
+
+#include "halcogen/sim_halcogen.h"
+
+#define MAX_FRAMES	512
+
+static can_frame_t rx[MAX_FRAMES];
+static int rx_count;
+static can_frame_t tx[MAX_FRAMES];
+static int tx_count;
+
+int csp_can_rx_frame(can_frame_t * frame, CSP_BASE_TYPE * task_woken) {
+
+	if (rx_count < MAX_FRAMES)
+		rx[rx_count++] = *frame;
+
+	return CSP_ERR_NONE;
+
+}
+
+static void record_tx(uint32 id, const uint8 * data, uint8 dlc) {
+
+	if (tx_count < MAX_FRAMES) {
+		tx[tx_count].id = id;
+		tx[tx_count].dlc = dlc;
+		memcpy(tx[tx_count].data, data, dlc);
+		tx_count++;
+	}
+
+}
+
+static can_id_t frame_id(int src, int dst, int seq) {
+
+	return CFP_MAKE_SRC(src) | CFP_MAKE_DST(dst) | CFP_MAKE_TYPE(1) | CFP_MAKE_REMAIN(seq) | CFP_MAKE_ID(7);
+
+}
+
+static void frame_data(uint8_t * data, int src, int seq) {
+
+	int i;
+
+	for (i = 0; i < 8; i++)
+		data[i] = src * 16 + seq + i;
+
+}
+
+/* Delivers the next frame of a source on every second transfer of the
+ * interrupt handler, so frames arrive between reading one object and the
+ * next, while the handler still keeps up */
+static int inject_src, inject_seq, inject_count, inject_transfers;
+
+static void inject(int interface, uint32 box) {
+
+	uint8_t data[8];
+	int seq;
+
+	if ((interface != 2) || (inject_seq >= inject_count) || (++inject_transfers % 2 != 0))
+		return;
+
+	seq = inject_seq++;
+	frame_data(data, inject_src, seq);
+	sim_can_receive(frame_id(inject_src, 1, seq), data, 6);
+
+}
+
+/* Frames recorded from src in the order they were sent */
+static int check_rx(int src, int count, int dlc) {
+
+	uint8_t data[8];
+	int i, seq = 0;
+
+	for (i = 0; i < rx_count; i++) {
+		if (CFP_SRC(rx[i].id) != (uint32_t) src)
+			continue;
+		frame_data(data, src, seq);
+		if ((rx[i].id != frame_id(src, 1, seq)) || (rx[i].dlc != dlc) || memcmp(rx[i].data, data, dlc)) {
+			printf("source %d: frame %d of %d wrong or out of order\n", src, seq, count);
+			return 1;
+		}
+		seq++;
+	}
+
+	if (seq != count) {
+		printf("source %d: %d of %d frames received\n", src, seq, count);
+		return 1;
+	}
+
+	return 0;
+
+}
+
+int main(void) {
+
+	uint8_t data[8];
+	int src, seq, i;
+
+	sim_can_tx = record_tx;
+
+	/* Masked mode, frames for node 1 only */
+	if (can_init(CFP_MAKE_DST(1), CFP_MAKE_DST((1 << CFP_HOST_SIZE) - 1), NULL) != 0) {
+		printf("can_init failed\n");
+		return 1;
+	}
+
+	/* One frame per source and data length, received as they arrive */
+	for (seq = 0; seq <= 8; seq++) {
+		for (src = 0; src < (1 << CFP_HOST_SIZE); src++) {
+			frame_data(data, src, seq);
+			sim_can_receive(frame_id(src, 1, seq), data, 8);
+			sim_can_receive(frame_id(src, 2, seq), data, 8);
+		}
+	}
+	for (src = 0; src < (1 << CFP_HOST_SIZE); src++)
+		if (check_rx(src, 9, 8))
+			return 1;
+	if (sim_can_stats.filtered != 9 * (1 << CFP_HOST_SIZE)) {
+		printf("%lu frames for other nodes passed the filter\n", 9 * (1 << CFP_HOST_SIZE) - sim_can_stats.filtered);
+		return 1;
+	}
+
+	/* A burst while the interrupt is held back fills the source object and
+	 * the FIFO, and is read oldest first */
+	rx_count = 0;
+	sim_can_mask_irq(1);
+	for (seq = 0; seq < 20; seq++) {
+		frame_data(data, 3, seq);
+		sim_can_receive(frame_id(3, 1, seq), data, 5);
+		frame_data(data, 4, seq);
+		if (seq < 4)
+			sim_can_receive(frame_id(4, 1, seq), data, 5);
+	}
+	sim_can_mask_irq(0);
+	if (check_rx(3, 20, 5) || check_rx(4, 4, 5))
+		return 1;
+
+	/* Frames keep arriving while the source object and the FIFO are read,
+	 * the source object must not overtake the FIFO */
+	rx_count = 0;
+	sim_can_mask_irq(1);
+	for (seq = 0; seq < 3; seq++) {
+		frame_data(data, 5, seq);
+		sim_can_receive(frame_id(5, 1, seq), data, 6);
+	}
+	inject_src = 5;
+	inject_seq = 3;
+	inject_count = 100;
+	sim_can_if_hook = inject;
+	sim_can_mask_irq(0);
+	while (inject_seq < inject_count) {
+		seq = inject_seq++;
+		frame_data(data, 5, seq);
+		sim_can_receive(frame_id(5, 1, seq), data, 6);
+	}
+	sim_can_if_hook = NULL;
+	if (check_rx(5, inject_count, 6))
+		return 1;
+
+	/* TX bank, frames leave in order with their own length */
+	for (i = 0; i < 40; i++) {
+		frame_data(data, 9, i);
+		if (can_send(frame_id(1, 9, i), data, i % 9) != 0) {
+			printf("can_send failed at frame %d\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < 40; i++) {
+		frame_data(data, 9, i);
+		if ((tx[i].id != frame_id(1, 9, i)) || (tx[i].dlc != i % 9) || memcmp(tx[i].data, data, i % 9)) {
+			printf("transmitted frame %d wrong or out of order\n", i);
+			return 1;
+		}
+	}
+
+	printf("filtering, %d frames queued while held back, %d arriving during the interrupt and %d transmitted frames in order\n",
+			24, inject_count, tx_count);
+
+	return 0;
+
+}
@@ -0,0 +1,163 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * crc_hash of drivers/crc/halcogen_crc.c against the register simulator in
+ * test/halcogen. The hash must not depend on how it was calculated: before
+ * crc_init() in software, by the CPU writing the PSA register, by the DMA,
+ * and in software after a DMA transfer that did not complete. The Makefile
+ * builds the test with the DMA disabled and with CRC_DMA_MIN_WORDS 4.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <csp/csp.h>
+#include <csp/drivers/crc.h>
+
+#include "halcogen/sim_halcogen.h"
+
+#define MAX_LENGTH	300
+#define ALIGNMENTS	8
+#define THREADS		4
+
+static uint8_t * buf;
+static uint32_t soft[MAX_LENGTH + 1][ALIGNMENTS];
+
+static int check_all(const char * path) {
+
+	uint32_t length, hash;
+	int off;
+
+	for (length = 0; length <= MAX_LENGTH; length++) {
+		for (off = 0; off < ALIGNMENTS; off++) {
+			hash = crc_hash(buf + off, length);
+			if (hash != soft[length][off]) {
+				printf("%s: length %u offset %d: %08X, software %08X\n", path, length, off, hash, soft[length][off]);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+
+}
+
+static void * hash_thread(void * arg) {
+
+	uintptr_t seed = (uintptr_t) arg;
+	uint32_t length;
+	int i, off;
+
+	for (i = 0; i < 20000; i++) {
+		length = (seed * 7919 + i * 104729) % (MAX_LENGTH + 1);
+		off = (seed + i) % ALIGNMENTS;
+		if (crc_hash(buf + off, length) != soft[length][off])
+			return (void *) 1;
+	}
+
+	return NULL;
+
+}
+
+int main(void) {
+
+	pthread_t tid[THREADS];
+	void * failed;
+	uint8_t * zero;
+	uint32_t length;
+	int off, i, dma;
+
+	buf = sim_alloc32(MAX_LENGTH + 64);
+	if (buf == NULL) {
+		printf("no memory below 4 GiB for the DMA\n");
+		return 1;
+	}
+	/* Eight byte aligned, so the DMA can be used at offset 0 */
+	buf = (uint8_t *) (((uintptr_t) buf + 7) & ~(uintptr_t) 7);
+	srand(1);
+	for (i = 0; i < MAX_LENGTH + ALIGNMENTS; i++)
+		buf[i] = rand();
+
+	/* Software signature before crc_init */
+	for (length = 0; length <= MAX_LENGTH; length++)
+		for (off = 0; off < ALIGNMENTS; off++)
+			soft[length][off] = crc_hash(buf + off, length);
+	if (sim_stats.psa_writes || sim_stats.dma_transfers) {
+		printf("module used before crc_init\n");
+		return 1;
+	}
+
+	/* Zero bytes at the end change the hash */
+	zero = buf + MAX_LENGTH + ALIGNMENTS;
+	memcpy(zero, buf, 16);
+	memset(zero + 16, 0, 16);
+	if (crc_hash(zero, 16) == crc_hash(zero, 24) || crc_hash(zero, 16) == crc_hash(zero, 17)) {
+		printf("trailing zero bytes not hashed\n");
+		return 1;
+	}
+
+	if (crc_init() != 0) {
+		printf("crc_init failed\n");
+		return 1;
+	}
+
+	/* Module, the CPU writes the PSA register or the DMA transfers the words */
+	if (check_all("module"))
+		return 1;
+	dma = (sim_stats.dma_transfers > 0);
+	if (sim_stats.psa_writes == 0) {
+		printf("PSA register not written\n");
+		return 1;
+	}
+
+	/* DMA that never completes, the channel must be stopped before the reset */
+	if (dma) {
+		sim_dma_stall = 1;
+		if (check_all("stalled DMA"))
+			return 1;
+		sim_dma_stall = 0;
+		if (sim_stats.reset_while_dma) {
+			printf("CRC channel reset with the DMA channel enabled %lu times\n", sim_stats.reset_while_dma);
+			return 1;
+		}
+		if (check_all("DMA after stall"))
+			return 1;
+	}
+
+	/* Concurrent callers wait for the module */
+	for (i = 0; i < THREADS; i++)
+		pthread_create(&tid[i], NULL, hash_thread, (void *) (uintptr_t) i);
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(tid[i], &failed);
+		if (failed) {
+			printf("hash changed with %d threads\n", THREADS);
+			return 1;
+		}
+	}
+
+	printf("lengths 0-%d at %d alignments hash the same in software, %s\n", MAX_LENGTH, ALIGNMENTS,
+			dma ? "by the DMA and after a stalled DMA" : "by the CPU");
+
+	return 0;
+
+}
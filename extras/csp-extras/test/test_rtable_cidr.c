@@ -0,0 +1,141 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * The CIDR routing table of csp_rtable_cidr.c: longest prefix match across
+ * overlapping networks, replacing and removing routes, the default route, and
+ * a csp_route_table_save to csp_route_table_load round trip that routes every
+ * node the same way. The Makefile links the table built with
+ * CSP_USE_RTABLE_CIDR ahead of libcsp.a, which has the static table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+
+static csp_iface_t if_a = { .name = "A" };
+static csp_iface_t if_b = { .name = "B" };
+static csp_iface_t if_c = { .name = "C" };
+
+static int failures;
+
+static void expect(uint8_t node, csp_iface_t * ifc, uint8_t mac) {
+
+	csp_iface_t * found = csp_rtable_find_iface(node);
+
+	if ((found != ifc) || ((ifc != NULL) && (csp_rtable_find_mac(node) != mac)) ||
+			((ifc == NULL) && (csp_rtable_find_mac(node) != 255))) {
+		printf("node %u: %s mac %u, expected %s mac %u\n", node, found ? found->name : "none",
+				csp_rtable_find_mac(node), ifc ? ifc->name : "none", ifc ? mac : 255);
+		failures++;
+	}
+
+}
+
+static void expect_result(const char * what, int result, int expected) {
+
+	if (result != expected) {
+		printf("%s returned %d, expected %d\n", what, result, expected);
+		failures++;
+	}
+
+}
+
+int main(void) {
+
+	static uint8_t table[CSP_ROUTE_TABLE_SIZE];
+	csp_iface_t * ifc[CSP_ID_HOST_MAX + 1];
+	uint8_t mac[CSP_ID_HOST_MAX + 1];
+	int node;
+
+	csp_rtable_clear();
+	for (node = 0; node <= CSP_ID_HOST_MAX; node++)
+		expect(node, NULL, 0);
+
+	/* 0/0, 8/2 (8-15), 12/3 (12-15) and the host 13 */
+	expect_result("set 0/0", csp_rtable_set(CSP_DEFAULT_ROUTE, 0, &if_a, 1), CSP_ERR_NONE);
+	expect_result("set 8/2", csp_rtable_set(8, 2, &if_b, 2), CSP_ERR_NONE);
+	expect_result("set 12/3", csp_rtable_set(12, 3, &if_c, 3), CSP_ERR_NONE);
+	expect_result("set 13/5", csp_rtable_set(13, CSP_ID_HOST_SIZE, &if_a, 4), CSP_ERR_NONE);
+	expect_result("set 3/6", csp_rtable_set(3, CSP_ID_HOST_SIZE + 1, &if_a, 5), CSP_ERR_INVAL);
+	for (node = 0; node <= CSP_ID_HOST_MAX; node++) {
+		if (node == 13)
+			expect(node, &if_a, 4);
+		else if ((node >= 12) && (node <= 15))
+			expect(node, &if_c, 3);
+		else if ((node >= 8) && (node <= 15))
+			expect(node, &if_b, 2);
+		else
+			expect(node, &if_a, 1);
+	}
+
+	/* Host bits in the network address are ignored, so this replaces 8/2 */
+	expect_result("set 9/2", csp_rtable_set(9, 2, &if_c, 6), CSP_ERR_NONE);
+	expect(8, &if_c, 6);
+	expect(11, &if_c, 6);
+	expect(12, &if_c, 3);
+
+	/* Nodes of a removed route fall back to the next longest prefix */
+	expect_result("remove 13/5", csp_rtable_remove(13, CSP_ID_HOST_SIZE), CSP_ERR_NONE);
+	expect(13, &if_c, 3);
+	expect_result("remove 12/3", csp_rtable_remove(12, 3), CSP_ERR_NONE);
+	expect(13, &if_c, 6);
+	expect_result("remove 12/3 again", csp_rtable_remove(12, 3), CSP_ERR_INVAL);
+	expect_result("remove 12/4", csp_rtable_remove(12, 4), CSP_ERR_INVAL);
+
+	/* Without the default route only 8/2 is left */
+	expect_result("remove 0/0", csp_rtable_remove(CSP_DEFAULT_ROUTE, 0), CSP_ERR_NONE);
+	expect(0, NULL, 0);
+	expect(16, NULL, 0);
+	expect(10, &if_c, 6);
+	expect_result("set 0/0", csp_rtable_set(0, 0, &if_b, 7), CSP_ERR_NONE);
+	expect(0, &if_b, 7);
+	expect(31, &if_b, 7);
+	expect(10, &if_c, 6);
+
+	/* Round trip through the raw table format */
+	expect_result("set 16/1", csp_rtable_set(16, 1, &if_a, 8), CSP_ERR_NONE);
+	expect_result("set 24/3", csp_rtable_set(24, 3, &if_c, CSP_NODE_MAC), CSP_ERR_NONE);
+	expect_result("set 26/5", csp_rtable_set(26, CSP_ID_HOST_SIZE, &if_b, 9), CSP_ERR_NONE);
+	expect_result("set 1/5", csp_rtable_set(1, CSP_ID_HOST_SIZE, &if_a, 10), CSP_ERR_NONE);
+	for (node = 0; node <= CSP_ID_HOST_MAX; node++) {
+		ifc[node] = csp_rtable_find_iface(node);
+		mac[node] = csp_rtable_find_mac(node);
+	}
+	csp_route_table_save(table);
+	csp_rtable_clear();
+	expect(26, NULL, 0);
+	csp_route_table_load(table);
+	for (node = 0; node <= CSP_ID_HOST_MAX; node++)
+		expect(node, ifc[node], mac[node]);
+
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("longest prefix match, replace, remove, default route and save/load of %d nodes\n", CSP_ID_HOST_MAX + 1);
+
+	return 0;
+
+}
@@ -0,0 +1,247 @@
+/*
+Cubesat Space Protocol - A small network-layer protocol designed for Cubesats
+Copyright (C) 2012 GomSpace ApS (http://www.gomspace.com)
+Copyright (C) 2012 AAUSAT3 Project (http://aausat3.space.aau.dk)
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Resumable SFP transfers, csp_sfp_send_resume to csp_sfp_recv_resume over a
+ * loopback interface that goes down part way through a pass. A transfer cut
+ * several times completes with the data intact, the bytes sent are reported
+ * and the checkpoint is erased. A checkpoint of another transfer id is not
+ * resumed, and a checkpoint that cannot be erased fails the transfer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csp/csp.h>
+#include <csp/csp_interface.h>
+#include <csp/arch/csp_thread.h>
+
+#define PORT		10
+#define SIZE		200000
+#define MTU		200
+#define WINDOW		16
+#define TIMEOUT		300
+
+/* Data bytes a pass gets through before the link goes down */
+#define CUT		40000
+
+/* Loopback that drops everything once cut_at data bytes were sent in a pass */
+static volatile unsigned long pass_bytes, cut_at;
+static unsigned long sent_bytes;
+
+static int link_tx(csp_iface_t * interface, csp_packet_t * packet, uint32_t timeout) {
+
+	if (packet->id.flags & CSP_FFRAG) {
+		pass_bytes += packet->length;
+		sent_bytes += packet->length;
+	}
+
+	if (cut_at && (pass_bytes > cut_at)) {
+		csp_buffer_free(packet);
+		return CSP_ERR_NONE;
+	}
+
+	csp_qfifo_write(packet, interface, NULL);
+	return CSP_ERR_NONE;
+
+}
+
+static csp_iface_t csp_if_link = {
+	.name = "LINK",
+	.nexthop = link_tx,
+};
+
+/* Checkpoint store in memory */
+static struct {
+	uint8_t data[256];
+	uint32_t size;
+	int valid;
+	int fail_erase;
+} mem;
+
+static int mem_load(void * arg, void * data, uint32_t size) {
+
+	if (!mem.valid || (mem.size != size))
+		return -1;
+
+	memcpy(data, mem.data, size);
+	return 0;
+
+}
+
+static int mem_save(void * arg, const void * data, uint32_t size) {
+
+	if (data == NULL) {
+		if (mem.fail_erase)
+			return -1;
+		mem.valid = 0;
+		return 0;
+	}
+
+	if (size > sizeof(mem.data))
+		return -1;
+
+	memcpy(mem.data, data, size);
+	mem.size = size;
+	mem.valid = 1;
+	return 0;
+
+}
+
+static const csp_sfp_store_t store = {mem_load, mem_save, NULL};
+
+static uint8_t rx_data[SIZE];
+static volatile int server_runs, server_result;
+
+static int deliver(void * arg, uint32_t offset, const uint8_t * data, uint32_t size, uint32_t totalsize) {
+
+	if (totalsize != SIZE)
+		return -1;
+
+	memcpy(&rx_data[offset], data, size);
+	return 0;
+
+}
+
+static CSP_DEFINE_TASK(server) {
+
+	csp_socket_t * sock = csp_socket(CSP_SO_NONE);
+	csp_conn_t * conn;
+
+	csp_bind(sock, PORT);
+	csp_listen(sock, 5);
+
+	while (1) {
+		conn = csp_accept(sock, CSP_MAX_DELAY);
+		if (conn == NULL)
+			continue;
+		server_result = csp_sfp_recv_resume(conn, deliver, NULL, WINDOW, TIMEOUT, &store);
+		csp_close(conn);
+		server_runs++;
+	}
+
+	return CSP_TASK_RETURN;
+
+}
+
+/* One pass of transfer id, cut after CUT bytes if cut is set */
+static int send_pass(uint32_t id, uint8_t * data, int cut) {
+
+	csp_conn_t * conn;
+	int runs = server_runs, result;
+
+	pass_bytes = 0;
+	cut_at = cut ? CUT : 0;
+	conn = csp_connect(CSP_PRIO_NORM, csp_get_address(), PORT, 1000, CSP_O_NONE);
+	if (conn == NULL)
+		return -1;
+	result = csp_sfp_send_resume(conn, id, data, SIZE, MTU, WINDOW, TIMEOUT, NULL);
+	csp_close(conn);
+
+	/* The receiver saves its checkpoint when it gives up */
+	while (server_runs == runs)
+		csp_sleep_ms(10);
+
+	return result;
+
+}
+
+/* Send transfer id until it completes, the first cuts passes are cut */
+static int transfer(uint32_t id, uint8_t * data, int cuts, int * passes) {
+
+	int result = -1;
+
+	sent_bytes = 0;
+	for (*passes = 0; (result != 0) && (*passes < 20); (*passes)++)
+		result = send_pass(id, data, *passes < cuts);
+
+	return result;
+
+}
+
+static void fill(uint8_t * data, int seed) {
+
+	int i;
+
+	srand(seed);
+	for (i = 0; i < SIZE; i++)
+		data[i] = rand();
+
+}
+
+int main(void) {
+
+	static uint8_t data[SIZE];
+	csp_thread_handle_t handle;
+	int passes;
+
+	csp_debug_set_level(CSP_WARN, 0);
+	csp_debug_set_level(CSP_ERROR, 0);
+	csp_buffer_init(100, 256);
+	csp_init(1);
+	csp_iflist_add(&csp_if_link);
+	csp_rtable_set(1, CSP_ID_HOST_SIZE, &csp_if_link, CSP_NODE_MAC);
+	csp_route_start_task(0, 0);
+	csp_thread_create(server, "SERVER", 0, NULL, 0, &handle);
+
+	/* Cut four times, every pass continues where the last one stopped */
+	fill(data, 1);
+	if ((transfer(1, data, 4, &passes) != 0) || (server_result != 0) || memcmp(rx_data, data, SIZE)) {
+		printf("transfer cut 4 times failed or corrupted\n");
+		return 1;
+	}
+	if ((passes != 5) || mem.valid || (sent_bytes > SIZE * 3 / 2)) {
+		printf("%d passes, %lu bytes sent, checkpoint %s\n", passes, sent_bytes, mem.valid ? "left" : "erased");
+		return 1;
+	}
+	printf("%d bytes, cut 4 times: %d passes, %lu bytes sent (%.2fx)\n", SIZE, passes, sent_bytes,
+			(double) sent_bytes / SIZE);
+
+	/* A cut transfer of the same size leaves a checkpoint, which another
+	 * transfer id must not continue from */
+	fill(data, 2);
+	if ((send_pass(2, data, 1) == 0) || !mem.valid) {
+		printf("cut transfer left no checkpoint\n");
+		return 1;
+	}
+	fill(data, 3);
+	if ((transfer(3, data, 0, &passes) != 0) || (server_result != 0) || memcmp(rx_data, data, SIZE)) {
+		printf("checkpoint of another transfer id was resumed\n");
+		return 1;
+	}
+	if (sent_bytes < SIZE) {
+		printf("another transfer id sent only %lu bytes\n", sent_bytes);
+		return 1;
+	}
+
+	/* The transfer fails if its checkpoint cannot be erased */
+	mem.fail_erase = 1;
+	if ((transfer(4, data, 0, &passes) != 0) || (server_result != -1)) {
+		printf("failed erase not reported\n");
+		return 1;
+	}
+
+	printf("checkpoint of another transfer id discarded, failed erase reported\n");
+
+	return 0;
+
+}